@@ -0,0 +1,572 @@
+#ifndef CAPSULE_COLLISION_H_
+#define CAPSULE_COLLISION_H_
+
+#include "collider_mesh.h"
+#include "constants.h"
+#include "gjk.h"
+#include "math.h"
+#include "transform.h"
+#include "vector.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+//**
+// Capsule collisions
+// A capsule is the segment between point1 and point2, inflated by its
+// radius. All the tests work with the closest points between the segment
+// and the other shape; if they are closer than the radius, the contact
+// normal and depth come from them. If the segment itself is inside of the
+// other shape, the depth is found by SAT (boxes) or EPA (hulls).
+// When the segment lies along a face (or along the other capsule), it is
+// clipped against the side planes of that face, for a two point manifold
+// so the capsule can rest on it.
+// If there is no collision, the separating_distance is a lower bound of
+// the distance between the shapes
+// */
+
+#define CAPSULE_PARALLEL_EPSILON 0.05f
+#define CAPSULE_FACE_ALIGNMENT 0.95f
+
+namespace CAPSULE {
+
+    inline sVector3 get_closest_point_on_segment(const sVector3 &point,
+                                                 const sVector3 &segment_start,
+                                                 const sVector3 &segment_end,
+                                                 float *t = NULL) {
+        const sVector3 segment = segment_end.subs(segment_start);
+        const float length_squared = dot_prod(segment, segment);
+        float s = 0.0f;
+
+        if (length_squared > 0.000001f) {
+            s = MIN(MAX(dot_prod(point.subs(segment_start), segment) / length_squared, 0.0f), 1.0f);
+        }
+        if (t != NULL) {
+            *t = s;
+        }
+
+        return segment_start.sum(segment.mult(s));
+    }
+
+    // Closest points between two segments (Real-Time Collision Detection 5.1.9)
+    inline void get_closest_points_segment_segment(const sVector3 &p1,
+                                                   const sVector3 &q1,
+                                                   const sVector3 &p2,
+                                                   const sVector3 &q2,
+                                                   sVector3 *closest1,
+                                                   sVector3 *closest2) {
+        const sVector3 d1 = q1.subs(p1);
+        const sVector3 d2 = q2.subs(p2);
+        const sVector3 r = p1.subs(p2);
+        const float a = dot_prod(d1, d1);
+        const float e = dot_prod(d2, d2);
+        const float f = dot_prod(d2, r);
+        float s = 0.0f, t = 0.0f;
+
+        if (a <= 0.000001f && e <= 0.000001f) {
+            *closest1 = p1;
+            *closest2 = p2;
+            return;
+        }
+
+        if (a <= 0.000001f) {
+            t = MIN(MAX(f / e, 0.0f), 1.0f);
+        } else {
+            const float c = dot_prod(d1, r);
+
+            if (e <= 0.000001f) {
+                s = MIN(MAX(-c / a, 0.0f), 1.0f);
+            } else {
+                const float b = dot_prod(d1, d2);
+                const float denom = a * e - b * b;
+
+                // Parallel segments: any s is valid
+                if (denom > 0.000001f) {
+                    s = MIN(MAX((b * f - c * e) / denom, 0.0f), 1.0f);
+                }
+
+                t = (b * s + f) / e;
+                if (t < 0.0f) {
+                    t = 0.0f;
+                    s = MIN(MAX(-c / a, 0.0f), 1.0f);
+                } else if (t > 1.0f) {
+                    t = 1.0f;
+                    s = MIN(MAX((b - c) / a, 0.0f), 1.0f);
+                }
+            }
+        }
+
+        *closest1 = p1.sum(d1.mult(s));
+        *closest2 = p2.sum(d2.mult(t));
+    }
+
+    // Any direction perpendicular to the segment, facing the point if it can
+    inline sVector3 get_perpendicular_direction(const sVector3 &segment,
+                                                const sVector3 &to_point) {
+        sVector3 direction = cross_prod(cross_prod(segment, to_point), segment);
+
+        if (dot_prod(direction, direction) < 0.000001f) {
+            const sVector3 axis = (fabsf(segment.x) < 0.57f) ? sVector3{1.0f, 0.0f, 0.0f} : sVector3{0.0f, 1.0f, 0.0f};
+            direction = cross_prod(segment, axis);
+        }
+
+        return direction.normalize();
+    }
+
+    // Clips the segment to the prism of the face (the side planes of its
+    // edges), and adds the clipped points that are below the face.
+    // The face is given by its corners, CCW seen from its normal
+    inline uint16_t get_face_segment_contacts(const sVector3 *face_vertices,
+                                              const uint32_t face_vertex_count,
+                                              const sVector3 &face_normal,
+                                              const sVector3 &segment_start,
+                                              const sVector3 &segment_end,
+                                              const float radius,
+                                              sVector3 *contact_points,
+                                              float *contact_depth) {
+        const sVector3 segment = segment_end.subs(segment_start);
+        float t_min = 0.0f, t_max = 1.0f;
+
+        for(uint32_t i = 0; i < face_vertex_count && t_min <= t_max; i++) {
+            const sVector3 &v0 = face_vertices[i];
+            const sVector3 &v1 = face_vertices[(i + 1) % face_vertex_count];
+            const sVector3 side_normal = cross_prod(v1.subs(v0), face_normal);
+
+            // Keep the part of the segment behind the side plane
+            const float start_distance = dot_prod(side_normal, segment_start.subs(v0));
+            const float distance_delta = dot_prod(side_normal, segment);
+
+            if (fabsf(distance_delta) < 0.000001f) {
+                if (start_distance > 0.0f) {
+                    return 0;
+                }
+                continue;
+            }
+
+            const float t = -start_distance / distance_delta;
+            if (distance_delta > 0.0f) {
+                t_max = MIN(t_max, t);
+            } else {
+                t_min = MAX(t_min, t);
+            }
+        }
+
+        if (t_min > t_max) {
+            return 0;
+        }
+
+        uint16_t contact_count = 0;
+        const float t_values[2] = {t_min, t_max};
+        const uint32_t point_count = (t_max - t_min > 0.0001f) ? 2 : 1;
+
+        for(uint32_t i = 0; i < point_count; i++) {
+            const sVector3 point = segment_start.sum(segment.mult(t_values[i]));
+            const float depth = dot_prod(face_normal, point.subs(face_vertices[0])) - radius;
+
+            if (depth <= 0.0f) {
+                contact_points[contact_count] = point.subs(face_normal.mult(radius));
+                contact_depth[contact_count] = depth;
+                contact_count++;
+            }
+        }
+
+        return contact_count;
+    }
+
+    //**
+    // Capsule vs Capsule
+    // The normal goes from the capsule 1 to the capsule 2
+    // */
+    inline bool capsule_capsule_collision(const sVector3 &start1,
+                                          const sVector3 &end1,
+                                          const float radius1,
+                                          const sVector3 &start2,
+                                          const sVector3 &end2,
+                                          const float radius2,
+                                          sVector3 *normal,
+                                          sVector3 *contact_points,
+                                          float *contact_depth,
+                                          uint16_t *contanct_points_count,
+                                          float *separating_distance = NULL) {
+        const float radius = radius1 + radius2;
+        sVector3 closest1 = {}, closest2 = {};
+        get_closest_points_segment_segment(start1, end1, start2, end2, &closest1, &closest2);
+
+        const sVector3 delta = closest2.subs(closest1);
+        const float distance_squared = dot_prod(delta, delta);
+
+        if (distance_squared > radius * radius) {
+            if (separating_distance != NULL) {
+                *separating_distance = sqrtf(distance_squared) - radius;
+            }
+            return false;
+        }
+
+        const sVector3 segment1 = end1.subs(start1);
+        const sVector3 segment2 = end2.subs(start2);
+
+        if (distance_squared > 0.000001f) {
+            *normal = delta.mult(1.0f / sqrtf(distance_squared));
+        } else {
+            // The segments cross: the normal is perpendicular to both
+            const sVector3 center_delta = start2.sum(end2).subs(start1.sum(end1)).mult(0.5f);
+            sVector3 direction = cross_prod(segment1, segment2);
+
+            if (dot_prod(direction, direction) < 0.000001f) {
+                *normal = get_perpendicular_direction(segment1, center_delta);
+            } else {
+                *normal = direction.normalize();
+                if (dot_prod(*normal, center_delta) < 0.0f) {
+                    *normal = normal->invert();
+                }
+            }
+        }
+
+        // Parallel capsules: the overlap of both segments, for two contacts
+        const float length1 = segment1.magnitude();
+        const float length2 = segment2.magnitude();
+        if (length1 > 0.0001f && length2 > 0.0001f &&
+            cross_prod(segment1, segment2).magnitude() < CAPSULE_PARALLEL_EPSILON * length1 * length2) {
+            float t_start = 0.0f, t_end = 0.0f;
+            get_closest_point_on_segment(start2, start1, end1, &t_start);
+            get_closest_point_on_segment(end2, start1, end1, &t_end);
+
+            const float t_min = MIN(t_start, t_end);
+            const float t_max = MAX(t_start, t_end);
+
+            if (t_max - t_min > 0.0001f) {
+                uint16_t contact_count = 0;
+                const float t_values[2] = {t_min, t_max};
+
+                for(uint32_t i = 0; i < 2; i++) {
+                    const sVector3 point1 = start1.sum(segment1.mult(t_values[i]));
+                    const sVector3 point2 = get_closest_point_on_segment(point1, start2, end2);
+                    const float depth = dot_prod(*normal, point2.subs(point1)) - radius;
+
+                    if (depth <= 0.0f) {
+                        contact_points[contact_count] = point1.sum(normal->mult(radius1)).sum(point2.subs(normal->mult(radius2))).mult(0.5f);
+                        contact_depth[contact_count] = depth;
+                        contact_count++;
+                    }
+                }
+
+                if (contact_count > 0) {
+                    *contanct_points_count = contact_count;
+                    return true;
+                }
+            }
+        }
+
+        contact_points[0] = closest1.sum(normal->mult(radius1)).sum(closest2.subs(normal->mult(radius2))).mult(0.5f);
+        contact_depth[0] = sqrtf(distance_squared) - radius;
+        *contanct_points_count = 1;
+
+        return true;
+    }
+
+    //**
+    // Capsule vs Sphere
+    // The normal goes from the capsule to the sphere
+    // */
+    inline bool capsule_sphere_collision(const sVector3 &capsule_start,
+                                         const sVector3 &capsule_end,
+                                         const float capsule_radius,
+                                         const sVector3 &sphere_center,
+                                         const float sphere_radius,
+                                         sVector3 *normal,
+                                         sVector3 *contact_points,
+                                         float *contact_depth,
+                                         uint16_t *contanct_points_count,
+                                         float *separating_distance = NULL) {
+        const float radius = capsule_radius + sphere_radius;
+        const sVector3 closest = get_closest_point_on_segment(sphere_center, capsule_start, capsule_end);
+        const sVector3 delta = sphere_center.subs(closest);
+        const float distance_squared = dot_prod(delta, delta);
+
+        if (distance_squared > radius * radius) {
+            if (separating_distance != NULL) {
+                *separating_distance = sqrtf(distance_squared) - radius;
+            }
+            return false;
+        }
+
+        if (distance_squared > 0.000001f) {
+            *normal = delta.mult(1.0f / sqrtf(distance_squared));
+        } else {
+            *normal = get_perpendicular_direction(capsule_end.subs(capsule_start), delta);
+        }
+
+        contact_points[0] = sphere_center.subs(normal->mult(sphere_radius));
+        contact_depth[0] = sqrtf(distance_squared) - radius;
+        *contanct_points_count = 1;
+
+        return true;
+    }
+
+    //**
+    // Capsule vs OBB
+    // On the box's local space, the squared distance from the segment to the
+    // box is a convex, piecewise quadratic, function of the segment's
+    // parameter, that changes only where the segment crosses the slabs of
+    // the box. Its minimum is found on each piece in closed form.
+    // If the segment touches the box, the least penetrating axis (the box's
+    // faces, and the cross products of the segment with its edges) is used.
+    // The normal goes from the box to the capsule
+    // */
+    inline bool capsule_OBB_collision(const sVector3 &capsule_start,
+                                      const sVector3 &capsule_end,
+                                      const float capsule_radius,
+                                      const sTransform &box_transform,
+                                      sVector3 *normal,
+                                      sVector3 *contact_points,
+                                      float *contact_depth,
+                                      uint16_t *contanct_points_count,
+                                      float *separating_distance = NULL) {
+        const sVector3 box_half_size = box_transform.scale.mult(0.5f);
+        const float h[3] = {box_half_size.x, box_half_size.y, box_half_size.z};
+        const sVector3 local_start = box_transform.apply_inverse_rotation(capsule_start.subs(box_transform.position));
+        const sVector3 local_end = box_transform.apply_inverse_rotation(capsule_end.subs(box_transform.position));
+        const float a[3] = {local_start.x, local_start.y, local_start.z};
+        const float d[3] = {local_end.x - local_start.x, local_end.y - local_start.y, local_end.z - local_start.z};
+
+        // Pieces: the parameters where the segment enters or leaves a slab
+        float breakpoints[8] = {0.0f};
+        uint32_t breakpoint_count = 1;
+        for(uint32_t i = 0; i < 3; i++) {
+            if (fabsf(d[i]) < 0.000001f) {
+                continue;
+            }
+            for(int side = -1; side <= 1; side += 2) {
+                const float t = (side * h[i] - a[i]) / d[i];
+                if (t > 0.0f && t < 1.0f) {
+                    breakpoints[breakpoint_count++] = t;
+                }
+            }
+        }
+        breakpoints[breakpoint_count++] = 1.0f;
+
+        // Insertion sort, there are at most 8
+        for(uint32_t i = 1; i < breakpoint_count; i++) {
+            const float value = breakpoints[i];
+            uint32_t j = i;
+            for(; j > 0 && breakpoints[j - 1] > value; j--) {
+                breakpoints[j] = breakpoints[j - 1];
+            }
+            breakpoints[j] = value;
+        }
+
+        float best_t = 0.0f, best_distance_squared = FLT_MAX;
+        for(uint32_t piece = 0; piece + 1 < breakpoint_count; piece++) {
+            const float t0 = breakpoints[piece], t1 = breakpoints[piece + 1];
+            const float t_mid = (t0 + t1) * 0.5f;
+
+            // On this piece, the outside axis are fixed
+            float numerator = 0.0f, denominator = 0.0f;
+            float side[3] = {};
+            for(uint32_t i = 0; i < 3; i++) {
+                const float p = a[i] + t_mid * d[i];
+                side[i] = (p > h[i]) ? 1.0f : ((p < -h[i]) ? -1.0f : 0.0f);
+                if (side[i] != 0.0f) {
+                    numerator -= d[i] * (a[i] - side[i] * h[i]);
+                    denominator += d[i] * d[i];
+                }
+            }
+
+            const float t = (denominator > 0.000001f) ? MIN(MAX(numerator / denominator, t0), t1) : t0;
+            float distance_squared = 0.0f;
+            for(uint32_t i = 0; i < 3; i++) {
+                const float p = a[i] + t * d[i];
+                const float outside = MAX(fabsf(p) - h[i], 0.0f);
+                distance_squared += outside * outside;
+            }
+
+            if (distance_squared < best_distance_squared) {
+                best_distance_squared = distance_squared;
+                best_t = t;
+            }
+        }
+
+        if (best_distance_squared > capsule_radius * capsule_radius) {
+            if (separating_distance != NULL) {
+                *separating_distance = sqrtf(best_distance_squared) - capsule_radius;
+            }
+            return false;
+        }
+
+        const sVector3 local_segment = local_end.subs(local_start);
+        sVector3 local_normal = {};
+        sVector3 local_point = {};
+        float depth = 0.0f;
+
+        if (best_distance_squared > 0.000001f) {
+            // Shallow: from the closest points
+            local_point = local_start.sum(local_segment.mult(best_t));
+            const sVector3 box_point = { MIN(MAX(local_point.x, -h[0]), h[0]),
+                                         MIN(MAX(local_point.y, -h[1]), h[1]),
+                                         MIN(MAX(local_point.z, -h[2]), h[2]) };
+            const float distance = sqrtf(best_distance_squared);
+            local_normal = local_point.subs(box_point).mult(1.0f / distance);
+            depth = distance - capsule_radius;
+        } else {
+            // Deep: least penetrating axis
+            const sVector3 local_center = local_start.sum(local_end).mult(0.5f);
+            const sVector3 half_segment = local_segment.mult(0.5f);
+            const sVector3 box_axis[3] = { {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f} };
+            float best_separation = -FLT_MAX;
+
+            for(uint32_t i = 0; i < 6; i++) {
+                sVector3 axis = box_axis[i % 3];
+                if (i >= 3) {
+                    axis = cross_prod(local_segment, box_axis[i % 3]);
+                    const float axis_len = axis.magnitude();
+                    if (axis_len < 0.0001f * local_segment.magnitude() || axis_len < 0.000001f) {
+                        continue;
+                    }
+                    axis = axis.mult(1.0f / axis_len);
+                }
+
+                const float box_radius = h[0] * fabsf(axis.x) + h[1] * fabsf(axis.y) + h[2] * fabsf(axis.z);
+                const float center_distance = dot_prod(local_center, axis);
+                const float separation = fabsf(center_distance) - box_radius - fabsf(dot_prod(half_segment, axis)) - capsule_radius;
+
+                // Favour the faces
+                if (separation > best_separation + ((i >= 3) ? 0.001f : 0.0f)) {
+                    best_separation = separation;
+                    local_normal = (center_distance < 0.0f) ? axis.invert() : axis;
+                }
+            }
+
+            // The deepest point of the part of the segment inside the box
+            float t_min = 0.0f, t_max = 1.0f;
+            for(uint32_t i = 0; i < 3; i++) {
+                if (fabsf(d[i]) < 0.000001f) {
+                    continue;
+                }
+                const float t0 = (-h[i] - a[i]) / d[i];
+                const float t1 = (h[i] - a[i]) / d[i];
+                t_min = MAX(t_min, MIN(t0, t1));
+                t_max = MIN(t_max, MAX(t0, t1));
+            }
+            t_min = MIN(t_min, best_t);
+            t_max = MAX(t_max, best_t);
+
+            const sVector3 inside_start = local_start.sum(local_segment.mult(t_min));
+            const sVector3 inside_end = local_start.sum(local_segment.mult(t_max));
+            local_point = (dot_prod(inside_start, local_normal) < dot_prod(inside_end, local_normal)) ? inside_start : inside_end;
+            depth = best_separation;
+        }
+
+        // Face of the box aligned with the normal: two point manifold
+        const float n[3] = {local_normal.x, local_normal.y, local_normal.z};
+        uint32_t face_axis = 0;
+        for(uint32_t i = 1; i < 3; i++) {
+            if (fabsf(n[i]) > fabsf(n[face_axis])) {
+                face_axis = i;
+            }
+        }
+
+        if (fabsf(n[face_axis]) > CAPSULE_FACE_ALIGNMENT) {
+            const float sign = (n[face_axis] > 0.0f) ? 1.0f : -1.0f;
+            const uint32_t u = (face_axis + 1) % 3, v = (face_axis + 2) % 3;
+            float face_normal[3] = {0.0f, 0.0f, 0.0f};
+            face_normal[face_axis] = sign;
+
+            // Corners, CCW seen from the normal
+            sVector3 face_vertices[4] = {};
+            const float corner_u[4] = {-1.0f, 1.0f, 1.0f, -1.0f};
+            const float corner_v[4] = {-1.0f, -1.0f, 1.0f, 1.0f};
+            for(uint32_t i = 0; i < 4; i++) {
+                float corner[3];
+                corner[face_axis] = sign * h[face_axis];
+                corner[u] = corner_u[(sign > 0.0f) ? i : (3 - i)] * h[u];
+                corner[v] = corner_v[(sign > 0.0f) ? i : (3 - i)] * h[v];
+                face_vertices[i] = {corner[0], corner[1], corner[2]};
+            }
+
+            const sVector3 local_face_normal = {face_normal[0], face_normal[1], face_normal[2]};
+            const uint16_t contact_count = get_face_segment_contacts(face_vertices,
+                                                                     4,
+                                                                     local_face_normal,
+                                                                     local_start,
+                                                                     local_end,
+                                                                     capsule_radius,
+                                                                     contact_points,
+                                                                     contact_depth);
+
+            if (contact_count == 2) {
+                for(uint16_t i = 0; i < contact_count; i++) {
+                    contact_points[i] = box_transform.apply_without_scale(contact_points[i]);
+                }
+                *normal = box_transform.apply_rotation(local_face_normal);
+                *contanct_points_count = contact_count;
+                return true;
+            }
+        }
+
+        *normal = box_transform.apply_rotation(local_normal);
+        contact_points[0] = box_transform.apply_without_scale(local_point.subs(local_normal.mult(capsule_radius)));
+        contact_depth[0] = depth;
+        *contanct_points_count = 1;
+
+        return true;
+    }
+
+    //**
+    // Capsule vs Hull
+    // GJK between the segment and the hull (EPA if the segment is inside),
+    // and clipping against the hull's face along the normal.
+    // The normal goes from the hull to the capsule
+    // */
+    inline bool capsule_hull_collision(const sVector3 &capsule_start,
+                                       const sVector3 &capsule_end,
+                                       const float capsule_radius,
+                                       const sColliderMesh &hull_mesh,
+                                       uint32_t *support_vertex,
+                                       GJK::sSimplexCache *simplex_cache,
+                                       sVector3 *normal,
+                                       sVector3 *contact_points,
+                                       float *contact_depth,
+                                       uint16_t *contanct_points_count,
+                                       float *separating_distance = NULL) {
+        if (!GJK::convex_collision(GJK::get_hull_shape(hull_mesh, support_vertex),
+                                   GJK::get_segment_shape(capsule_start, capsule_end, capsule_radius),
+                                   simplex_cache,
+                                   normal,
+                                   contact_points,
+                                   contact_depth,
+                                   contanct_points_count,
+                                   separating_distance)) {
+            return false;
+        }
+
+        const uint32_t face = hull_mesh.get_support_face(*normal, support_vertex);
+        const sVector3 &face_normal = hull_mesh.normals[face];
+
+        if (dot_prod(face_normal, *normal) > CAPSULE_FACE_ALIGNMENT) {
+            sVector3 face_contact_points[2] = {};
+            float face_contact_depth[2] = {};
+            const uint16_t contact_count = get_face_segment_contacts(hull_mesh.get_face(face),
+                                                                     hull_mesh.get_face_size(face),
+                                                                     face_normal,
+                                                                     capsule_start,
+                                                                     capsule_end,
+                                                                     capsule_radius,
+                                                                     face_contact_points,
+                                                                     face_contact_depth);
+
+            if (contact_count == 2) {
+                for(uint16_t i = 0; i < contact_count; i++) {
+                    contact_points[i] = face_contact_points[i];
+                    contact_depth[i] = face_contact_depth[i];
+                }
+                *normal = face_normal;
+                *contanct_points_count = contact_count;
+            }
+        }
+
+        return true;
+    }
+};
+
+#endif // CAPSULE_COLLISION_H_
@@ -7,13 +7,16 @@
 #include "transform.h"
 #include "vector.h"
 #include "geometry.h"
+#include "half_edge_hull.h"
+#include "quickhull.h"
+#include "data_structs/pair_hash_map.h"
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 
-enum eFaceSize : uint32_t {
-    FACE_TRI = 3,
-    FACE_QUAD = 4
-};
+#define EDGE_DIRECTION_EPSILON 0.0001f
+// Cells per unit of the quantized edge directions, on each component
+#define EDGE_DIRECTION_CELLS 1024.0f
 
 struct sEdgeIndexTuple {
     uint32_t x;
@@ -31,14 +34,35 @@ struct sColliderMesh {
     sVector3   *normals = NULL;
     sVector3   *plane_origin = NULL;
     sEdgeIndexTuple *edges = NULL;
+    // Faces on each side of the edges: x is the face of the edge's corner,
+    // and y is the neighbour face
+    sEdgeIndexTuple *edge_faces = NULL;
     uint32_t   *face_connections = NULL;
 
+    // The faces are convex polygons of any size, the vertices of the face
+    // f are on the range [face_offsets[f], face_offsets[f + 1])
+    uint32_t   *face_offsets = NULL;
+
+    // Unique, normalized, edge directions. The parallel and antiparallel
+    // edges are collapsed into one, since they give the same SAT axis
+    sVector3   *edge_directions = NULL;
+    uint32_t   edge_direction_count = 0;
+
+    // Adjacency of the unique (welded) vertices, for the hill climbing
+    // support queries. Each unique vertex stores one of its corners, and
+    // its neighbours & faces are on the range
+    // [vertex_adjacency_offsets[v], vertex_adjacency_offsets[v + 1]).
+    // Only built on closed meshes, otherwise is NULL
+    uint32_t   *vertex_corner = NULL;
+    uint32_t   *vertex_adjacency_offsets = NULL;
+    uint32_t   *vertex_neighbours = NULL;
+    uint32_t   *vertex_faces = NULL;
+    uint32_t   unique_vertices_count = 0;
+
     uint32_t   vertices_count = 0;
     uint32_t   face_count = 0;
     uint32_t   edge_cout = 0;
 
-    eFaceSize  face_stride = FACE_QUAD;
-
     sVector3 mesh_center = {};
 
 
@@ -46,10 +70,15 @@ struct sColliderMesh {
         vertices = (sVector3*) malloc(sizeof(sVector3) * mesh.indexing_count);
         normals = (sVector3*) malloc(sizeof(sVector3) * mesh.face_count);
         plane_origin = (sVector3*) malloc(sizeof(sVector3) * mesh.face_count);
+        face_offsets = (uint32_t*) malloc(sizeof(uint32_t) * (mesh.face_count + 1));
 
         vertices_count = mesh.indexing_count;
         face_count = mesh.face_count;
-        face_stride = FACE_TRI; // Is a triangled mesh
+
+        // Is a triangled mesh
+        for(uint32_t i = 0; i <= mesh.face_count; i++) {
+            face_offsets[i] = i * 3;
+        }
 
         // Load vertices & calculate center (avg point)
         mesh_center = {0.0f, 0.0f, 0.0f};
@@ -65,88 +94,109 @@ struct sColliderMesh {
             sVector3 face_plane_center = {0.0f, 0.0f, 0.0f};
 
             // Compute the middle point of the face
-            face_plane_center = face_plane_center.sum(vertices[(i * face_stride)]);
-            face_plane_center = face_plane_center.sum(vertices[(i * face_stride) + 1]);
-            face_plane_center = face_plane_center.sum(vertices[(i * face_stride) + 2]);
+            face_plane_center = face_plane_center.sum(vertices[(i * 3)]);
+            face_plane_center = face_plane_center.sum(vertices[(i * 3) + 1]);
+            face_plane_center = face_plane_center.sum(vertices[(i * 3) + 2]);
 
-            plane_origin[i] = face_plane_center.mult(1.0f / face_stride);
+            plane_origin[i] = face_plane_center.mult(1.0f / 3.0f);
 
             normals[i] = mesh.face_normals[i].normalize();
         }
 
-        // Store Edges
-        // TODO:  umber of edges?
-        edges = (sEdgeIndexTuple*) malloc(sizeof(sEdgeIndexTuple) * face_count * 2);
-        edge_cout = 0;
+        // Store Edges, via the half-edge structure of the mesh
+        sHalfEdgeHull hull = {};
+        hull.init_from_mesh(mesh);
+        build_topology(hull);
+        hull.clean();
+    }
 
-        uint32_t *edge_face_connections = (uint32_t*) malloc(sizeof(uint32_t) * face_count * 4);
+    // Build the collider from the convex hull of the vertices of the mesh,
+    // instead of from its triangles, with at most max_vertices vertices.
+    // Returns false if the mesh is flat or has less than 4 vertices
+    bool load_convex_hull(const sMesh &mesh,
+                          const uint32_t max_vertices) {
+        // Weld the vertices by its OBJ position index
+        uint32_t position_count = 0;
+        for(uint32_t i = 0; i < mesh.indexing_count; i++) {
+            position_count = MAX(position_count, mesh.face_vertices[i] + 1);
+        }
 
-        face_connections = (uint32_t*) malloc(sizeof(uint32_t) * 3 * face_count);
-        uint32_t *face_conn_count = (uint32_t*) malloc(sizeof(uint32_t) * face_count);
-        memset(face_conn_count, 0, sizeof(uint32_t) * face_count);
+        sVector3 *positions = (sVector3*) malloc(sizeof(sVector3) * position_count);
+        for(uint32_t i = 0; i < mesh.indexing_count; i++) {
+            positions[mesh.face_vertices[i]] = mesh.vertices[mesh.vertices_index[i]].vertex;
+        }
 
-        // TODO: this is not very efficient... Better way?
-        // Iterate throught every face, and thrugh every vertex
-        // If there has not beel included, then add them to the list
-        // Maybe a use of a map or a set to speedup..?
-        // Maybe a hald-edfe can do a bit better... TODO
-        for(uint32_t i = 0; i < face_count; i++) {
-            uint32_t curr_face_index = i * face_stride;
+        sHalfEdgeHull hull = {};
+        const bool is_valid = quickhull::build_hull(positions, position_count, max_vertices, &hull);
+        free(positions);
 
-            const uint32_t *current_face = &mesh.face_vertices[curr_face_index];
+        if (!is_valid) {
+            return false;
+        }
 
-            for(uint32_t v1 = 0; v1 < face_stride; v1++) {
-                uint32_t v2 = (v1 + 1) % face_stride;
+        init_from_hull(hull);
+        hull.clean();
 
-                sEdgeIndexTuple curr_edge = {current_face[v1], current_face[v2]};
-                bool is_inside = false;
-                sVector3 vec1 = vertices[curr_edge.x];
-                sVector3 vec2 = vertices[curr_edge.y];
+        return true;
+    }
 
-                // iterate thrugh to all the edges, to test if its inside
-                uint32_t ed = 0;
-                for(; ed < edge_cout; ed++) {
-                    sEdgeIndexTuple &edge_to_test = edges[ed];
+    // Load a hull, with the vertices stored per face corner
+    void init_from_hull(const sHalfEdgeHull &hull) {
+        vertices = (sVector3*) malloc(sizeof(sVector3) * hull.half_edge_count);
+        normals = (sVector3*) malloc(sizeof(sVector3) * hull.face_count);
+        plane_origin = (sVector3*) malloc(sizeof(sVector3) * hull.face_count);
+        face_offsets = (uint32_t*) malloc(sizeof(uint32_t) * (hull.face_count + 1));
 
-                    bool is_equal = vertices[edge_to_test.x].is_equal(vec1) && vertices[edge_to_test.y].is_equal(vec2);
-                    is_equal = is_equal || (vertices[edge_to_test.x].is_equal(vec2) && vertices[edge_to_test.y].is_equal(vec1));
+        vertices_count = hull.half_edge_count;
+        face_count = hull.face_count;
+        memcpy(face_offsets, hull.face_offsets, sizeof(uint32_t) * (hull.face_count + 1));
 
-                    if (is_equal) {
-                        is_inside = true;
-                        break;
-                    }
-                }
+        for(uint32_t i = 0; i < hull.half_edge_count; i++) {
+            vertices[i] = hull.vertices[hull.half_edges[i].origin];
+        }
 
-                // For the edge face connections, if it inside, then it is
-                // already on the list, and is in the first of the tuple list
-                // so we use it, and set the other part of the tuples,
-                // since this indicates that the current edge, coneccets both
-                // faces
-                if (!is_inside) {
-                    edge_face_connections[edge_cout] = i;
-                    edges[edge_cout++] = curr_edge;
-                    //std::cout << edge_cout << '/' << face_count * 2 <<   std::endl;
-                } else {
-                    uint32_t neighboor_face = edge_face_connections[ed];
-                    face_connections[(i*3) + face_conn_count[i]] = neighboor_face;
-                    face_connections[(neighboor_face * 3) + face_conn_count[neighboor_face]] = i;
-
-                    face_conn_count[neighboor_face]++;
-                    face_conn_count[i]++;
-                }
+        // The center is the average of the unique vertices
+        mesh_center = {0.0f, 0.0f, 0.0f};
+        for(uint32_t i = 0; i < hull.vertex_count; i++) {
+            mesh_center = mesh_center.sum(hull.vertices[i]);
+        }
+        mesh_center = mesh_center.mult(1.0f / hull.vertex_count);
+
+        // The normal of the polygons is computed via Newell's method,
+        // since the merged faces are not exactly planar
+        for(uint32_t i = 0; i < face_count; i++) {
+            const sVector3 *face_vertices = get_face(i);
+            const uint32_t face_size = get_face_size(i);
+
+            sVector3 center = {0.0f, 0.0f, 0.0f};
+            sVector3 normal = {0.0f, 0.0f, 0.0f};
+            for(uint32_t j = 0; j < face_size; j++) {
+                const sVector3 &curr = face_vertices[j];
+                const sVector3 &next = face_vertices[(j + 1) % face_size];
+
+                normal.x += (curr.y - next.y) * (curr.z + next.z);
+                normal.y += (curr.z - next.z) * (curr.x + next.x);
+                normal.z += (curr.x - next.x) * (curr.y + next.y);
+                center = center.sum(curr);
             }
+
+            plane_origin[i] = center.mult(1.0f / face_size);
+            normals[i] = normal.normalize();
         }
-        free(face_conn_count);
-        free(edge_face_connections);
+
+        build_topology(hull);
     }
 
     void init_cuboid(const sTransform &transform) {
-        int box_LUT_vertices[6 * 4] = { 4, 5, 7, 6,   6, 7, 3, 2,   1, 3, 7, 5,   0, 1, 3, 2,   0, 1, 5, 4,   0, 2, 6, 4};
+        // All the faces are counter clockwise, seen from outside
+        uint32_t box_LUT_vertices[6 * 4] = { 4, 5, 7, 6,   6, 7, 3, 2,   1, 3, 7, 5,   0, 2, 3, 1,   0, 1, 5, 4,   0, 4, 6, 2};
 
         vertices = (sVector3*) malloc(sizeof(sVector3) * 6 * 4);
         normals = (sVector3*) malloc(sizeof(sVector3) * 6);
         plane_origin = (sVector3*) malloc(sizeof(sVector3) * 6);
 
+        face_offsets = (uint32_t*) malloc(sizeof(uint32_t) * (6 + 1));
+
         vertices_count = 6 * 4;
         face_count = 6;
 
@@ -190,66 +240,160 @@ struct sColliderMesh {
         }
 
 
-        face_stride = FACE_QUAD;
+        // Face offsets & edge extraction
+        for(uint32_t i = 0; i <= 6; i++) {
+            face_offsets[i] = i * 4;
+        }
 
+        sHalfEdgeHull hull = {};
+        hull.init(raw_points, 8, box_LUT_vertices, face_offsets, 6);
+        build_topology(hull);
+        hull.clean();
+    }
 
-        // Edge extraction
-        edges = (sEdgeIndexTuple*) malloc(sizeof(sEdgeIndexTuple) * face_count * 4);
+    // Extract the edges and the face connections from the half-edges.
+    // The vertices of the collider are stored per face corner, on the
+    // same order as the half-edges
+    void build_topology(const sHalfEdgeHull &hull) {
+        edges = (sEdgeIndexTuple*) malloc(sizeof(sEdgeIndexTuple) * hull.edge_count);
+        edge_faces = (sEdgeIndexTuple*) malloc(sizeof(sEdgeIndexTuple) * hull.edge_count);
+        face_connections = (uint32_t*) malloc(sizeof(uint32_t) * hull.half_edge_count);
         edge_cout = 0;
 
-        uint32_t *edge_face_connections = (uint32_t*) malloc(sizeof(uint32_t) * face_count * 4);
+        for(uint32_t i = 0; i < hull.half_edge_count; i++) {
+            // The open edges are connected to its own face
+            const uint32_t neighbour_face = hull.get_neighbour_face(i);
+            face_connections[i] = (neighbour_face == HALF_EDGE_NULL) ? hull.half_edges[i].face : neighbour_face;
 
-        face_connections = (uint32_t*) malloc(sizeof(uint32_t) * 4 * face_count);
-        uint32_t *face_conn_count = (uint32_t*) malloc(sizeof(uint32_t) * face_count);
-        memset(face_conn_count, 0, sizeof(uint32_t) * face_count);
+            if (hull.is_edge_representative(i)) {
+                edge_faces[edge_cout] = {hull.half_edges[i].face, face_connections[i]};
+                edges[edge_cout++] = {i, hull.half_edges[i].next};
+            }
+        }
 
-        // TODO: this is not very efficient... Better way?
-        // Iterate throught every face, and thrugh every vertex
-        // If there has not beel included, then add them to the list
-        // Maybe a use of a map or a set to speedup..?
-        // Maybe a hald-edfe can do a bit better... TODO
-        for(uint32_t i = 0; i < face_count; i++) {
-            uint32_t curr_face_index = i * face_stride;
+        compute_edge_directions();
+        build_vertex_adjacency(hull);
+    }
 
-            for(uint32_t v1 = 0; v1 < face_stride; v1++) {
-                uint32_t v2 = (v1 + 1) % face_stride;
+    // The parallel edges (on either sign) share a direction. The directions
+    // are hashed by their quantized components, with the sign fixed so the
+    // first non zero component is positive, so each edge is only compared
+    // against the directions on its cell and the neighbour ones
+    void compute_edge_directions() {
+        edge_directions = (sVector3*) malloc(sizeof(sVector3) * MAX(edge_cout, 1u));
+        edge_direction_count = 0;
+
+        // The cells store the last direction added to it, and each direction
+        // the previous one on the same cell
+        sPairHashMap direction_cells = {};
+        direction_cells.init(edge_cout * 2);
+        uint32_t *next_on_cell = (uint32_t*) malloc(sizeof(uint32_t) * MAX(edge_cout, 1u));
+
+        for(uint32_t i = 0; i < edge_cout; i++) {
+            sVector3 direction = get_edge(i).normalize();
+
+            const float first_component = (fabsf(direction.x) > EDGE_DIRECTION_EPSILON) ? direction.x :
+                                          ((fabsf(direction.y) > EDGE_DIRECTION_EPSILON) ? direction.y : direction.z);
+            if (first_component < 0.0f) {
+                direction = direction.invert();
+            }
 
-                sEdgeIndexTuple curr_edge = {curr_face_index + v1, curr_face_index + v2};
-                bool is_inside = false;
-                sVector3 vec1 = vertices[curr_edge.x];
-                sVector3 vec2 = vertices[curr_edge.y];
+            bool is_unique = !has_parallel_direction(direction_cells, next_on_cell, direction);
 
-                // iterate thrugh to all the edges, to test if its inside
-                uint32_t edge_it = 0;
-                for(; edge_it < edge_cout; edge_it++) {
-                    sEdgeIndexTuple &edge_to_test = edges[edge_it];
+            // Close to the sign flip, a parallel direction can be stored
+            // with the other sign
+            if (is_unique && fabsf(first_component) < 1.0f / EDGE_DIRECTION_CELLS) {
+                is_unique = !has_parallel_direction(direction_cells, next_on_cell, direction.invert());
+            }
 
-                    bool is_equal = vertices[edge_to_test.x].is_equal(vec1) && vertices[edge_to_test.y].is_equal(vec2);
-                    is_equal = is_equal || (vertices[edge_to_test.x].is_equal(vec2) && vertices[edge_to_test.y].is_equal(vec1));
+            if (is_unique) {
+                const uint64_t key = get_edge_direction_key(direction, 0, 0, 0);
+                next_on_cell[edge_direction_count] = direction_cells.get(key);
+                direction_cells.set(key, edge_direction_count);
+                edge_directions[edge_direction_count++] = direction;
+            }
+        }
 
-                    if (is_equal) {
-                        is_inside = true;
-                        break;
+        free(next_on_cell);
+        direction_cells.clean();
+    }
+
+    // Key of the cell of the direction, plus the offset in cells
+    inline uint64_t get_edge_direction_key(const sVector3 &direction,
+                                           const int32_t offset_x,
+                                           const int32_t offset_y,
+                                           const int32_t offset_z) const {
+        // Shifted by one cell, so the offsets are never negative
+        const uint64_t x = (uint64_t) ((int32_t) floorf((direction.x + 1.0f) * EDGE_DIRECTION_CELLS) + 1 + offset_x);
+        const uint64_t y = (uint64_t) ((int32_t) floorf((direction.y + 1.0f) * EDGE_DIRECTION_CELLS) + 1 + offset_y);
+        const uint64_t z = (uint64_t) ((int32_t) floorf((direction.z + 1.0f) * EDGE_DIRECTION_CELLS) + 1 + offset_z);
+
+        return x | (y << 21) | (z << 42);
+    }
+
+    // The cells are bigger than the tolerance, so a parallel direction is
+    // on the same cell or on a neighbour one
+    inline bool has_parallel_direction(const sPairHashMap &direction_cells,
+                                       const uint32_t *next_on_cell,
+                                       const sVector3 &direction) const {
+        for(int32_t x = -1; x <= 1; x++) {
+            for(int32_t y = -1; y <= 1; y++) {
+                for(int32_t z = -1; z <= 1; z++) {
+                    uint32_t curr = direction_cells.get(get_edge_direction_key(direction, x, y, z));
+
+                    for(; curr != PAIR_MAP_NOT_FOUND; curr = next_on_cell[curr]) {
+                        if (cross_prod(direction, edge_directions[curr]).magnitude() < EDGE_DIRECTION_EPSILON) {
+                            return true;
+                        }
                     }
                 }
+            }
+        }
 
-                if (!is_inside) {
-                    edge_face_connections[edge_cout] = i;
-                    edges[edge_cout++] = curr_edge;
-                    //std::cout << edge_cout << '/' << face_count * 4 << " " << face_stride <<  std::endl;
-                }  else {
-                    uint32_t neighboor_face = edge_face_connections[edge_it];
-                    face_connections[(i*4) + face_conn_count[i]] = neighboor_face;
-                    face_connections[(neighboor_face * 4) + face_conn_count[neighboor_face]] = i;
-
-                    face_conn_count[neighboor_face]++;
-                    face_conn_count[i]++;
-                }
+        return false;
+    }
 
+    // Store the neighbours of each vertex, by walking arround its
+    // outgoing half-edges
+    void build_vertex_adjacency(const sHalfEdgeHull &hull) {
+        unique_vertices_count = 0;
+
+        // The walk needs a closed and consistently wound mesh
+        for(uint32_t i = 0; i < hull.half_edge_count; i++) {
+            const uint32_t twin = hull.half_edges[i].twin;
+            if (twin == HALF_EDGE_NULL || hull.get_edge_end(twin) != hull.half_edges[i].origin) {
+                return;
             }
         }
-        free(face_conn_count);
-        free(edge_face_connections);
+
+        vertex_corner = (uint32_t*) malloc(sizeof(uint32_t) * hull.vertex_count);
+        vertex_adjacency_offsets = (uint32_t*) malloc(sizeof(uint32_t) * (hull.vertex_count + 1));
+        vertex_neighbours = (uint32_t*) malloc(sizeof(uint32_t) * hull.half_edge_count);
+        vertex_faces = (uint32_t*) malloc(sizeof(uint32_t) * hull.half_edge_count);
+        unique_vertices_count = hull.vertex_count;
+
+        uint32_t adjacency_count = 0;
+        for(uint32_t vertex = 0; vertex < hull.vertex_count; vertex++) {
+            const uint32_t first_edge = hull.vertex_edge[vertex];
+            vertex_adjacency_offsets[vertex] = adjacency_count;
+            vertex_corner[vertex] = first_edge;
+
+            if (first_edge == HALF_EDGE_NULL) {
+                // Unused vertex: point to any corner, without neighbours
+                vertex_corner[vertex] = 0;
+                continue;
+            }
+
+            uint32_t edge = first_edge;
+            do {
+                vertex_neighbours[adjacency_count] = hull.get_edge_end(edge);
+                vertex_faces[adjacency_count] = hull.half_edges[edge].face;
+                adjacency_count++;
+
+                edge = hull.get_next_outgoing(edge);
+            } while(edge != first_edge && adjacency_count < hull.half_edge_count);
+        }
+        vertex_adjacency_offsets[hull.vertex_count] = adjacency_count;
     }
 
     void clean() {
@@ -257,20 +401,54 @@ struct sColliderMesh {
         free(normals);
         free(plane_origin);
         free(edges);
+        free(edge_faces);
         free(face_connections);
+        free(face_offsets);
+        free(edge_directions);
+        free(vertex_corner);
+        free(vertex_adjacency_offsets);
+        free(vertex_neighbours);
+        free(vertex_faces);
     }
 
-    void apply_transform(const sTransform &transf) {
-        for(int i = 0; i < vertices_count; i++) {
-            vertices[i] = transf.apply(vertices[i]);
+    // Write the world space data of a mesh that shares the topology of
+    // a local space hull (see the shape library), without allocations
+    void update_from_local_hull(const sColliderMesh &local_hull,
+                                const sTransform &transform) {
+        // Rotate the axis once, and build the points as a
+        // linear combination of them
+        const sVector3 axis_x = transform.apply_rotation({1.0f, 0.0f, 0.0f});
+        const sVector3 axis_y = transform.apply_rotation({0.0f, 1.0f, 0.0f});
+        const sVector3 axis_z = transform.apply_rotation({0.0f, 0.0f, 1.0f});
+
+        const sVector3 scaled_x = axis_x.mult(transform.scale.x);
+        const sVector3 scaled_y = axis_y.mult(transform.scale.y);
+        const sVector3 scaled_z = axis_z.mult(transform.scale.z);
+
+        // The normals are transformed with the inverse of the scale
+        const sVector3 normal_x = axis_x.mult(1.0f / transform.scale.x);
+        const sVector3 normal_y = axis_y.mult(1.0f / transform.scale.y);
+        const sVector3 normal_z = axis_z.mult(1.0f / transform.scale.z);
+
+        for(uint32_t i = 0; i < vertices_count; i++) {
+            const sVector3 &local = local_hull.vertices[i];
+            vertices[i] = transform.position.sum(scaled_x.mult(local.x)).sum(scaled_y.mult(local.y)).sum(scaled_z.mult(local.z));
         }
 
-        for(int i = 0; i < face_count; i++) {
-            normals[i] = transf.apply_rotation(normals[i]);
-            plane_origin[i] = transf.apply(plane_origin[i]);
+        for(uint32_t i = 0; i < face_count; i++) {
+            const sVector3 &local_origin = local_hull.plane_origin[i];
+            const sVector3 &local_normal = local_hull.normals[i];
+            plane_origin[i] = transform.position.sum(scaled_x.mult(local_origin.x)).sum(scaled_y.mult(local_origin.y)).sum(scaled_z.mult(local_origin.z));
+            normals[i] = normal_x.mult(local_normal.x).sum(normal_y.mult(local_normal.y)).sum(normal_z.mult(local_normal.z)).normalize();
+        }
+
+        for(uint32_t i = 0; i < edge_direction_count; i++) {
+            const sVector3 &local_direction = local_hull.edge_directions[i];
+            edge_directions[i] = scaled_x.mult(local_direction.x).sum(scaled_y.mult(local_direction.y)).sum(scaled_z.mult(local_direction.z)).normalize();
         }
 
-        std::cout << vertices[0].x << " " << std::endl;
+        const sVector3 &local_center = local_hull.mesh_center;
+        mesh_center = transform.position.sum(scaled_x.mult(local_center.x)).sum(scaled_y.mult(local_center.y)).sum(scaled_z.mult(local_center.z));
     }
 
     inline sVector3 get_support(const sVector3 &direction) const {
@@ -289,6 +467,94 @@ struct sColliderMesh {
         return vertices[support_index];
     }
 
+    // Hill climbing over the vertex adjacency: on a convex hull, a vertex
+    // without better neighbours is the support. The search starts on the
+    // unique vertex start_vertex (the support of a previous, close, query)
+    // and stores the resulting one on it.
+    // Falls back to the linear search if there is no adjacency
+    inline uint32_t get_support_vertex(const sVector3 &direction,
+                                       uint32_t *start_vertex) const {
+        if (vertex_adjacency_offsets == NULL) {
+            float best_projection = -FLT_MAX;
+            uint32_t support_index = 0;
+
+            for(uint32_t i = 0; i < vertices_count; i++) {
+                const float projection = dot_prod(vertices[i], direction);
+
+                if (projection > best_projection) {
+                    support_index = i;
+                    best_projection = projection;
+                }
+            }
+
+            return support_index;
+        }
+
+        uint32_t current = (*start_vertex < unique_vertices_count) ? *start_vertex : 0;
+        float best_projection = dot_prod(vertices[vertex_corner[current]], direction);
+
+        while(true) {
+            uint32_t best_neighbour = current;
+
+            for(uint32_t i = vertex_adjacency_offsets[current]; i < vertex_adjacency_offsets[current + 1]; i++) {
+                const float projection = dot_prod(vertices[vertex_corner[vertex_neighbours[i]]], direction);
+
+                if (projection > best_projection) {
+                    best_neighbour = vertex_neighbours[i];
+                    best_projection = projection;
+                }
+            }
+
+            if (best_neighbour == current) {
+                break;
+            }
+            current = best_neighbour;
+        }
+
+        *start_vertex = current;
+        return vertex_corner[current];
+    }
+
+    inline sVector3 get_support(const sVector3 &direction,
+                                uint32_t *start_vertex) const {
+        return vertices[get_support_vertex(direction, start_vertex)];
+    }
+
+    // The face arround the support vertex that is most aligned with the direction
+    inline uint32_t get_support_face(const sVector3 &direction,
+                                     uint32_t *start_vertex) const {
+        if (vertex_adjacency_offsets == NULL) {
+            float best_facing = -FLT_MAX;
+            uint32_t support_index = 0;
+
+            for(uint32_t i = 0; i < face_count; i++) {
+                const float facing = dot_prod(normals[i], direction);
+
+                if (facing > best_facing) {
+                    support_index = i;
+                    best_facing = facing;
+                }
+            }
+
+            return support_index;
+        }
+
+        get_support_vertex(direction, start_vertex);
+
+        float best_facing = -FLT_MAX;
+        uint32_t support_index = 0;
+        for(uint32_t i = vertex_adjacency_offsets[*start_vertex]; i < vertex_adjacency_offsets[*start_vertex + 1]; i++) {
+            const float facing = dot_prod(normals[vertex_faces[i]], direction);
+
+            if (facing > best_facing) {
+                support_index = vertex_faces[i];
+                best_facing = facing;
+            }
+        }
+
+        return support_index;
+    }
+
     inline uint32_t get_support_face(const sVector3 &direction) const {
         float best_projection = -FLT_MAX;
         uint32_t support_index = 0;
@@ -306,13 +572,18 @@ struct sColliderMesh {
         return support_index;
     }
 
+    // Face on the other side of the edge that starts on the corner
     inline uint32_t get_neighboor_of_face(const uint32_t face_id,
                                           const uint32_t neighboor) const {
-        return face_connections[(face_id * face_stride) + neighboor];
+        return face_connections[face_offsets[face_id] + neighboor];
     }
 
     inline sVector3* get_face(const uint32_t face_index) const {
-        return &vertices[face_index * face_stride];
+        return &vertices[face_offsets[face_index]];
+    }
+
+    inline uint32_t get_face_size(const uint32_t face_index) const {
+        return face_offsets[face_index + 1] - face_offsets[face_index];
     }
 
     inline sPlane get_plane_of_face(const uint32_t face_index) const {
@@ -329,6 +600,7 @@ struct sColliderMesh {
                                            const float sphere_radius,
                                            float *distance) const {
         sVector3 *face_vertices = get_face(face_index);
+        const uint32_t face_size = get_face_size(face_index);
 
         sPlane curr_plane = sPlane{plane_origin[face_index], normals[face_index]};
 
@@ -339,8 +611,8 @@ struct sColliderMesh {
 
             // iF the total angle is arround 360 de grees or 6.28 rads, is inside
             float angle_sum = 0.00;
-            for(uint32_t i = 0; i <= face_stride; i++) {
-                uint32_t j = (i+1) % face_stride;
+            for(uint32_t i = 0; i < face_size; i++) {
+                uint32_t j = (i+1) % face_size;
                 sVector3 v1 = curr_plane.project_point(face_vertices[i]).subs(origin_on_plane);
                 sVector3 v2 = curr_plane.project_point(face_vertices[j]).subs(origin_on_plane);
 
@@ -6,7 +6,9 @@
 #include "transform.h"
 #include "raw_geometry.h"
 #include "collider_mesh.h"
+#include "constants.h"
 #include "vector.h"
+#include <cfloat>
 #include <cstdint>
 
 
@@ -22,7 +24,8 @@ inline bool test_sphere_sphere_collision(const sVector3  &center1,
                                          sVector3 *normal,
                                          sVector3 *contact_points,
                                          float *contact_depth,
-                                         uint16_t *contanct_points_count) {
+                                         uint16_t *contanct_points_count,
+                                         float *separation = NULL) {
 
     sVector3 center1_to_2 = center1.subs(center2);
     float center_distance = center1_to_2.magnitude();
@@ -39,9 +42,14 @@ inline bool test_sphere_sphere_collision(const sVector3  &center1,
 
         return true;
     }
+
+    if (separation != NULL) {
+        *separation = center_distance - total_radius;
+    }
     return false;
 }
 
+// The normal goes from the plane to the sphere, and should be normalized
 inline bool test_plane_sphere_collision(const sVector3 &sphere_center,
                                         const float radius,
                                         const sVector3 &plane_origin,
@@ -49,7 +57,8 @@ inline bool test_plane_sphere_collision(const sVector3 &sphere_center,
                                         sVector3 *normal,
                                         sVector3 *contact_points,
                                         float *contact_depth,
-                                        uint16_t *contanct_points_count) {
+                                        uint16_t *contanct_points_count,
+                                        float *separation = NULL) {
     // Based arround the signed distance of the plane
     sPlane plane;
     plane.origin_point = plane_origin;
@@ -58,19 +67,168 @@ inline bool test_plane_sphere_collision(const sVector3 &sphere_center,
     float distance = plane.distance(sphere_center) - radius;
 
     if (distance < 0.0f) {
-        *normal = plane_normal.normalize();
+        *normal = plane_normal;
         contact_depth[0] = distance;
-        contact_points[0] = plane.project_point(sphere_center).sum(plane_origin.mult(distance));
+        contact_points[0] = sphere_center.subs(plane_normal.mult(radius));
 
         *contanct_points_count = 1;
 
-        //std::cout << "====================" << std::endl;
         return true;
     }
 
+    if (separation != NULL) {
+        *separation = distance;
+    }
     return false;
 }
 
+// The planes are infinite, so the contacts are just the points of the shape
+// bellow them: found via the support along -normal.
+// The normal goes from the plane to the shape, and should be normalized
+inline bool test_plane_capsule_collision(const sVector3 &capsule_start,
+                                         const sVector3 &capsule_end,
+                                         const float radius,
+                                         const sVector3 &plane_origin,
+                                         const sVector3 &plane_normal,
+                                         sVector3 *normal,
+                                         sVector3 *contact_points,
+                                         float *contact_depth,
+                                         uint16_t *contanct_points_count,
+                                         float *separation = NULL) {
+    const sVector3 ends[2] = {capsule_start, capsule_end};
+    float min_distance = FLT_MAX;
+    uint16_t contact_count = 0;
+
+    for(uint32_t i = 0; i < 2; i++) {
+        const float distance = dot_prod(plane_normal, ends[i].subs(plane_origin)) - radius;
+        min_distance = MIN(min_distance, distance);
+
+        if (distance < 0.0f) {
+            contact_points[contact_count] = ends[i].subs(plane_normal.mult(radius));
+            contact_depth[contact_count] = distance;
+            contact_count++;
+        }
+    }
+
+    if (contact_count == 0) {
+        if (separation != NULL) {
+            *separation = min_distance;
+        }
+        return false;
+    }
+
+    *normal = plane_normal;
+    *contanct_points_count = contact_count;
+
+    return true;
+}
+
+// The box's face most opposed to the normal holds its support vertex,
+// so its corners bellow the plane are the contacts
+inline bool test_plane_OBB_collision(const sTransform &box_transform,
+                                     const sVector3 &plane_origin,
+                                     const sVector3 &plane_normal,
+                                     sVector3 *normal,
+                                     sVector3 *contact_points,
+                                     float *contact_depth,
+                                     uint16_t *contanct_points_count,
+                                     float *separation = NULL) {
+    const sVector3 half_size = box_transform.scale.mult(0.5f);
+    const sVector3 local_normal = box_transform.apply_inverse_rotation(plane_normal);
+    const float n[3] = {local_normal.x, local_normal.y, local_normal.z};
+    const float h[3] = {half_size.x, half_size.y, half_size.z};
+
+    uint32_t face_axis = 0;
+    for(uint32_t i = 1; i < 3; i++) {
+        if (fabsf(n[i]) > fabsf(n[face_axis])) {
+            face_axis = i;
+        }
+    }
+    const uint32_t u = (face_axis + 1) % 3, v = (face_axis + 2) % 3;
+    const float corner_u[4] = {-1.0f, 1.0f, 1.0f, -1.0f};
+    const float corner_v[4] = {-1.0f, -1.0f, 1.0f, 1.0f};
+
+    float min_distance = FLT_MAX;
+    uint16_t contact_count = 0;
+    for(uint32_t i = 0; i < 4; i++) {
+        float corner[3];
+        corner[face_axis] = (n[face_axis] > 0.0f) ? -h[face_axis] : h[face_axis];
+        corner[u] = corner_u[i] * h[u];
+        corner[v] = corner_v[i] * h[v];
+
+        const sVector3 point = box_transform.apply_without_scale({corner[0], corner[1], corner[2]});
+        const float distance = dot_prod(plane_normal, point.subs(plane_origin));
+        min_distance = MIN(min_distance, distance);
+
+        if (distance < 0.0f) {
+            contact_points[contact_count] = point;
+            contact_depth[contact_count] = distance;
+            contact_count++;
+        }
+    }
+
+    if (contact_count == 0) {
+        if (separation != NULL) {
+            *separation = min_distance;
+        }
+        return false;
+    }
+
+    *normal = plane_normal;
+    *contanct_points_count = contact_count;
+
+    return true;
+}
+
+// The support vertex is warm started on support_vertex
+inline bool test_plane_hull_collision(const sColliderMesh &hull_mesh,
+                                      uint32_t *support_vertex,
+                                      const sVector3 &plane_origin,
+                                      const sVector3 &plane_normal,
+                                      sVector3 *normal,
+                                      sVector3 *contact_points,
+                                      float *contact_depth,
+                                      uint16_t *contanct_points_count,
+                                      float *separation = NULL) {
+    const sVector3 direction = plane_normal.invert();
+    const sVector3 support = hull_mesh.get_support(direction, support_vertex);
+    const float support_distance = dot_prod(plane_normal, support.subs(plane_origin));
+
+    if (support_distance >= 0.0f) {
+        if (separation != NULL) {
+            *separation = support_distance;
+        }
+        return false;
+    }
+
+    // The support vertex is on the face, so there is at least one contact
+    const uint32_t face = hull_mesh.get_support_face(direction, support_vertex);
+    const sVector3 *face_vertices = hull_mesh.get_face(face);
+    const uint32_t face_size = hull_mesh.get_face_size(face);
+
+    uint16_t contact_count = 0;
+    for(uint32_t i = 0; i < face_size && contact_count < MAX_CONTACT_COUNT; i++) {
+        const float distance = dot_prod(plane_normal, face_vertices[i].subs(plane_origin));
+
+        if (distance < 0.0f) {
+            contact_points[contact_count] = face_vertices[i];
+            contact_depth[contact_count] = distance;
+            contact_count++;
+        }
+    }
+
+    if (contact_count == 0) {
+        contact_points[0] = support;
+        contact_depth[0] = support_distance;
+        contact_count = 1;
+    }
+
+    *normal = plane_normal;
+    *contanct_points_count = contact_count;
+
+    return true;
+}
+
 inline bool test_cube_cube_collision(const sTransform &cube1_trasform,
                                      const sRawGeometry &cube1_geometry,
                                      const sTransform &cube2_trasform,
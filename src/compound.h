@@ -0,0 +1,102 @@
+#ifndef COMPOUND_H_
+#define COMPOUND_H_
+
+#include "phys_broadphase.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+/**
+ * Compound collider
+ * Several child bodies rigidly attached to a single rigid body. The children
+ * keep their own shape, and narrowphase data, but they are moved by the
+ * compound, and only the compound is on the broadphase.
+ * The children are indexed by an AABB tree on the compound's local space,
+ * that is only rebuilt when the children change.
+ * */
+
+struct sCompound {
+    uint32_t    *child_handles = NULL;
+    uint32_t    child_count = 0;
+    uint32_t    child_capacity = 0;
+
+    // The user ids are the children's slots
+    sAABBTree   tree = {};
+    sAABB       local_aabb = {};
+    // Radius of the sphere arround the compound's position that contains
+    // all the children
+    float       bounding_radius = 0.0f;
+    // The compound's position is its center of mass: this is its offset
+    // from the frame where the children are attached
+    sVector3    center_of_mass = {};
+
+    // Result of the last query
+    uint32_t    *query_children = NULL;
+    uint32_t    query_count = 0;
+
+    void init() {
+        child_count = 0;
+        child_capacity = 4;
+        child_handles = (uint32_t*) malloc(sizeof(uint32_t) * child_capacity);
+        query_children = (uint32_t*) malloc(sizeof(uint32_t) * child_capacity);
+        query_count = 0;
+        tree.init(child_capacity * 2);
+        local_aabb = {};
+        bounding_radius = 0.0f;
+        center_of_mass = {0.0f, 0.0f, 0.0f};
+    }
+
+    void clean() {
+        free(child_handles);
+        free(query_children);
+        child_handles = NULL;
+        query_children = NULL;
+        child_count = 0;
+        child_capacity = 0;
+        query_count = 0;
+        tree.clean();
+    }
+
+    void add_child(const uint32_t child_handle) {
+        if (child_count == child_capacity) {
+            child_capacity *= 2;
+            child_handles = (uint32_t*) realloc(child_handles, sizeof(uint32_t) * child_capacity);
+            query_children = (uint32_t*) realloc(query_children, sizeof(uint32_t) * child_capacity);
+        }
+
+        child_handles[child_count++] = child_handle;
+    }
+
+    // Returns false if the handle is not a child of the compound
+    bool remove_child(const uint32_t child_handle) {
+        for(uint32_t i = 0; i < child_count; i++) {
+            if (child_handles[i] == child_handle) {
+                child_handles[i] = child_handles[--child_count];
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Reinsert all the children, with their local AABBs
+    void rebuild_tree(const sAABB *child_aabbs,
+                      const uint32_t *child_slots) {
+        tree.clean();
+        tree.init(child_capacity * 2);
+
+        for(uint32_t i = 0; i < child_count; i++) {
+            tree.create_proxy(child_aabbs[i], child_slots[i]);
+            local_aabb = (i == 0) ? child_aabbs[i] : local_aabb.merge(child_aabbs[i]);
+        }
+    }
+
+    // Stores on query_children the slots of the children whose local AABB
+    // overlaps the bounds, on the compound's local space
+    inline uint32_t query(const sAABB &local_bounds) {
+        query_count = tree.query(local_bounds, query_children);
+        return query_count;
+    }
+};
+
+#endif // COMPOUND_H_
@@ -5,11 +5,19 @@
 #include "vector.h"
 #include "constants.h"
 
+// The narrowphase can find up to MAX_CONTACT_COUNT contacts, but they are
+// reduced to this many per manifold (see manifold_reduction.h)
+#define MANIFOLD_MAX_CONTACT_COUNT 4u
+
 enum eColiderTypes : uint8_t {
     SPHERE_COLLIDER = 0,
     PLANE_COLLIDER,
     CUBE_COLLIDER,
     CAPSULE_COLLIDER,
+    HULL_COLLIDER,
+    TRIANGLE_MESH_COLLIDER,
+    HEIGHTFIELD_COLLIDER,
+    COMPOUND_COLLIDER,
     COLLIDER_COUNT
 };
 
@@ -26,18 +34,29 @@ struct sContactData {
 };
 
 struct sCollisionManifold {
-    uint8_t   obj1;
-    uint8_t   obj2;
+    uint32_t  obj1;
+    uint32_t  obj2;
 
     sVector3 normal;
     sVector3 tangents[2];
 
     uint8_t       contact_count = 0;
-    sVector3      contact_point[MAX_CONTACT_COUNT];
-    float         contanct_normal_impulse[MAX_CONTACT_COUNT]; // Contact constrain
-    float         contanct_tang_impulse[2][MAX_CONTACT_COUNT]; // Friction constraint
-    float         contact_depth[MAX_CONTACT_COUNT];
-    sContactData  precompute_data[MAX_CONTACT_COUNT];
+    sVector3      contact_point[MANIFOLD_MAX_CONTACT_COUNT];
+    float         contanct_normal_impulse[MANIFOLD_MAX_CONTACT_COUNT]; // Contact constrain
+    float         contanct_tang_impulse[2][MANIFOLD_MAX_CONTACT_COUNT]; // Friction constraint
+    float         contact_depth[MANIFOLD_MAX_CONTACT_COUNT];
+    sContactData  precompute_data[MANIFOLD_MAX_CONTACT_COUNT];
+};
+
+// Output of a narrowphase test: the normal goes from the first body
+// to the second one
+struct sNarrowphaseResult {
+    sVector3  normal = {};
+    sVector3  contact_points[MAX_CONTACT_COUNT] = {};
+    float     contact_depth[MAX_CONTACT_COUNT] = {};
+    uint16_t  contact_count = 0;
+    // Lower bound of the distance, if the test finds no collision
+    float     separation = 0.0f;
 };
 
 
@@ -4,65 +4,198 @@
 //**
 // Contact Manger
 // For contact caching
+// The manifolds are stored on a dense, growable, array, and indexed by the
+// pair of object ids via a hash map.
+// The manifolds that did not collide on the last frame are released
+// at the start of the next frame.
+// It also stores a cache of narrowphase data per broadphase pair (collided
+// or not), for the temporal coherence of the tests. The caches that were not
+// tested on the last frame are released the same way as the manifolds.
 //*/
 #include "constants.h"
 #include "vector.h"
 #include "contact_data.h"
+#include "gjk.h"
+#include "manifold_reduction.h"
+#include "sat.h"
+#include "data_structs/pair_hash_map.h"
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <sys/types.h>
 
-#define MAX_UINT16 65535
+struct sPairCache {
+    uint32_t  obj1 = 0;
+    uint32_t  obj2 = 0;
 
-inline uint16_t get_collision_id(const uint8_t id1, const uint8_t id2) {
-    uint8_t min_id = 0, max_id = 0;
+    // Warm start of the hill climbing support queries, per object
+    uint32_t  support_vertex[2] = {0, 0};
 
-    if (id1 >= id2) {
-        min_id = id2;
-        max_id = id1;
-    } else {
-        min_id = id1;
-        max_id = id2;
+    // Lower bound of the distance between the pair, minus what they moved
+    // since it was found. The test is skipped while it is over 0
+    float     separation = 0.0f;
+
+    // Last GJK simplex, for simplex_obj - the other object
+    GJK::sSimplexCache  simplex = {};
+    uint32_t  simplex_obj = 0;
+
+    // Last SAT axis, with sat_axis_obj as the first mesh
+    SAT::sSATAxisCache  sat_axis = {};
+    uint32_t  sat_axis_obj = 0;
+
+    inline uint32_t* get_support_vertex(const uint32_t obj) {
+        return &support_vertex[(obj == obj1) ? 0 : 1];
+    }
+
+    // The simplex, oriented for obj as the first shape of the test
+    inline GJK::sSimplexCache* get_simplex_cache(const uint32_t obj) {
+        if (obj != simplex_obj) {
+            simplex.invert();
+            simplex_obj = obj;
+        }
+        return &simplex;
     }
 
-    return (uint16_t) min_id | ((uint16_t) max_id << 8);
-}
+    // The SAT axis, oriented for obj as the first mesh of the test
+    inline SAT::sSATAxisCache* get_sat_axis_cache(const uint32_t obj) {
+        if (obj != sat_axis_obj) {
+            sat_axis.swap_meshes();
+            sat_axis_obj = obj;
+        }
+        return &sat_axis;
+    }
+};
 
 struct sCollisionManager {
     // For the obj ids and the collision
-    uint16_t id_collision_map[MAX_UINT16] = {};
-    bool id_map_in_use[MAX_UINT16] = {};
+    sPairHashMap        id_collision_map = {};
+
+    sCollisionManifold  *manifold = NULL;
+    uint64_t            *manifold_keys = NULL;
+    bool                *has_collided_on_frame = NULL;
+
+    uint32_t            manifold_count = 0;
+    uint32_t            manifold_capacity = 0;
+
+    // Narrowphase cache, per tested pair
+    sPairHashMap        pair_cache_map = {};
+    sPairCache          *pair_cache = NULL;
+    uint64_t            *pair_cache_keys = NULL;
+    bool                *is_pair_cache_used = NULL;
+    uint32_t            pair_cache_count = 0;
+    uint32_t            pair_cache_capacity = 0;
+
+    void init(const uint32_t initial_capacity = MAX_COLLISION_COUNT) {
+        manifold_count = 0;
+        manifold_capacity = 0;
+        grow((initial_capacity == 0) ? 16 : initial_capacity);
+
+        id_collision_map.init(manifold_capacity * 2);
+
+        pair_cache_count = 0;
+        pair_cache_capacity = 0;
+        grow_pair_cache(manifold_capacity);
+
+        pair_cache_map.init(pair_cache_capacity * 2);
+    }
+
+    void clean() {
+        free(manifold);
+        free(manifold_keys);
+        free(has_collided_on_frame);
+        manifold = NULL;
+        manifold_keys = NULL;
+        has_collided_on_frame = NULL;
+        manifold_count = 0;
+        manifold_capacity = 0;
+
+        id_collision_map.clean();
+
+        free(pair_cache);
+        free(pair_cache_keys);
+        free(is_pair_cache_used);
+        pair_cache = NULL;
+        pair_cache_keys = NULL;
+        is_pair_cache_used = NULL;
+        pair_cache_count = 0;
+        pair_cache_capacity = 0;
 
-    sCollisionManifold manifold[MAX_COLLISION_COUNT];
-    bool is_collision_in_use[MAX_COLLISION_COUNT];
+        pair_cache_map.clean();
+    }
+
+    void grow(const uint32_t new_capacity) {
+        manifold_capacity = new_capacity;
+        manifold = (sCollisionManifold*) realloc(manifold, sizeof(sCollisionManifold) * manifold_capacity);
+        manifold_keys = (uint64_t*) realloc(manifold_keys, sizeof(uint64_t) * manifold_capacity);
+        has_collided_on_frame = (bool*) realloc(has_collided_on_frame, sizeof(bool) * manifold_capacity);
+    }
 
-    bool has_collided_on_frame[MAX_COLLISION_COUNT];
+    void grow_pair_cache(const uint32_t new_capacity) {
+        pair_cache_capacity = new_capacity;
+        pair_cache = (sPairCache*) realloc(pair_cache, sizeof(sPairCache) * pair_cache_capacity);
+        pair_cache_keys = (uint64_t*) realloc(pair_cache_keys, sizeof(uint64_t) * pair_cache_capacity);
+        is_pair_cache_used = (bool*) realloc(is_pair_cache_used, sizeof(bool) * pair_cache_capacity);
+    }
 
     void clean_frame() {
-        memset(has_collided_on_frame, false, sizeof(sCollisionManager::has_collided_on_frame));
+        // Release the manifolds that did not collide on the last frame
+        // Iterate backwards, since the releasing swaps with the last one
+        for(uint32_t i = manifold_count; i > 0; i--) {
+            if (!has_collided_on_frame[i - 1]) {
+                release_collision_by_index(i - 1);
+            }
+        }
+
+        memset(has_collided_on_frame, false, sizeof(bool) * manifold_count);
+
+        // Release the caches of the pairs that were not tested
+        for(uint32_t i = pair_cache_count; i > 0; i--) {
+            if (!is_pair_cache_used[i - 1]) {
+                release_pair_cache_by_index(i - 1);
+            }
+        }
+
+        memset(is_pair_cache_used, false, sizeof(bool) * pair_cache_count);
     }
 
-    void renew_contacts_to_collision(const uint8_t obj1,
-                                     const uint8_t obj2,
+    void renew_contacts_to_collision(const uint32_t obj1,
+                                     const uint32_t obj2,
+                                     const sVector3 &normal,
                                      const sVector3 *incoming_points,
                                      const float *depth_of_incomming_points,
                                      const uint8_t incoming_point_count) {
-        uint16_t col_id = get_collision(obj1, obj2);
+        // Reduce the contacts to the ones that fit on the manifold
+        sVector3 reduced_points[MAX_CONTACT_COUNT];
+        float reduced_depth[MAX_CONTACT_COUNT];
+        if (incoming_point_count > MANIFOLD_MAX_CONTACT_COUNT) {
+            memcpy(reduced_points, incoming_points, incoming_point_count * sizeof(sVector3));
+            memcpy(reduced_depth, depth_of_incomming_points, incoming_point_count * sizeof(float));
+            const uint8_t reduced_count = (uint8_t) MANIFOLD::reduce_contacts(normal,
+                                                                              reduced_points,
+                                                                              reduced_depth,
+                                                                              incoming_point_count);
+
+            renew_contacts_to_collision(obj1, obj2, normal, reduced_points, reduced_depth, reduced_count);
+            return;
+        }
+
+        uint32_t col_id = get_collision(obj1, obj2);
 
         has_collided_on_frame[col_id] = true;
 
         sCollisionManifold *coll = &manifold[col_id];
-        float old_contact_normal_impulse[MAX_CONTACT_COUNT];
-        float old_contact_tang_impulse[2][MAX_CONTACT_COUNT];
-        sVector3 old_contanct_position[MAX_CONTACT_COUNT];
+        float old_contact_normal_impulse[MANIFOLD_MAX_CONTACT_COUNT];
+        float old_contact_tang_impulse[2][MANIFOLD_MAX_CONTACT_COUNT];
+        sVector3 old_contanct_position[MANIFOLD_MAX_CONTACT_COUNT];
         uint8_t old_contact_count = coll->contact_count;
 
         coll->obj1 = obj1;
         coll->obj2 = obj2;
+        coll->normal = normal;
 
         // Store old collision data
-        memcpy(old_contact_normal_impulse, coll->contact_depth, sizeof(old_contact_normal_impulse));
-        memcpy(old_contact_tang_impulse, coll->contact_depth, sizeof(old_contact_tang_impulse));
+        memcpy(old_contact_normal_impulse, coll->contanct_normal_impulse, sizeof(old_contact_normal_impulse));
+        memcpy(old_contact_tang_impulse, coll->contanct_tang_impulse, sizeof(old_contact_tang_impulse));
         memcpy(old_contanct_position, coll->contact_point, sizeof(old_contanct_position));
 
         // Copy new data to collision
@@ -81,8 +214,8 @@ struct sCollisionManager {
                     // If its really close, then they are the same point,
                     // transfer the old impulse, for warmstarting
                     coll->contanct_normal_impulse[j] = old_contact_normal_impulse[i];
-                    coll->contanct_tang_impulse[j][0] = old_contact_tang_impulse[i][0];
-                    coll->contanct_tang_impulse[j][1] = old_contact_tang_impulse[i][1];
+                    coll->contanct_tang_impulse[0][j] = old_contact_tang_impulse[0][i];
+                    coll->contanct_tang_impulse[1][j] = old_contact_tang_impulse[1][i];
                     break; // Early out
                 }
             }
@@ -91,33 +224,110 @@ struct sCollisionManager {
 
     }
 
-    uint16_t get_collision(const uint8_t obj1,
-                           const uint8_t obj2) {
-        uint16_t col_id = get_collision_id(obj1, obj2);
+    uint32_t get_collision(const uint32_t obj1,
+                           const uint32_t obj2) {
+        const uint64_t key = get_pair_key(obj1, obj2);
+        const uint32_t col_id = id_collision_map.get(key);
 
         // There is no collision for this two object
-        if (!id_map_in_use[col_id]) {
-            uint16_t i = 0;
-            for(; i < MAX_COLLISION_COUNT; i++) {
-                if (!is_collision_in_use[i]) {
-                    break;
-                }
+        if (col_id == PAIR_MAP_NOT_FOUND) {
+            if (manifold_count == manifold_capacity) {
+                grow(manifold_capacity * 2);
             }
 
-            // TODO error is there cannot be any more collisions
-            is_collision_in_use[i] = true;
-            id_collision_map[col_id] = i;
-            id_map_in_use[col_id] = true;
+            const uint32_t i = manifold_count++;
+            id_collision_map.set(key, i);
+            manifold_keys[i] = key;
+            has_collided_on_frame[i] = false;
             manifold[i].contact_count = 0;
             return i;
         }
 
-        return id_collision_map[col_id];
+        return col_id;
+    }
+
+    // Get or create the narrowphase cache of the pair, and mark it as used
+    // on this frame. The pointer is valid until the next cache creation
+    sPairCache* get_pair_cache(const uint32_t obj1,
+                               const uint32_t obj2) {
+        const uint64_t key = get_pair_key(obj1, obj2);
+        uint32_t cache_id = pair_cache_map.get(key);
+
+        if (cache_id == PAIR_MAP_NOT_FOUND) {
+            if (pair_cache_count == pair_cache_capacity) {
+                grow_pair_cache(pair_cache_capacity * 2);
+            }
+
+            cache_id = pair_cache_count++;
+            pair_cache_map.set(key, cache_id);
+            pair_cache_keys[cache_id] = key;
+            pair_cache[cache_id] = sPairCache{};
+            pair_cache[cache_id].obj1 = obj1;
+            pair_cache[cache_id].obj2 = obj2;
+        }
+
+        is_pair_cache_used[cache_id] = true;
+        return &pair_cache[cache_id];
+    }
+
+    void release_pair_cache_by_index(const uint32_t cache_id) {
+        const uint32_t last = pair_cache_count - 1;
+
+        pair_cache_map.remove(pair_cache_keys[cache_id]);
+
+        if (cache_id != last) {
+            pair_cache[cache_id] = pair_cache[last];
+            pair_cache_keys[cache_id] = pair_cache_keys[last];
+            is_pair_cache_used[cache_id] = is_pair_cache_used[last];
+            pair_cache_map.set(pair_cache_keys[cache_id], cache_id);
+        }
+
+        pair_cache_count--;
     }
 
-    void init() {
-        memset(id_map_in_use, false, 65553);
-        memset(is_collision_in_use, false, MAX_COLLISION_COUNT);
+    // Free the manifold of the two objects, if there is one
+    void release_collision(const uint32_t obj1,
+                           const uint32_t obj2) {
+        const uint32_t col_id = id_collision_map.get(get_pair_key(obj1, obj2));
+
+        if (col_id == PAIR_MAP_NOT_FOUND) {
+            return;
+        }
+
+        release_collision_by_index(col_id);
+    }
+
+    // Free all the manifolds & pair caches of an object
+    void release_object_collisions(const uint32_t obj) {
+        for(uint32_t i = manifold_count; i > 0; i--) {
+            const sCollisionManifold &coll = manifold[i - 1];
+            if (coll.obj1 == obj || coll.obj2 == obj) {
+                release_collision_by_index(i - 1);
+            }
+        }
+
+        for(uint32_t i = pair_cache_count; i > 0; i--) {
+            const sPairCache &cache = pair_cache[i - 1];
+            if (cache.obj1 == obj || cache.obj2 == obj) {
+                release_pair_cache_by_index(i - 1);
+            }
+        }
+    }
+
+    // Swap the manifold with the last one, to keep the array dense
+    void release_collision_by_index(const uint32_t col_id) {
+        const uint32_t last = manifold_count - 1;
+
+        id_collision_map.remove(manifold_keys[col_id]);
+
+        if (col_id != last) {
+            manifold[col_id] = manifold[last];
+            manifold_keys[col_id] = manifold_keys[last];
+            has_collided_on_frame[col_id] = has_collided_on_frame[last];
+            id_collision_map.set(manifold_keys[col_id], col_id);
+        }
+
+        manifold_count--;
     }
 };
 
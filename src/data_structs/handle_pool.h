@@ -0,0 +1,128 @@
+#ifndef _HANDLE_POOL_H_
+#define _HANDLE_POOL_H_
+
+#include <cstdint>
+#include <cstdlib>
+
+/**
+ * Handle pool
+ * Generational 32 bit handles: the lower bits are the index of the slot,
+ * and the upper bits are the generation of the slot, that is increased
+ * each time the slot is freed. So an old handle to a reused slot
+ * can be detected as invalid.
+ * The free slots are stored on a intrusive free list, so allocating and
+ * freeing is O(1)
+ * */
+
+#define HANDLE_INDEX_BITS 22
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1u << (32 - HANDLE_INDEX_BITS)) - 1)
+#define HANDLE_MAX_COUNT (1u << HANDLE_INDEX_BITS)
+#define INVALID_HANDLE 0xFFFFFFFF
+
+inline uint32_t make_handle(const uint32_t index,
+                            const uint32_t generation) {
+    return (index & HANDLE_INDEX_MASK) | ((generation & HANDLE_GENERATION_MASK) << HANDLE_INDEX_BITS);
+}
+
+inline uint32_t get_handle_index(const uint32_t handle) {
+    return handle & HANDLE_INDEX_MASK;
+}
+
+inline uint32_t get_handle_generation(const uint32_t handle) {
+    return handle >> HANDLE_INDEX_BITS;
+}
+
+struct sHandlePool {
+    uint32_t  *generations = NULL;
+    bool      *in_use = NULL;
+    // Next free slot of the free list, only valid on free slots
+    uint32_t  *next_free = NULL;
+
+    uint32_t  capacity = 0;
+    uint32_t  count = 0;
+    uint32_t  free_list = INVALID_HANDLE;
+
+    // =================
+    // LIFECYCLE FUNCTIONS
+    // ================
+    void init(const uint32_t initial_capacity) {
+        capacity = 0;
+        count = 0;
+        free_list = INVALID_HANDLE;
+
+        grow((initial_capacity == 0) ? 16 : initial_capacity);
+    }
+
+    void clean() {
+        free(generations);
+        free(in_use);
+        free(next_free);
+        generations = NULL;
+        in_use = NULL;
+        next_free = NULL;
+        capacity = 0;
+        count = 0;
+        free_list = INVALID_HANDLE;
+    }
+
+    // Add the new slots at the end of the free list
+    void grow(const uint32_t new_capacity) {
+        const uint32_t old_capacity = capacity;
+        capacity = new_capacity;
+
+        generations = (uint32_t*) realloc(generations, sizeof(uint32_t) * capacity);
+        in_use = (bool*) realloc(in_use, sizeof(bool) * capacity);
+        next_free = (uint32_t*) realloc(next_free, sizeof(uint32_t) * capacity);
+
+        for(uint32_t i = old_capacity; i < capacity; i++) {
+            generations[i] = 0;
+            in_use[i] = false;
+            next_free[i] = (i + 1 < capacity) ? i + 1 : free_list;
+        }
+        free_list = old_capacity;
+    }
+
+    // =================
+    // HANDLE FUNCTIONS
+    // ================
+    inline bool is_full() const {
+        return free_list == INVALID_HANDLE;
+    }
+
+    // Returns the handle, or INVALID_HANDLE if there is no free slots
+    inline uint32_t allocate() {
+        if (free_list == INVALID_HANDLE) {
+            return INVALID_HANDLE;
+        }
+
+        const uint32_t index = free_list;
+        free_list = next_free[index];
+        in_use[index] = true;
+        count++;
+
+        return make_handle(index, generations[index]);
+    }
+
+    inline void release(const uint32_t handle) {
+        const uint32_t index = get_handle_index(handle);
+
+        in_use[index] = false;
+        generations[index] = (generations[index] + 1) & HANDLE_GENERATION_MASK;
+        // The last slot skips the generation that encodes as INVALID_HANDLE
+        if (make_handle(index, generations[index]) == INVALID_HANDLE) {
+            generations[index] = 0;
+        }
+        next_free[index] = free_list;
+        free_list = index;
+        count--;
+    }
+
+    inline bool is_valid(const uint32_t handle) const {
+        const uint32_t index = get_handle_index(handle);
+
+        return handle != INVALID_HANDLE && index < capacity && in_use[index] && generations[index] == get_handle_generation(handle);
+    }
+};
+
+#endif // _HANDLE_POOL_H_
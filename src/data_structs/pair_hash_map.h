@@ -0,0 +1,171 @@
+#ifndef _PAIR_HASH_MAP_H_
+#define _PAIR_HASH_MAP_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#define PAIR_MAP_EMPTY_KEY 0xFFFFFFFFFFFFFFFF
+#define PAIR_MAP_NOT_FOUND 0xFFFFFFFF
+
+/**
+ * Pair hash map
+ * An open adressing hash map (with linear probing) that maps a pair of ids
+ * to a uint32 value. Made for the pair caches of the broadphase and the
+ * contact manager, where the lookup needs to be O(1) and without
+ * allocations per insertion.
+ * Removal uses backward shifting, so there are no tombstones
+ * */
+
+inline uint64_t get_pair_key(const uint32_t id1,
+                             const uint32_t id2) {
+    if (id1 < id2) {
+        return ((uint64_t) id1) | (((uint64_t) id2) << 32);
+    }
+    return ((uint64_t) id2) | (((uint64_t) id1) << 32);
+}
+
+// Hash function from MurmurHash3's finalizer
+inline uint64_t hash_pair_key(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+struct sPairHashMap {
+    uint64_t  *keys = NULL;
+    uint32_t  *values = NULL;
+
+    // Always a power of 2
+    uint32_t  capacity = 0;
+    uint32_t  count = 0;
+
+    // =================
+    // LIFECYCLE FUNCTIONS
+    // ================
+    void init(const uint32_t initial_capacity) {
+        capacity = 16;
+        while(capacity < initial_capacity) {
+            capacity *= 2;
+        }
+        count = 0;
+
+        keys = (uint64_t*) malloc(sizeof(uint64_t) * capacity);
+        values = (uint32_t*) malloc(sizeof(uint32_t) * capacity);
+        memset(keys, 0xFF, sizeof(uint64_t) * capacity);
+    }
+
+    void clean() {
+        free(keys);
+        free(values);
+        keys = NULL;
+        values = NULL;
+        capacity = 0;
+        count = 0;
+    }
+
+    void clear() {
+        memset(keys, 0xFF, sizeof(uint64_t) * capacity);
+        count = 0;
+    }
+
+    // =================
+    // MAP FUNCTIONS
+    // ================
+    inline uint32_t get(const uint64_t key) const {
+        const uint32_t mask = capacity - 1;
+        uint32_t index = (uint32_t) hash_pair_key(key) & mask;
+
+        while(keys[index] != PAIR_MAP_EMPTY_KEY) {
+            if (keys[index] == key) {
+                return values[index];
+            }
+            index = (index + 1) & mask;
+        }
+
+        return PAIR_MAP_NOT_FOUND;
+    }
+
+    // Adds or overwrites the value of the key
+    inline void set(const uint64_t key,
+                    const uint32_t value) {
+        // Keep the load factor under 0.5
+        if ((count + 1) * 2 > capacity) {
+            grow();
+        }
+
+        const uint32_t mask = capacity - 1;
+        uint32_t index = (uint32_t) hash_pair_key(key) & mask;
+
+        while(keys[index] != PAIR_MAP_EMPTY_KEY) {
+            if (keys[index] == key) {
+                values[index] = value;
+                return;
+            }
+            index = (index + 1) & mask;
+        }
+
+        keys[index] = key;
+        values[index] = value;
+        count++;
+    }
+
+    inline bool remove(const uint64_t key) {
+        const uint32_t mask = capacity - 1;
+        uint32_t index = (uint32_t) hash_pair_key(key) & mask;
+
+        while(keys[index] != key) {
+            if (keys[index] == PAIR_MAP_EMPTY_KEY) {
+                return false;
+            }
+            index = (index + 1) & mask;
+        }
+
+        // Backward shift the following elements of the cluster
+        uint32_t next = (index + 1) & mask;
+        while(keys[next] != PAIR_MAP_EMPTY_KEY) {
+            const uint32_t ideal = (uint32_t) hash_pair_key(keys[next]) & mask;
+
+            // Move the element if its ideal position is not between
+            // the hole and its current position
+            const bool in_between = (index <= next) ? (index < ideal && ideal <= next) : (index < ideal || ideal <= next);
+            if (!in_between) {
+                keys[index] = keys[next];
+                values[index] = values[next];
+                index = next;
+            }
+            next = (next + 1) & mask;
+        }
+
+        keys[index] = PAIR_MAP_EMPTY_KEY;
+        count--;
+
+        return true;
+    }
+
+    void grow() {
+        uint64_t *old_keys = keys;
+        uint32_t *old_values = values;
+        const uint32_t old_capacity = capacity;
+
+        capacity *= 2;
+        count = 0;
+        keys = (uint64_t*) malloc(sizeof(uint64_t) * capacity);
+        values = (uint32_t*) malloc(sizeof(uint32_t) * capacity);
+        memset(keys, 0xFF, sizeof(uint64_t) * capacity);
+
+        for(uint32_t i = 0; i < old_capacity; i++) {
+            if (old_keys[i] != PAIR_MAP_EMPTY_KEY) {
+                set(old_keys[i], old_values[i]);
+            }
+        }
+
+        free(old_keys);
+        free(old_values);
+    }
+};
+
+#endif // _PAIR_HASH_MAP_H_
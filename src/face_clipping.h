@@ -2,106 +2,154 @@
 #define FACE_CLIPPING_H_
 
 #include "collider_mesh.h"
+#include "constants.h"
 #include "geometry.h"
+#include "manifold_reduction.h"
 #include "math.h"
 #include "vector.h"
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <exception>
 
+// The faces of up to this many vertices are clipped on the stack, the
+// bigger ones (large flat regions of the hulls) on the heap
+#define CLIPPING_STACK_FACE_SIZE 64u
+// Each clipping plane can add one point to the convex polygon: enough for
+// a face clipped against another one, or against a triangle
+#define CLIPPING_STACK_POINT_COUNT (CLIPPING_STACK_FACE_SIZE * 2u + 1u)
+
 namespace clipping {
+    // Ping-pong buffers of the clipping, and the depths of the result.
+    // The stack storage is not cleared
+    struct sClipBuffer {
+        sVector3  stack_points[CLIPPING_STACK_POINT_COUNT * 2];
+        float     stack_depth[CLIPPING_STACK_POINT_COUNT];
+
+        // Only for the faces bigger than the stack storage
+        sVector3  *heap_points = NULL;
+        float     *heap_depth = NULL;
+
+        sVector3  *to_clip = NULL;
+        sVector3  *clipped = NULL;
+        float     *depth = NULL;
+
+        void init(const uint32_t max_points) {
+            if (max_points > CLIPPING_STACK_POINT_COUNT) {
+                heap_points = (sVector3*) malloc(sizeof(sVector3) * max_points * 2);
+                heap_depth = (float*) malloc(sizeof(float) * max_points);
+                to_clip = heap_points;
+                depth = heap_depth;
+            } else {
+                to_clip = stack_points;
+                depth = stack_depth;
+            }
+            clipped = &to_clip[max_points];
+        }
+
+        void clean() {
+            free(heap_points);
+            free(heap_depth);
+            heap_points = NULL;
+            heap_depth = NULL;
+            to_clip = NULL;
+            clipped = NULL;
+            depth = NULL;
+        }
+
+        inline void swap() {
+            sVector3 *tmp = to_clip;
+            to_clip = clipped;
+            clipped = tmp;
+        }
+    };
+
+    // Sutherland-Hodgman step: keep the part of the polygon that is behind the plane
+    //   Iterate all the edges of the polygon
+    //      If both vertices are inside,
+    //         then we add the second(last) point
+    //      If the first is outside, and the second is inside,
+    //         we add the intersection point, and the second
+    //      If the firs is inside and the second is outside,
+    //         we only add the intersection point
+    //      Both vertecis are outside,
+    //         we dont add any points
+    inline uint32_t clip_polygon_to_plane(const sPlane &plane,
+                                          const sVector3 *to_clip,
+                                          const uint32_t num_of_points_to_clip,
+                                          sVector3 *clipped_points) {
+        uint32_t num_of_clipped_points = 0;
+
+        for(uint32_t i = 0; i < num_of_points_to_clip; i++) {
+            const sVector3 &vert1 = to_clip[i];
+            const sVector3 &vert2 = to_clip[(i + 1) % num_of_points_to_clip];
+
+            const float distance_vert1 = plane.distance(vert1);
+            const float distance_vert2 = plane.distance(vert2);
+
+            if (distance_vert1 < 0.0001f && distance_vert2 < 0.0001f) {
+                clipped_points[num_of_clipped_points++] = vert2;
+            } else if (distance_vert1 >= 0.0001f && distance_vert2 < 0.0001f) {
+                clipped_points[num_of_clipped_points++] = plane.get_intersection_point(vert1,
+                                                                                       vert2);
+                clipped_points[num_of_clipped_points++] = vert2;
+            } else if (distance_vert1 < 0.0001f && distance_vert2 >= 0.0001f) {
+                clipped_points[num_of_clipped_points++] = plane.get_intersection_point(vert1,
+                                                                                       vert2);
+            }
+        }
+
+        return num_of_clipped_points;
+    }
+
     // Crop Mesh2's face to mesh1's face
+    // The faces can be polygons of any size, and the result is reduced
+    // to MANIFOLD_MAX_CONTACT_COUNT points
     inline uint32_t face_face_clipping(const sColliderMesh &mesh1,
                                        const uint32_t face_1,
                                        const sColliderMesh &mesh2,
                                        const uint32_t face_2,
                                        sVector3 *clip_points) {
+            const uint32_t face_1_size = mesh1.get_face_size(face_1);
+            const uint32_t face_2_size = mesh2.get_face_size(face_2);
 
-            // Sutherland-Hodgman Cliping
-            sVector3 *to_clip = (sVector3*) malloc(sizeof(sVector3) * 15);
-            memcpy(to_clip, mesh2.get_face(face_2), sizeof(sVector3) * mesh2.face_stride);
-            uint32_t num_of_points_to_clip = mesh2.face_stride;
+            // Each clipping plane can add one point to the convex polygon
+            sClipBuffer buffer;
+            buffer.init(face_2_size + face_1_size + 1);
 
-            sPlane reference_plane = mesh1.get_plane_of_face(face_1);
-
-            // first clip agains the reference plane
-            uint32_t num_of_clipped_points = 0;
+            memcpy(buffer.to_clip, mesh2.get_face(face_2), sizeof(sVector3) * face_2_size);
+            uint32_t num_of_points_to_clip = face_2_size;
 
             // Perform clipping agains the neighboring planes
-            for(uint32_t clip_plane = 0; clip_plane < mesh1.face_stride; clip_plane++) {
-                std::cout << mesh1.get_neighboor_of_face(face_1, clip_plane+1) << std::endl;
-                sPlane clipping_face = mesh1.get_plane_of_face(mesh1.get_neighboor_of_face(face_1, clip_plane));
-                uint32_t num_of_clipped_points = 0;
-
-                for(uint32_t i = 0; i < num_of_points_to_clip; i++) {
-                    sVector3 vert1 = to_clip[i];
-                    sVector3 vert2 = to_clip[(i + 1) % mesh2.face_stride];
-
-                    float distance_vert1 = clipping_face.distance(vert1);
-                    float distance_vert2 = clipping_face.distance(vert2);
-
-                    if (distance_vert1 < 0.0001f && distance_vert2 < 0.0001f) {
-                        // Add the vert2
-                        clip_points[num_of_clipped_points++] = vert2;
-                    } else if (distance_vert1 >= 0.0001f && distance_vert2 < 0.0001f) {
-                        // Add intersection point & vert2
-                        clip_points[num_of_clipped_points++] = clipping_face.get_intersection_point(vert1,
-                                                                                                     vert2);
-                        clip_points[num_of_clipped_points++] = vert2;
-                    } else if (distance_vert1 < 0.0001f && distance_vert2 >= 0.0001f) {
-                        // Add intersection point
-                        clip_points[num_of_clipped_points++] = clipping_face.get_intersection_point(vert1,
-                                                                                                     vert2);
-                    }
-                    // If both are outside, do nothing
-                }
-                num_of_points_to_clip = num_of_clipped_points;
-                memcpy(to_clip, clip_points, sizeof(sVector3) * num_of_clipped_points);
+            for(uint32_t clip_plane = 0; clip_plane < face_1_size && num_of_points_to_clip > 0; clip_plane++) {
+                const sPlane clipping_face = mesh1.get_plane_of_face(mesh1.get_neighboor_of_face(face_1, clip_plane));
+
+                num_of_points_to_clip = clip_polygon_to_plane(clipping_face,
+                                                              buffer.to_clip,
+                                                              num_of_points_to_clip,
+                                                              buffer.clipped);
+                buffer.swap();
             }
 
             // Clipping against the reference plane
+            num_of_points_to_clip = clip_polygon_to_plane(mesh1.get_plane_of_face(face_1),
+                                                          buffer.to_clip,
+                                                          num_of_points_to_clip,
+                                                          buffer.clipped);
+
+            // Keep the contacts with the most support, if there are too many
+            const sPlane reference_plane = mesh1.get_plane_of_face(face_1);
             for(uint32_t i = 0; i < num_of_points_to_clip; i++) {
-                sVector3 vert1 = to_clip[i];
-                sVector3 vert2 = to_clip[(i + 1) % mesh2.face_stride];
-
-                float distance_vert1 = reference_plane.distance(vert1);
-                float distance_vert2 = reference_plane.distance(vert2);
-
-                if (distance_vert1 <= 0.0001f && distance_vert2 <= 0.0001f) {
-                    // Add the vert2
-                    clip_points[num_of_clipped_points++] = vert2;
-                } else if (distance_vert1 > 0.0001f && distance_vert2 <= 0.0001f) {
-                    // Add intersection point & vert2
-                    clip_points[num_of_clipped_points++] = vert2;
-                    clip_points[num_of_clipped_points++] = reference_plane.get_intersection_point(vert1,
-                                                                                                  vert2);
-                } else if (distance_vert1 <= 0.0001f && distance_vert2 > 0.0001f) {
-                    // Add intersection point
-                    clip_points[num_of_clipped_points++] = reference_plane.get_intersection_point(vert2,
-                                                                                                  vert1);
-                }
-                // If both are outside, do nothing
+                buffer.depth[i] = reference_plane.distance(buffer.clipped[i]);
             }
-            num_of_points_to_clip = num_of_clipped_points;
-            memcpy(to_clip, clip_points, sizeof(sVector3) * num_of_clipped_points);
-            num_of_clipped_points = 0;
-
-            // TODO: clip agains adjacent faces
-
-            free(to_clip);
-            //return num_of_clipped_points;
-
-
-            //   Iterate all the edges of the clipped
-            //      If both vertices are inside,
-            //         then we add the second(last) point
-            //      If the first is outside, and the second is inside,
-            //         we add the intersection point, and the second
-            //      If the firs is inside and the second is outside,
-            //         we only add the intersection point
-            //      Both vertecis are outside,
-            //         we dont add any points
-            return num_of_points_to_clip;
+            const uint32_t num_of_contacts = MANIFOLD::reduce_contacts(reference_plane.normal,
+                                                                       buffer.clipped,
+                                                                       buffer.depth,
+                                                                       (uint16_t) num_of_points_to_clip);
+            memcpy(clip_points, buffer.clipped, sizeof(sVector3) * num_of_contacts);
+            buffer.clean();
+
+            return num_of_contacts;
     }
 
     inline uint32_t edge_edge_clipping(const sColliderMesh &mesh1,
@@ -0,0 +1,828 @@
+#ifndef GJK_H_
+#define GJK_H_
+
+#include "collider_mesh.h"
+#include "constants.h"
+#include "math.h"
+#include "vector.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+//**
+// GJK + EPA
+// Narrowphase for any pair of convex shapes, described only by its support
+// function. A shape is a core (a point, a segment, a triangle or a hull)
+// inflated by a radius, and optionally swept along a translation (its
+// Minkowski sum with a segment). So a sphere is a point with radius, and a
+// capsule a segment with radius.
+// GJK finds the distance between the cores; if it is smaller than the sum
+// of the radius, the contact is computed from the closest points. If the
+// cores overlap, EPA finds the penetration depth of the cores, and the
+// radius are added to it.
+// The directions of the last simplex are cached per pair, so the next
+// frame's simplex is rebuilt from them, and the (temporaly coherent)
+// tests finish on one or two iterations.
+// The normal goes from the shape 1 to the shape 2
+// */
+
+#define GJK_MAX_ITERATIONS 32
+#define GJK_TOLERANCE 0.0001f
+#define GJK_EPSILON 0.000001f
+#define GJK_OVERLAP_EPSILON 0.00000001f
+
+#define EPA_MAX_ITERATIONS 32
+#define EPA_MAX_VERTICES 64
+#define EPA_MAX_FACES 128
+#define EPA_MAX_HORIZON_EDGES 64
+#define EPA_TOLERANCE 0.0001f
+
+namespace GJK {
+
+    enum eSupportCore : uint8_t {
+        POINT_CORE = 0,
+        SEGMENT_CORE,
+        TRIANGLE_CORE,
+        HULL_CORE
+    };
+
+    struct sSupportShape {
+        eSupportCore          core = POINT_CORE;
+        // Point, segment's ends, or triangle's corners
+        sVector3              point1 = {};
+        sVector3              point2 = {};
+        sVector3              point3 = {};
+        // Hull, with the warm start of its hill climbing
+        const sColliderMesh   *mesh = NULL;
+        uint32_t              *support_vertex = NULL;
+
+        float                 radius = 0.0f;
+        sVector3              sweep = {};
+
+        // Support of the core (swept)
+        inline sVector3 get_core_support(const sVector3 &direction) const {
+            sVector3 support = {};
+
+            switch(core) {
+                case POINT_CORE:
+                    support = point1;
+                    break;
+                case SEGMENT_CORE:
+                    support = (dot_prod(point1, direction) > dot_prod(point2, direction)) ? point1 : point2;
+                    break;
+                case TRIANGLE_CORE:
+                    support = (dot_prod(point1, direction) > dot_prod(point2, direction)) ? point1 : point2;
+                    support = (dot_prod(support, direction) > dot_prod(point3, direction)) ? support : point3;
+                    break;
+                case HULL_CORE:
+                    support = (support_vertex != NULL) ? mesh->get_support(direction, support_vertex) : mesh->get_support(direction);
+                    break;
+            }
+
+            if (dot_prod(sweep, direction) > 0.0f) {
+                support = support.sum(sweep);
+            }
+
+            return support;
+        }
+
+        inline sVector3 get_center() const {
+            sVector3 center = {};
+
+            switch(core) {
+                case POINT_CORE:
+                    center = point1;
+                    break;
+                case SEGMENT_CORE:
+                    center = point1.sum(point2).mult(0.5f);
+                    break;
+                case TRIANGLE_CORE:
+                    center = point1.sum(point2).sum(point3).mult(1.0f / 3.0f);
+                    break;
+                case HULL_CORE:
+                    center = mesh->mesh_center;
+                    break;
+            }
+
+            return center.sum(sweep.mult(0.5f));
+        }
+    };
+
+    inline sSupportShape get_point_shape(const sVector3 &point,
+                                         const float radius) {
+        sSupportShape shape = {};
+        shape.core = POINT_CORE;
+        shape.point1 = point;
+        shape.radius = radius;
+        return shape;
+    }
+
+    inline sSupportShape get_segment_shape(const sVector3 &point1,
+                                           const sVector3 &point2,
+                                           const float radius) {
+        sSupportShape shape = {};
+        shape.core = SEGMENT_CORE;
+        shape.point1 = point1;
+        shape.point2 = point2;
+        shape.radius = radius;
+        return shape;
+    }
+
+    inline sSupportShape get_triangle_shape(const sVector3 &point1,
+                                            const sVector3 &point2,
+                                            const sVector3 &point3) {
+        sSupportShape shape = {};
+        shape.core = TRIANGLE_CORE;
+        shape.point1 = point1;
+        shape.point2 = point2;
+        shape.point3 = point3;
+        return shape;
+    }
+
+    inline sSupportShape get_hull_shape(const sColliderMesh &mesh,
+                                        uint32_t *support_vertex = NULL) {
+        sSupportShape shape = {};
+        shape.core = HULL_CORE;
+        shape.mesh = &mesh;
+        shape.support_vertex = support_vertex;
+        return shape;
+    }
+
+    /**
+     * Directions of the last simplex of a pair, for shape1 - shape2
+     */
+    struct sSimplexCache {
+        sVector3  directions[4] = {};
+        uint8_t   count = 0;
+
+        inline void invert() {
+            for(uint8_t i = 0; i < count; i++) {
+                directions[i] = directions[i].invert();
+            }
+        }
+    };
+
+    // Point of the Minkowski difference shape1 - shape2, with the points
+    // of each shape that generated it
+    struct sSimplexVertex {
+        sVector3  point = {};
+        sVector3  point1 = {};
+        sVector3  point2 = {};
+        sVector3  direction = {};
+    };
+
+    inline sSimplexVertex get_core_support(const sSupportShape &shape1,
+                                           const sSupportShape &shape2,
+                                           const sVector3 &direction) {
+        sSimplexVertex vertex = {};
+        vertex.point1 = shape1.get_core_support(direction);
+        vertex.point2 = shape2.get_core_support(direction.invert());
+        vertex.point = vertex.point1.subs(vertex.point2);
+        vertex.direction = direction;
+        return vertex;
+    }
+
+    struct sSimplex {
+        sSimplexVertex  vertices[4] = {};
+        float           weights[4] = {};
+        uint32_t        count = 0;
+
+        // Closest point to the origin of the current simplex
+        inline sVector3 get_closest_point() const {
+            sVector3 closest = {};
+            for(uint32_t i = 0; i < count; i++) {
+                closest = closest.sum(vertices[i].point.mult(weights[i]));
+            }
+            return closest;
+        }
+
+        inline void get_witness_points(sVector3 *point1,
+                                       sVector3 *point2) const {
+            *point1 = {};
+            *point2 = {};
+            for(uint32_t i = 0; i < count; i++) {
+                *point1 = point1->sum(vertices[i].point1.mult(weights[i]));
+                *point2 = point2->sum(vertices[i].point2.mult(weights[i]));
+            }
+        }
+
+        inline bool contains(const sVector3 &point) const {
+            for(uint32_t i = 0; i < count; i++) {
+                const sVector3 delta = vertices[i].point.subs(point);
+                if (dot_prod(delta, delta) < GJK_EPSILON) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Keep only the vertices with weight (in order)
+        inline void reduce(const bool *keep) {
+            uint32_t new_count = 0;
+            for(uint32_t i = 0; i < count; i++) {
+                if (keep[i]) {
+                    vertices[new_count] = vertices[i];
+                    weights[new_count] = weights[i];
+                    new_count++;
+                }
+            }
+            count = new_count;
+        }
+
+        inline void solve_segment() {
+            const sVector3 &a = vertices[0].point;
+            const sVector3 ab = vertices[1].point.subs(a);
+            const float length_squared = dot_prod(ab, ab);
+            const float t = (length_squared > GJK_EPSILON) ? -dot_prod(a, ab) / length_squared : 0.0f;
+
+            if (t <= 0.0f) {
+                weights[0] = 1.0f;
+                count = 1;
+            } else if (t >= 1.0f) {
+                vertices[0] = vertices[1];
+                weights[0] = 1.0f;
+                count = 1;
+            } else {
+                weights[0] = 1.0f - t;
+                weights[1] = t;
+            }
+        }
+
+        // Voronoi regions of the triangle, as on Real-Time Collision Detection 5.1.5
+        inline void solve_triangle() {
+            const sVector3 &a = vertices[0].point;
+            const sVector3 &b = vertices[1].point;
+            const sVector3 &c = vertices[2].point;
+            const sVector3 ab = b.subs(a), ac = c.subs(a), ap = a.invert();
+            bool keep[3] = {false, false, false};
+
+            const float d1 = dot_prod(ab, ap), d2 = dot_prod(ac, ap);
+            if (d1 <= 0.0f && d2 <= 0.0f) {
+                weights[0] = 1.0f;
+                keep[0] = true;
+                reduce(keep);
+                return;
+            }
+
+            const sVector3 bp = b.invert();
+            const float d3 = dot_prod(ab, bp), d4 = dot_prod(ac, bp);
+            if (d3 >= 0.0f && d4 <= d3) {
+                weights[1] = 1.0f;
+                keep[1] = true;
+                reduce(keep);
+                return;
+            }
+
+            const float vc = d1 * d4 - d3 * d2;
+            if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+                const float v = d1 / (d1 - d3);
+                weights[0] = 1.0f - v;
+                weights[1] = v;
+                keep[0] = keep[1] = true;
+                reduce(keep);
+                return;
+            }
+
+            const sVector3 cp = c.invert();
+            const float d5 = dot_prod(ab, cp), d6 = dot_prod(ac, cp);
+            if (d6 >= 0.0f && d5 <= d6) {
+                weights[2] = 1.0f;
+                keep[2] = true;
+                reduce(keep);
+                return;
+            }
+
+            const float vb = d5 * d2 - d1 * d6;
+            if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+                const float w = d2 / (d2 - d6);
+                weights[0] = 1.0f - w;
+                weights[2] = w;
+                keep[0] = keep[2] = true;
+                reduce(keep);
+                return;
+            }
+
+            const float va = d3 * d6 - d5 * d4;
+            if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+                const float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+                weights[1] = 1.0f - w;
+                weights[2] = w;
+                keep[1] = keep[2] = true;
+                reduce(keep);
+                return;
+            }
+
+            const float denom = va + vb + vc;
+            if (fabsf(denom) < GJK_EPSILON) {
+                // Degenerated triangle, use its longest edge
+                const float ab_len = dot_prod(ab, ab), ac_len = dot_prod(ac, ac);
+                const sVector3 bc = c.subs(b);
+                if (dot_prod(bc, bc) > MAX(ab_len, ac_len)) {
+                    vertices[0] = vertices[2];
+                } else if (ac_len > ab_len) {
+                    vertices[1] = vertices[2];
+                }
+                count = 2;
+                solve_segment();
+                return;
+            }
+
+            weights[0] = va / denom;
+            weights[1] = vb / denom;
+            weights[2] = vc / denom;
+        }
+
+        // Returns true if the origin is inside of the tetrahedron
+        inline bool solve_tetrahedron() {
+            static const uint32_t faces[4][4] = { {0, 1, 2, 3}, {0, 3, 1, 2}, {0, 2, 3, 1}, {1, 3, 2, 0} };
+
+            const sVector3 &a = vertices[0].point;
+            const float volume = dot_prod(vertices[1].point.subs(a), cross_prod(vertices[2].point.subs(a), vertices[3].point.subs(a)));
+            const bool is_flat = fabsf(volume) < GJK_EPSILON;
+
+            float best_distance = FLT_MAX;
+            sSimplex best = {};
+            bool is_outside_any = false;
+
+            for(uint32_t i = 0; i < 4; i++) {
+                const sVector3 &p0 = vertices[faces[i][0]].point;
+                const sVector3 normal = cross_prod(vertices[faces[i][1]].point.subs(p0), vertices[faces[i][2]].point.subs(p0));
+                const float origin_side = -dot_prod(normal, p0);
+                const float opposite_side = dot_prod(normal, vertices[faces[i][3]].point.subs(p0));
+
+                // The origin is on the other side of the face than the opposite vertex
+                if (!is_flat && origin_side * opposite_side > 0.0f) {
+                    continue;
+                }
+                is_outside_any = true;
+
+                sSimplex face = {};
+                face.vertices[0] = vertices[faces[i][0]];
+                face.vertices[1] = vertices[faces[i][1]];
+                face.vertices[2] = vertices[faces[i][2]];
+                face.count = 3;
+                face.solve_triangle();
+
+                const sVector3 closest = face.get_closest_point();
+                const float distance = dot_prod(closest, closest);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = face;
+                }
+            }
+
+            if (!is_outside_any) {
+                return true;
+            }
+
+            *this = best;
+            return false;
+        }
+
+        // Reduces the simplex to the smallest one that contains the closest
+        // point to the origin. Returns true if the origin is inside
+        inline bool solve() {
+            switch(count) {
+                case 1:
+                    weights[0] = 1.0f;
+                    break;
+                case 2:
+                    solve_segment();
+                    break;
+                case 3:
+                    solve_triangle();
+                    break;
+                case 4:
+                    return solve_tetrahedron();
+            }
+
+            return false;
+        }
+    };
+
+    struct sGJKResult {
+        bool      is_overlapping = false;
+        float     distance = 0.0f;
+        // Closest points of the cores
+        sVector3  point1 = {};
+        sVector3  point2 = {};
+        uint32_t  iteration_count = 0;
+        // If not overlapping, the distance is a lower bound, or within the
+        // tolerance of the real one. Otherwise GJK stopped before converging
+        // and the distance can be over the real one
+        bool      is_converged = false;
+    };
+
+    // Distance between the cores of the shapes, starting from the cached
+    // simplex. If the distance is larger than max_distance it can exit early
+    inline sGJKResult compute_distance(const sSupportShape &shape1,
+                                       const sSupportShape &shape2,
+                                       const float max_distance,
+                                       sSimplexCache *cache,
+                                       sSimplex *simplex) {
+        sGJKResult result = {};
+        *simplex = {};
+
+        // Rebuild the last simplex of the pair
+        if (cache != NULL) {
+            for(uint8_t i = 0; i < cache->count; i++) {
+                const sSimplexVertex vertex = get_core_support(shape1, shape2, cache->directions[i]);
+                if (!simplex->contains(vertex.point)) {
+                    simplex->vertices[simplex->count++] = vertex;
+                }
+            }
+        }
+
+        if (simplex->count == 0) {
+            sVector3 direction = shape2.get_center().subs(shape1.get_center());
+            if (dot_prod(direction, direction) < GJK_EPSILON) {
+                direction = {1.0f, 0.0f, 0.0f};
+            }
+            simplex->vertices[simplex->count++] = get_core_support(shape1, shape2, direction);
+        }
+
+        float last_distance_squared = FLT_MAX;
+
+        for(; result.iteration_count < GJK_MAX_ITERATIONS; result.iteration_count++) {
+            if (simplex->solve()) {
+                result.is_overlapping = true;
+                break;
+            }
+
+            const sVector3 closest = simplex->get_closest_point();
+            const float distance_squared = dot_prod(closest, closest);
+            result.distance = sqrtf(distance_squared);
+
+            if (distance_squared < GJK_OVERLAP_EPSILON) {
+                result.is_overlapping = true;
+                break;
+            }
+
+            // The new vertex did not get the simplex closer (numerical precision)
+            if (distance_squared >= last_distance_squared) {
+                break;
+            }
+            last_distance_squared = distance_squared;
+
+            const sSimplexVertex vertex = get_core_support(shape1, shape2, closest.invert());
+            const float projection = dot_prod(closest, vertex.point);
+
+            // The lower bound of the distance is already too big
+            if (projection > 0.0f && projection * projection > max_distance * max_distance * distance_squared) {
+                result.distance = projection / sqrtf(distance_squared);
+                result.is_converged = true;
+                break;
+            }
+
+            // No more progress can be made
+            if (distance_squared - projection <= GJK_TOLERANCE * distance_squared || simplex->contains(vertex.point)) {
+                result.is_converged = true;
+                break;
+            }
+
+            simplex->vertices[simplex->count++] = vertex;
+        }
+
+        if (!result.is_overlapping) {
+            simplex->get_witness_points(&result.point1, &result.point2);
+        }
+
+        if (cache != NULL) {
+            cache->count = (uint8_t) simplex->count;
+            for(uint32_t i = 0; i < simplex->count; i++) {
+                cache->directions[i] = simplex->vertices[i].direction;
+            }
+        }
+
+        return result;
+    }
+
+    inline bool test_intersection(const sSupportShape &shape1,
+                                  const sSupportShape &shape2,
+                                  sSimplexCache *cache = NULL) {
+        sSimplex simplex = {};
+        const float radius = shape1.radius + shape2.radius;
+        const sGJKResult result = compute_distance(shape1, shape2, radius, cache, &simplex);
+
+        return result.is_overlapping || result.distance <= radius;
+    }
+
+    // EPA ============================
+
+    struct sPolytopeFace {
+        uint32_t  vertices[3] = {};
+        sVector3  normal = {};
+        float     distance = 0.0f;
+        bool      is_removed = false;
+    };
+
+    struct sPolytope {
+        sSimplexVertex  vertices[EPA_MAX_VERTICES] = {};
+        sPolytopeFace   faces[EPA_MAX_FACES] = {};
+        uint32_t        vertex_count = 0;
+        uint32_t        face_count = 0;
+
+        inline bool add_face(const uint32_t a,
+                             const uint32_t b,
+                             const uint32_t c) {
+            if (face_count == EPA_MAX_FACES) {
+                return false;
+            }
+
+            sPolytopeFace &face = faces[face_count++];
+            face = {};
+            face.vertices[0] = a;
+            face.vertices[1] = b;
+            face.vertices[2] = c;
+
+            const sVector3 &p0 = vertices[a].point;
+            face.normal = cross_prod(vertices[b].point.subs(p0), vertices[c].point.subs(p0));
+            const float length = face.normal.magnitude();
+            if (length < GJK_EPSILON) {
+                face.is_removed = true;
+                return true;
+            }
+            face.normal = face.normal.mult(1.0f / length);
+            face.distance = dot_prod(face.normal, p0);
+
+            return true;
+        }
+    };
+
+    // Grows the simplex of the overlapping cores to a tetrahedron that
+    // contains the origin. Returns false if the Minkowski difference is flat
+    inline bool build_tetrahedron(const sSupportShape &shape1,
+                                  const sSupportShape &shape2,
+                                  sSimplex *simplex) {
+        static const sVector3 axis[6] = { {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
+                                          {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+                                          {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f} };
+
+        if (simplex->count == 1) {
+            for(uint32_t i = 0; i < 6; i++) {
+                const sSimplexVertex vertex = get_core_support(shape1, shape2, axis[i]);
+                if (!simplex->contains(vertex.point)) {
+                    simplex->vertices[simplex->count++] = vertex;
+                    break;
+                }
+            }
+        }
+
+        if (simplex->count == 2) {
+            const sVector3 line = simplex->vertices[1].point.subs(simplex->vertices[0].point);
+
+            for(uint32_t i = 0; i < 6 && simplex->count == 2; i++) {
+                const sVector3 direction = cross_prod(line, axis[i]);
+                if (dot_prod(direction, direction) < GJK_EPSILON) {
+                    continue;
+                }
+
+                const sSimplexVertex vertex = get_core_support(shape1, shape2, direction);
+                const sVector3 normal = cross_prod(line, vertex.point.subs(simplex->vertices[0].point));
+                if (dot_prod(normal, normal) > GJK_EPSILON) {
+                    simplex->vertices[simplex->count++] = vertex;
+                }
+            }
+        }
+
+        if (simplex->count == 3) {
+            const sVector3 &p0 = simplex->vertices[0].point;
+            const sVector3 normal = cross_prod(simplex->vertices[1].point.subs(p0), simplex->vertices[2].point.subs(p0));
+
+            for(uint32_t i = 0; i < 2 && simplex->count == 3; i++) {
+                const sSimplexVertex vertex = get_core_support(shape1, shape2, (i == 0) ? normal : normal.invert());
+                if (fabsf(dot_prod(normal, vertex.point.subs(p0))) > GJK_EPSILON) {
+                    simplex->vertices[simplex->count++] = vertex;
+                }
+            }
+        }
+
+        return simplex->count == 4;
+    }
+
+    // Penetration depth of the overlapping cores, along the normal
+    inline bool compute_penetration(const sSupportShape &shape1,
+                                    const sSupportShape &shape2,
+                                    sSimplex *simplex,
+                                    sVector3 *normal,
+                                    float *depth,
+                                    sVector3 *point1,
+                                    sVector3 *point2) {
+        if (!build_tetrahedron(shape1, shape2, simplex)) {
+            return false;
+        }
+
+        // Bounded by EPA_MAX_VERTICES and EPA_MAX_FACES, so it fits on the stack
+        sPolytope polytope = {};
+        polytope.vertex_count = 4;
+        for(uint32_t i = 0; i < 4; i++) {
+            polytope.vertices[i] = simplex->vertices[i];
+        }
+
+        // Wind the tetrahedron outwards
+        const sVector3 &a = simplex->vertices[0].point;
+        if (dot_prod(simplex->vertices[1].point.subs(a), cross_prod(simplex->vertices[2].point.subs(a), simplex->vertices[3].point.subs(a))) > 0.0f) {
+            polytope.vertices[1] = simplex->vertices[2];
+            polytope.vertices[2] = simplex->vertices[1];
+        }
+        polytope.add_face(0, 1, 2);
+        polytope.add_face(0, 3, 1);
+        polytope.add_face(0, 2, 3);
+        polytope.add_face(1, 3, 2);
+
+        uint32_t horizon[EPA_MAX_HORIZON_EDGES][2] = {};
+        uint32_t closest_face = 0;
+
+        for(uint32_t iteration = 0; iteration < EPA_MAX_ITERATIONS; iteration++) {
+            // Closest face to the origin
+            float closest_distance = FLT_MAX;
+            for(uint32_t i = 0; i < polytope.face_count; i++) {
+                if (!polytope.faces[i].is_removed && polytope.faces[i].distance < closest_distance) {
+                    closest_distance = polytope.faces[i].distance;
+                    closest_face = i;
+                }
+            }
+
+            const sPolytopeFace &face = polytope.faces[closest_face];
+            const sSimplexVertex vertex = get_core_support(shape1, shape2, face.normal);
+
+            if (dot_prod(vertex.point, face.normal) - face.distance < EPA_TOLERANCE ||
+                polytope.vertex_count == EPA_MAX_VERTICES) {
+                break;
+            }
+
+            const uint32_t new_vertex = polytope.vertex_count++;
+            polytope.vertices[new_vertex] = vertex;
+
+            // Remove the faces visible from the new point, and find the horizon
+            uint32_t horizon_count = 0;
+            bool is_horizon_full = false;
+            for(uint32_t i = 0; i < polytope.face_count; i++) {
+                sPolytopeFace &visible = polytope.faces[i];
+                if (visible.is_removed || dot_prod(visible.normal, vertex.point.subs(polytope.vertices[visible.vertices[0]].point)) <= 0.0f) {
+                    continue;
+                }
+                visible.is_removed = true;
+
+                for(uint32_t j = 0; j < 3; j++) {
+                    const uint32_t edge_start = visible.vertices[j], edge_end = visible.vertices[(j + 1) % 3];
+
+                    // If the edge is shared with another visible face, it is not on the horizon
+                    bool is_shared = false;
+                    for(uint32_t k = 0; k < horizon_count; k++) {
+                        if (horizon[k][0] == edge_end && horizon[k][1] == edge_start) {
+                            horizon[k][0] = horizon[horizon_count - 1][0];
+                            horizon[k][1] = horizon[horizon_count - 1][1];
+                            horizon_count--;
+                            is_shared = true;
+                            break;
+                        }
+                    }
+
+                    if (!is_shared) {
+                        if (horizon_count == EPA_MAX_HORIZON_EDGES) {
+                            is_horizon_full = true;
+                            break;
+                        }
+                        horizon[horizon_count][0] = edge_start;
+                        horizon[horizon_count][1] = edge_end;
+                        horizon_count++;
+                    }
+                }
+            }
+
+            // Compact the removed faces, and add the cone from the horizon
+            uint32_t face_count = 0;
+            for(uint32_t i = 0; i < polytope.face_count; i++) {
+                if (!polytope.faces[i].is_removed) {
+                    polytope.faces[face_count++] = polytope.faces[i];
+                }
+            }
+            polytope.face_count = face_count;
+
+            bool is_full = is_horizon_full;
+            for(uint32_t i = 0; i < horizon_count && !is_full; i++) {
+                is_full = !polytope.add_face(horizon[i][0], horizon[i][1], new_vertex);
+            }
+
+            if (is_full || polytope.face_count == 0) {
+                // Out of storage: keep the best result so far
+                break;
+            }
+        }
+
+        // Closest face of the final polytope
+        float closest_distance = FLT_MAX;
+        for(uint32_t i = 0; i < polytope.face_count; i++) {
+            if (!polytope.faces[i].is_removed && polytope.faces[i].distance < closest_distance) {
+                closest_distance = polytope.faces[i].distance;
+                closest_face = i;
+            }
+        }
+
+        if (closest_distance == FLT_MAX) {
+            return false;
+        }
+
+        // Projection of the origin on the face, for the witness points
+        const sPolytopeFace &face = polytope.faces[closest_face];
+        sSimplex face_simplex = {};
+        face_simplex.count = 3;
+        for(uint32_t i = 0; i < 3; i++) {
+            face_simplex.vertices[i] = polytope.vertices[face.vertices[i]];
+        }
+        face_simplex.solve_triangle();
+        face_simplex.get_witness_points(point1, point2);
+
+        *normal = face.normal;
+        *depth = face.distance;
+
+        return true;
+    }
+
+    // Contact between both shapes (with its radius); the depth is negative.
+    // If there is no collision, the separating_distance is a lower bound of
+    // the distance between the shapes (0 if GJK did not converge)
+    inline bool convex_collision(const sSupportShape &shape1,
+                                 const sSupportShape &shape2,
+                                 sSimplexCache *cache,
+                                 sVector3 *normal,
+                                 sVector3 *contact_points,
+                                 float *contact_depth,
+                                 uint16_t *contanct_points_count,
+                                 float *separating_distance = NULL) {
+        const float radius = shape1.radius + shape2.radius;
+        sSimplex simplex = {};
+        const sGJKResult result = compute_distance(shape1, shape2, radius, cache, &simplex);
+
+        sVector3 point1 = {}, point2 = {};
+        float depth = 0.0f;
+
+        if (!result.is_overlapping) {
+            if (result.distance > radius) {
+                // GJK's distance is over the real one, by up to its tolerance.
+                // Without convergence there is no bound, so the pair is
+                // tested again on the next frame
+                if (separating_distance != NULL) {
+                    *separating_distance = (result.is_converged) ? result.distance * (1.0f - GJK_TOLERANCE) - radius : 0.0f;
+                }
+                return false;
+            }
+
+            // Shallow contact: from the closest points of the cores
+            point1 = result.point1;
+            point2 = result.point2;
+            *normal = point2.subs(point1).mult(1.0f / result.distance);
+            depth = result.distance - radius;
+        } else {
+            float core_depth = 0.0f;
+
+            if (!compute_penetration(shape1, shape2, &simplex, normal, &core_depth, &point1, &point2)) {
+                // The cores are touching, or its difference is flat (ex. two
+                // crossing segments): any direction on the simplex's normal space
+                const sVector3 &p0 = simplex.vertices[0].point;
+                sVector3 direction = shape2.get_center().subs(shape1.get_center());
+
+                if (simplex.count >= 3) {
+                    direction = cross_prod(simplex.vertices[1].point.subs(p0), simplex.vertices[2].point.subs(p0));
+                } else if (simplex.count == 2) {
+                    const sVector3 line = simplex.vertices[1].point.subs(p0);
+                    direction = cross_prod(cross_prod(line, direction), line);
+                }
+
+                if (dot_prod(direction, direction) < GJK_EPSILON) {
+                    direction = {0.0f, 1.0f, 0.0f};
+                }
+                *normal = direction.normalize();
+                if (dot_prod(*normal, shape2.get_center().subs(shape1.get_center())) < 0.0f) {
+                    *normal = normal->invert();
+                }
+
+                // The weights of the grown vertices are not solved
+                if (simplex.solve()) {
+                    for(uint32_t i = 0; i < simplex.count; i++) {
+                        simplex.weights[i] = 1.0f / simplex.count;
+                    }
+                }
+                simplex.get_witness_points(&point1, &point2);
+                core_depth = 0.0f;
+            }
+
+            // The normal of the difference shape1 - shape2 goes from 1 to 2
+            depth = -MAX(core_depth, 0.0f) - radius;
+        }
+
+        // Move the closest points of the cores to the surfaces
+        point1 = point1.sum(normal->mult(shape1.radius));
+        point2 = point2.subs(normal->mult(shape2.radius));
+
+        contact_points[0] = point1.sum(point2).mult(0.5f);
+        contact_depth[0] = depth;
+        *contanct_points_count = 1;
+
+        return true;
+    }
+};
+
+#endif // GJK_H_
@@ -0,0 +1,188 @@
+#ifndef HALF_EDGE_HULL_H_
+#define HALF_EDGE_HULL_H_
+
+#include "math.h"
+#include "mesh.h"
+#include "vector.h"
+#include "data_structs/pair_hash_map.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * Half-edge hull
+ * Each face is a loop of half-edges, and each half-edge knows its twin on
+ * the neighbouring face, so the adjacency queries (neighbours of a face,
+ * edges arround a vertex) are O(1) per step.
+ * The twins are paired via a hash map keyed by the (unordered) vertex
+ * pair of the edge, so the construction is O(E), instead of comparing
+ * every edge against all the previous ones.
+ * The half-edges are created on face order, so the half-edge of the
+ * corner k of the face f is face_offsets[f] + k.
+ * */
+
+#define HALF_EDGE_NULL 0xFFFFFFFF
+
+struct sHalfEdge {
+    // Vertex where the half-edge starts
+    uint32_t  origin = HALF_EDGE_NULL;
+    uint32_t  twin = HALF_EDGE_NULL;
+    uint32_t  next = HALF_EDGE_NULL;
+    uint32_t  face = HALF_EDGE_NULL;
+};
+
+struct sHalfEdgeHull {
+    sVector3   *vertices = NULL;
+    // One outgoing half-edge per vertex
+    uint32_t   *vertex_edge = NULL;
+    uint32_t   vertex_count = 0;
+
+    sHalfEdge  *half_edges = NULL;
+    uint32_t   half_edge_count = 0;
+
+    // First half-edge of each face, the face f is on the range
+    // [face_offsets[f], face_offsets[f + 1])
+    uint32_t   *face_offsets = NULL;
+    uint32_t   face_count = 0;
+
+    // Number of twin pairs, plus the unpaired half-edges (of the open and
+    // the non manifold edges)
+    uint32_t   edge_count = 0;
+
+    // =================
+    // LIFECYCLE FUNCTIONS
+    // ================
+    // face_indices stores the vertex indices of each face, consecutively,
+    // and face_offsets the start of each face (face_count + 1 entries)
+    void init(const sVector3 *vertex_positions,
+              const uint32_t num_of_vertices,
+              const uint32_t *face_indices,
+              const uint32_t *offsets,
+              const uint32_t num_of_faces) {
+        vertex_count = num_of_vertices;
+        face_count = num_of_faces;
+        half_edge_count = offsets[num_of_faces];
+
+        vertices = (sVector3*) malloc(sizeof(sVector3) * vertex_count);
+        vertex_edge = (uint32_t*) malloc(sizeof(uint32_t) * vertex_count);
+        half_edges = (sHalfEdge*) malloc(sizeof(sHalfEdge) * half_edge_count);
+        face_offsets = (uint32_t*) malloc(sizeof(uint32_t) * (face_count + 1));
+
+        memcpy(vertices, vertex_positions, sizeof(sVector3) * vertex_count);
+        memcpy(face_offsets, offsets, sizeof(uint32_t) * (face_count + 1));
+        memset(vertex_edge, 0xFF, sizeof(uint32_t) * vertex_count);
+
+        // Build the face loops
+        for(uint32_t face = 0; face < face_count; face++) {
+            const uint32_t start = face_offsets[face];
+            const uint32_t size = face_offsets[face + 1] - start;
+
+            for(uint32_t k = 0; k < size; k++) {
+                sHalfEdge &half_edge = half_edges[start + k];
+                half_edge.origin = face_indices[start + k];
+                half_edge.next = start + ((k + 1) % size);
+                half_edge.face = face;
+                half_edge.twin = HALF_EDGE_NULL;
+
+                vertex_edge[half_edge.origin] = start + k;
+            }
+        }
+
+        // Pair the twins: the first half-edge of an edge is stored on
+        // the map, and the second one finds it
+        sPairHashMap edge_map = {};
+        edge_map.init(half_edge_count * 2);
+        edge_count = 0;
+
+        for(uint32_t i = 0; i < half_edge_count; i++) {
+            const uint32_t origin = half_edges[i].origin;
+            const uint32_t end = half_edges[half_edges[i].next].origin;
+            const uint64_t key = get_pair_key(origin, end);
+
+            const uint32_t twin = edge_map.get(key);
+            if (twin == PAIR_MAP_NOT_FOUND) {
+                edge_map.set(key, i);
+                edge_count++;
+            } else if (half_edges[twin].twin == HALF_EDGE_NULL) {
+                half_edges[twin].twin = i;
+                half_edges[i].twin = twin;
+            } else {
+                // Non manifold edges (more than two faces) keep the first
+                // pair, and the extra half-edges stay open, as edges of
+                // their own
+                edge_count++;
+            }
+        }
+
+        edge_map.clean();
+    }
+
+    // Welds the vertices of the mesh by its OBJ position index
+    void init_from_mesh(const sMesh &mesh) {
+        uint32_t position_count = 0;
+        for(uint32_t i = 0; i < mesh.indexing_count; i++) {
+            position_count = MAX(position_count, mesh.face_vertices[i] + 1);
+        }
+
+        sVector3 *positions = (sVector3*) malloc(sizeof(sVector3) * position_count);
+        uint32_t *offsets = (uint32_t*) malloc(sizeof(uint32_t) * (mesh.face_count + 1));
+
+        for(uint32_t i = 0; i < mesh.indexing_count; i++) {
+            positions[mesh.face_vertices[i]] = mesh.vertices[mesh.vertices_index[i]].vertex;
+        }
+        for(uint32_t face = 0; face <= mesh.face_count; face++) {
+            offsets[face] = face * 3;
+        }
+
+        init(positions, position_count, mesh.face_vertices, offsets, mesh.face_count);
+
+        free(positions);
+        free(offsets);
+    }
+
+    void clean() {
+        free(vertices);
+        free(vertex_edge);
+        free(half_edges);
+        free(face_offsets);
+        vertices = NULL;
+        vertex_edge = NULL;
+        half_edges = NULL;
+        face_offsets = NULL;
+        vertex_count = 0;
+        half_edge_count = 0;
+        face_count = 0;
+        edge_count = 0;
+    }
+
+    // =================
+    // ADJACENCY FUNCTIONS
+    // ================
+    inline uint32_t get_face_size(const uint32_t face) const {
+        return face_offsets[face + 1] - face_offsets[face];
+    }
+
+    // Face on the other side of the half-edge
+    inline uint32_t get_neighbour_face(const uint32_t half_edge) const {
+        const uint32_t twin = half_edges[half_edge].twin;
+        return (twin == HALF_EDGE_NULL) ? HALF_EDGE_NULL : half_edges[twin].face;
+    }
+
+    // Next outgoing half-edge arround the origin vertex
+    inline uint32_t get_next_outgoing(const uint32_t half_edge) const {
+        const uint32_t twin = half_edges[half_edge].twin;
+        return (twin == HALF_EDGE_NULL) ? HALF_EDGE_NULL : half_edges[twin].next;
+    }
+
+    inline uint32_t get_edge_end(const uint32_t half_edge) const {
+        return half_edges[half_edges[half_edge].next].origin;
+    }
+
+    // Only one of the twins is the representative of the edge
+    inline bool is_edge_representative(const uint32_t half_edge) const {
+        return half_edges[half_edge].twin == HALF_EDGE_NULL || half_edge < half_edges[half_edge].twin;
+    }
+};
+
+#endif // HALF_EDGE_HULL_H_
@@ -0,0 +1,281 @@
+#ifndef HEIGHTFIELD_H_
+#define HEIGHTFIELD_H_
+
+#include "math.h"
+#include "phys_broadphase.h"
+#include "vector.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * Heightfield
+ * Static collider for the terrain: a grid of 16 bit height samples, on the
+ * XZ plane. The sample (x, z) is at origin + (x * scale.x, height * scale.y, z * scale.z)
+ * Each cell between 4 samples is split in 2 triangles, that are generated
+ * only when a query reaches the cell.
+ * The cells are indexed by a min/max quadtree, stored as levels of halving
+ * resolution: the node (x, z) of a level covers the nodes (2x..2x+1, 2z..2z+1)
+ * of the level bellow. The cells (level 0) are not stored, they are read
+ * from the samples, so the tree is about a third of the size of the heights.
+ * */
+
+#define HEIGHTFIELD_MAX_LEVELS 32u
+
+struct sHeightfieldNode {
+    uint16_t  min_height = 0;
+    uint16_t  max_height = 0;
+};
+
+struct sHeightfield {
+    uint16_t          *heights = NULL;
+    uint32_t          width = 0;
+    uint32_t          depth = 0;
+
+    sVector3          origin = {};
+    sVector3          scale = {};
+    sAABB             aabb = {};
+
+    // Quadtree levels, from 1 to level_count - 1
+    sHeightfieldNode  *nodes = NULL;
+    uint32_t          level_count = 0;
+    uint32_t          level_offset[HEIGHTFIELD_MAX_LEVELS] = {};
+    uint32_t          level_width[HEIGHTFIELD_MAX_LEVELS] = {};
+    uint32_t          level_depth[HEIGHTFIELD_MAX_LEVELS] = {};
+
+    // Result of the last query
+    uint32_t          *query_cells = NULL;
+    uint32_t          query_count = 0;
+    uint32_t          query_capacity = 0;
+
+    // The samples are copied, row by row on the X axis
+    // Returns false if there is not at least one cell
+    bool init(const uint16_t *samples,
+              const uint32_t samples_width,
+              const uint32_t samples_depth,
+              const sVector3 &field_origin,
+              const sVector3 &field_scale) {
+        if (samples_width < 2 || samples_depth < 2) {
+            return false;
+        }
+
+        width = samples_width;
+        depth = samples_depth;
+        origin = field_origin;
+        scale = field_scale;
+
+        heights = (uint16_t*) malloc(sizeof(uint16_t) * width * depth);
+        memcpy(heights, samples, sizeof(uint16_t) * width * depth);
+
+        build_quadtree();
+
+        query_count = 0;
+        query_capacity = 64;
+        query_cells = (uint32_t*) malloc(sizeof(uint32_t) * query_capacity);
+
+        return true;
+    }
+
+    void clean() {
+        free(heights);
+        free(nodes);
+        free(query_cells);
+        heights = NULL;
+        nodes = NULL;
+        query_cells = NULL;
+        width = 0;
+        depth = 0;
+        level_count = 0;
+        query_count = 0;
+        query_capacity = 0;
+    }
+
+    inline uint32_t get_cell_count() const {
+        return (width - 1) * (depth - 1);
+    }
+
+    inline sVector3 get_sample_position(const uint32_t x,
+                                        const uint32_t z) const {
+        return sVector3{origin.x + x * scale.x,
+                        origin.y + heights[z * width + x] * scale.y,
+                        origin.z + z * scale.z};
+    }
+
+    // The min and max samples of the node
+    inline void get_node_bounds(const uint32_t level,
+                                const uint32_t x,
+                                const uint32_t z,
+                                uint16_t *min_height,
+                                uint16_t *max_height) const {
+        if (level > 0) {
+            const sHeightfieldNode &node = nodes[level_offset[level] + z * level_width[level] + x];
+            *min_height = node.min_height;
+            *max_height = node.max_height;
+            return;
+        }
+
+        const uint16_t h00 = heights[z * width + x];
+        const uint16_t h10 = heights[z * width + x + 1];
+        const uint16_t h01 = heights[(z + 1) * width + x];
+        const uint16_t h11 = heights[(z + 1) * width + x + 1];
+        *min_height = MIN(MIN(h00, h10), MIN(h01, h11));
+        *max_height = MAX(MAX(h00, h10), MAX(h01, h11));
+    }
+
+    // The 2 triangles of the cell, CCW seen from above, and their normals
+    inline void get_cell_triangles(const uint32_t cell,
+                                   sVector3 triangles[2][3],
+                                   sVector3 normals[2]) const {
+        const uint32_t x = cell % (width - 1);
+        const uint32_t z = cell / (width - 1);
+
+        const sVector3 p00 = get_sample_position(x, z);
+        const sVector3 p10 = get_sample_position(x + 1, z);
+        const sVector3 p01 = get_sample_position(x, z + 1);
+        const sVector3 p11 = get_sample_position(x + 1, z + 1);
+
+        triangles[0][0] = p00;
+        triangles[0][1] = p01;
+        triangles[0][2] = p11;
+        triangles[1][0] = p00;
+        triangles[1][1] = p11;
+        triangles[1][2] = p10;
+
+        normals[0] = cross_prod(p01.subs(p00), p11.subs(p00)).normalize();
+        normals[1] = cross_prod(p11.subs(p00), p10.subs(p00)).normalize();
+    }
+
+    // Stores on query_cells the cells under the AABB, whose height range
+    // overlaps it
+    uint32_t query(const sAABB &bounds) {
+        query_count = 0;
+
+        if (!aabb.overlaps(bounds)) {
+            return 0;
+        }
+
+        // Cell range on the grid
+        const float max_x = (float) (width - 2);
+        const float max_z = (float) (depth - 2);
+        const uint32_t min_cell_x = (uint32_t) MIN(MAX(floorf((bounds.min.x - origin.x) / scale.x), 0.0f), max_x);
+        const uint32_t max_cell_x = (uint32_t) MIN(MAX(floorf((bounds.max.x - origin.x) / scale.x), 0.0f), max_x);
+        const uint32_t min_cell_z = (uint32_t) MIN(MAX(floorf((bounds.min.z - origin.z) / scale.z), 0.0f), max_z);
+        const uint32_t max_cell_z = (uint32_t) MIN(MAX(floorf((bounds.max.z - origin.z) / scale.z), 0.0f), max_z);
+
+        // Height range, rounded outwards
+        const float min_height = MIN(MAX(floorf((bounds.min.y - origin.y) / scale.y), 0.0f), 65535.0f);
+        const float max_height = MIN(MAX(ceilf((bounds.max.y - origin.y) / scale.y), 0.0f), 65535.0f);
+        const uint16_t query_min_height = (uint16_t) min_height;
+        const uint16_t query_max_height = (uint16_t) max_height;
+
+        // Depth first, from the root, with at most 3 pending siblings per level
+        struct sStackNode {
+            uint32_t level;
+            uint32_t x;
+            uint32_t z;
+        } stack[HEIGHTFIELD_MAX_LEVELS * 4];
+        uint32_t stack_size = 0;
+        stack[stack_size++] = {level_count - 1, 0, 0};
+
+        while(stack_size > 0) {
+            const sStackNode curr = stack[--stack_size];
+
+            // Cells covered by the node
+            const uint32_t node_min_x = curr.x << curr.level;
+            const uint32_t node_min_z = curr.z << curr.level;
+            const uint32_t node_max_x = ((curr.x + 1) << curr.level) - 1;
+            const uint32_t node_max_z = ((curr.z + 1) << curr.level) - 1;
+            if (node_min_x > max_cell_x || node_max_x < min_cell_x ||
+                node_min_z > max_cell_z || node_max_z < min_cell_z) {
+                continue;
+            }
+
+            uint16_t node_min_height = 0, node_max_height = 0;
+            get_node_bounds(curr.level, curr.x, curr.z, &node_min_height, &node_max_height);
+            if (node_min_height > query_max_height || node_max_height < query_min_height) {
+                continue;
+            }
+
+            if (curr.level == 0) {
+                add_query_cell(curr.z * (width - 1) + curr.x);
+                continue;
+            }
+
+            const uint32_t child_level = curr.level - 1;
+            for(uint32_t i = 0; i < 4; i++) {
+                const uint32_t child_x = curr.x * 2 + (i & 1);
+                const uint32_t child_z = curr.z * 2 + (i >> 1);
+
+                if (child_x < level_width[child_level] && child_z < level_depth[child_level]) {
+                    stack[stack_size++] = {child_level, child_x, child_z};
+                }
+            }
+        }
+
+        return query_count;
+    }
+
+    inline void add_query_cell(const uint32_t cell) {
+        if (query_count == query_capacity) {
+            query_capacity *= 2;
+            query_cells = (uint32_t*) realloc(query_cells, sizeof(uint32_t) * query_capacity);
+        }
+
+        query_cells[query_count++] = cell;
+    }
+
+    void build_quadtree() {
+        level_width[0] = width - 1;
+        level_depth[0] = depth - 1;
+        level_offset[0] = 0;
+        level_count = 1;
+
+        uint32_t node_count = 0;
+        while(level_width[level_count - 1] > 1 || level_depth[level_count - 1] > 1) {
+            level_width[level_count] = (level_width[level_count - 1] + 1) / 2;
+            level_depth[level_count] = (level_depth[level_count - 1] + 1) / 2;
+            level_offset[level_count] = node_count;
+            node_count += level_width[level_count] * level_depth[level_count];
+            level_count++;
+        }
+
+        nodes = (sHeightfieldNode*) malloc(sizeof(sHeightfieldNode) * MAX(node_count, 1u));
+
+        // Bottom up, each node merges its (up to 4) children
+        for(uint32_t level = 1; level < level_count; level++) {
+            const uint32_t child_level = level - 1;
+
+            for(uint32_t z = 0; z < level_depth[level]; z++) {
+                for(uint32_t x = 0; x < level_width[level]; x++) {
+                    sHeightfieldNode &node = nodes[level_offset[level] + z * level_width[level] + x];
+                    node.min_height = 65535;
+                    node.max_height = 0;
+
+                    for(uint32_t i = 0; i < 4; i++) {
+                        const uint32_t child_x = x * 2 + (i & 1);
+                        const uint32_t child_z = z * 2 + (i >> 1);
+
+                        if (child_x >= level_width[child_level] || child_z >= level_depth[child_level]) {
+                            continue;
+                        }
+
+                        uint16_t child_min = 0, child_max = 0;
+                        get_node_bounds(child_level, child_x, child_z, &child_min, &child_max);
+                        node.min_height = MIN(node.min_height, child_min);
+                        node.max_height = MAX(node.max_height, child_max);
+                    }
+                }
+            }
+        }
+
+        uint16_t root_min = 0, root_max = 0;
+        get_node_bounds(level_count - 1, 0, 0, &root_min, &root_max);
+
+        aabb.min = {origin.x, origin.y + root_min * scale.y, origin.z};
+        aabb.max = {origin.x + (width - 1) * scale.x, origin.y + root_max * scale.y, origin.z + (depth - 1) * scale.z};
+    }
+};
+
+#endif // HEIGHTFIELD_H_
@@ -488,7 +488,7 @@ void draw_loop(GLFWwindow *window) {
     int sphere_count = 0;
     int cube_count = 0;
 
-    for(int i = 0; i < PHYS_INSTANCE_COUNT; i++) {
+    for(uint32_t i = 0; i < phys_instance.body_count; i++) {
       if (!phys_instance.enabled[i])
         continue;
       if (phys_instance.shape[i] == SPHERE_COLLIDER) {
@@ -506,7 +506,7 @@ void draw_loop(GLFWwindow *window) {
     // Render contact points
     sVector4 col_color[15] = {};
     int col_points = 0;
-    for(int i = 0; i < MAX_COLLISION_COUNT; i++) {
+    for(uint32_t i = 0; i < phys_instance.coll_manager.manifold_count; i++) {
       if (!phys_instance.coll_manager.has_collided_on_frame[i])
         continue;
 
@@ -0,0 +1,123 @@
+#ifndef MANIFOLD_REDUCTION_H_
+#define MANIFOLD_REDUCTION_H_
+
+#include "contact_data.h"
+#include "math.h"
+#include "vector.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+//**
+// Manifold reduction
+// More than 4 contacts per pair add work to the solver, but not stability,
+// so the contacts are reduced to the 4 that keep the most support:
+//  - The deepest one, so the penetration is always solved
+//  - The furthest from it, on the contact plane
+//  - The one that makes the triangle of largest area with both
+//  - The one that adds the most area outside that triangle
+// The areas are measured on the plane of the normal, and all the contacts
+// are expected to be penetrating (depth <= 0)
+// Based on Bullet's btPersistentManifold::sortCachedPoints
+// */
+
+// Bellow this (squared) distance or area, the contacts are the same one
+#define MANIFOLD_REDUCTION_EPSILON 0.000001f
+
+namespace MANIFOLD {
+
+    // Signed double area of the triangle, on the plane of the normal
+    inline float get_signed_area(const sVector3 &normal,
+                                 const sVector3 &p1,
+                                 const sVector3 &p2,
+                                 const sVector3 &p3) {
+        return dot_prod(cross_prod(p2.subs(p1), p3.subs(p1)), normal);
+    }
+
+    // Reduces the contacts in place, returns the new count
+    inline uint16_t reduce_contacts(const sVector3 &normal,
+                                    sVector3 *contact_points,
+                                    float *contact_depth,
+                                    const uint16_t contact_count) {
+        if (contact_count <= MANIFOLD_MAX_CONTACT_COUNT) {
+            return contact_count;
+        }
+
+        uint16_t selected[MANIFOLD_MAX_CONTACT_COUNT] = {};
+        uint16_t selected_count = 1;
+
+        // The deepest contact
+        for(uint16_t i = 1; i < contact_count; i++) {
+            if (contact_depth[i] < contact_depth[selected[0]]) {
+                selected[0] = i;
+            }
+        }
+        const sVector3 &first = contact_points[selected[0]];
+
+        // The furthest from it, on the contact plane
+        float max_distance = MANIFOLD_REDUCTION_EPSILON;
+        for(uint16_t i = 0; i < contact_count; i++) {
+            const sVector3 delta = contact_points[i].subs(first);
+            const sVector3 delta_on_plane = delta.subs(normal.mult(dot_prod(delta, normal)));
+            const float distance = dot_prod(delta_on_plane, delta_on_plane);
+
+            if (distance > max_distance) {
+                max_distance = distance;
+                selected[1] = i;
+                selected_count = 2;
+            }
+        }
+
+        if (selected_count == 2) {
+            const sVector3 &second = contact_points[selected[1]];
+
+            // The largest triangle with both, on either side
+            float max_area = MANIFOLD_REDUCTION_EPSILON;
+            float winding = 1.0f;
+            for(uint16_t i = 0; i < contact_count; i++) {
+                const float area = get_signed_area(normal, first, second, contact_points[i]);
+
+                if (fabsf(area) > max_area) {
+                    max_area = fabsf(area);
+                    winding = (area > 0.0f) ? 1.0f : -1.0f;
+                    selected[2] = i;
+                    selected_count = 3;
+                }
+            }
+
+            // The largest area outside of any edge of the triangle
+            if (selected_count == 3) {
+                const sVector3 &third = contact_points[selected[2]];
+
+                max_area = MANIFOLD_REDUCTION_EPSILON;
+                for(uint16_t i = 0; i < contact_count; i++) {
+                    const sVector3 &point = contact_points[i];
+                    const float area = MAX(-winding * get_signed_area(normal, first, second, point),
+                                           MAX(-winding * get_signed_area(normal, second, third, point),
+                                               -winding * get_signed_area(normal, third, first, point)));
+
+                    if (area > max_area) {
+                        max_area = area;
+                        selected[3] = i;
+                        selected_count = 4;
+                    }
+                }
+            }
+        }
+
+        sVector3 selected_points[MANIFOLD_MAX_CONTACT_COUNT];
+        float selected_depth[MANIFOLD_MAX_CONTACT_COUNT];
+        for(uint16_t i = 0; i < selected_count; i++) {
+            selected_points[i] = contact_points[selected[i]];
+            selected_depth[i] = contact_depth[selected[i]];
+        }
+
+        memcpy(contact_points, selected_points, sizeof(sVector3) * selected_count);
+        memcpy(contact_depth, selected_depth, sizeof(float) * selected_count);
+
+        return selected_count;
+    }
+};
+
+#endif // MANIFOLD_REDUCTION_H_
@@ -0,0 +1,374 @@
+#ifndef OBB_COLLISION_H_
+#define OBB_COLLISION_H_
+
+#include "constants.h"
+#include "face_clipping.h"
+#include "geometry.h"
+#include "math.h"
+#include "transform.h"
+#include "vector.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+//**
+// OBB vs OBB
+// Closed form SAT for two oriented boxes, directly from its transforms
+// (the boxes are the unit cube scaled, rotated and moved).
+// Tests the 3 + 3 face axes and the 9 edge cross products, using the
+// rotation between both boxes (and its absolute value, with an epsilon for
+// the near parallel edges). The contacts are generated by clipping the
+// incident face against the side planes of the reference face, for face
+// axes, or as the closest points between both edges, for edge axes.
+// The normal goes from the box 1 to the box 2
+// If there is no collision, the separating_distance is a lower bound of
+// the distance between the shapes
+// */
+
+#define OBB_PARALLEL_EPSILON 0.00001f
+
+namespace OBB {
+
+    struct sOBB {
+        sVector3  center = {};
+        sVector3  axis[3] = {};
+        float     half_size[3] = {};
+    };
+
+    inline sOBB get_OBB_from_transform(const sTransform &transform) {
+        sOBB box = {};
+
+        box.center = transform.position;
+        box.axis[0] = transform.apply_rotation({1.0f, 0.0f, 0.0f});
+        box.axis[1] = transform.apply_rotation({0.0f, 1.0f, 0.0f});
+        box.axis[2] = transform.apply_rotation({0.0f, 0.0f, 1.0f});
+        box.half_size[0] = transform.scale.x * 0.5f;
+        box.half_size[1] = transform.scale.y * 0.5f;
+        box.half_size[2] = transform.scale.z * 0.5f;
+
+        return box;
+    }
+
+    // Face contacts: clip the most antiparallel face of the incident box
+    // against the side planes of the reference face, and keep the points
+    // below the reference face
+    inline uint16_t get_face_contacts(const sOBB &reference,
+                                      const uint32_t reference_axis,
+                                      const sVector3 &reference_normal,
+                                      const sOBB &incident,
+                                      sVector3 *contact_points,
+                                      float *contact_depth) {
+        // Incident face
+        uint32_t incident_axis = 0;
+        float incident_facing = 0.0f;
+        for(uint32_t i = 0; i < 3; i++) {
+            const float facing = dot_prod(incident.axis[i], reference_normal);
+            if (fabsf(facing) > fabsf(incident_facing)) {
+                incident_facing = facing;
+                incident_axis = i;
+            }
+        }
+
+        const uint32_t u = (incident_axis + 1) % 3;
+        const uint32_t v = (incident_axis + 2) % 3;
+        const sVector3 incident_normal = incident.axis[incident_axis].mult((incident_facing > 0.0f) ? -1.0f : 1.0f);
+        const sVector3 incident_center = incident.center.sum(incident_normal.mult(incident.half_size[incident_axis]));
+        const sVector3 incident_u = incident.axis[u].mult(incident.half_size[u]);
+        const sVector3 incident_v = incident.axis[v].mult(incident.half_size[v]);
+
+        // 4 points of the incident face, and up to 4 more from the clipping
+        sVector3 clip_buffer[2][8] = {};
+        sVector3 *to_clip = clip_buffer[0];
+        sVector3 *clipped = clip_buffer[1];
+        to_clip[0] = incident_center.sum(incident_u).sum(incident_v);
+        to_clip[1] = incident_center.subs(incident_u).sum(incident_v);
+        to_clip[2] = incident_center.subs(incident_u).subs(incident_v);
+        to_clip[3] = incident_center.sum(incident_u).subs(incident_v);
+        uint32_t num_of_points = 4;
+
+        // Side planes of the reference face
+        for(uint32_t i = 1; i < 3 && num_of_points > 0; i++) {
+            const uint32_t side_axis = (reference_axis + i) % 3;
+            const sVector3 side_offset = reference.axis[side_axis].mult(reference.half_size[side_axis]);
+
+            for(uint32_t side = 0; side < 2 && num_of_points > 0; side++) {
+                const sVector3 side_normal = (side == 0) ? reference.axis[side_axis] : reference.axis[side_axis].invert();
+                const sVector3 side_origin = (side == 0) ? reference.center.sum(side_offset) : reference.center.subs(side_offset);
+
+                num_of_points = clipping::clip_polygon_to_plane(sPlane{side_origin, side_normal},
+                                                                to_clip,
+                                                                num_of_points,
+                                                                clipped);
+                sVector3 *tmp = to_clip;
+                to_clip = clipped;
+                clipped = tmp;
+            }
+        }
+
+        // Keep the points below the reference face
+        const sVector3 reference_origin = reference.center.sum(reference_normal.mult(reference.half_size[reference_axis]));
+        uint16_t contact_count = 0;
+        for(uint32_t i = 0; i < num_of_points && contact_count < MAX_CONTACT_COUNT; i++) {
+            const float depth = dot_prod(reference_normal, to_clip[i].subs(reference_origin));
+
+            if (depth <= 0.0f) {
+                contact_points[contact_count] = to_clip[i];
+                contact_depth[contact_count] = depth;
+                contact_count++;
+            }
+        }
+
+        return contact_count;
+    }
+
+    // The edge of the box along the axis, that is furthest on the direction
+    inline sVector3 get_support_edge_center(const sOBB &box,
+                                            const uint32_t edge_axis,
+                                            const sVector3 &direction) {
+        sVector3 center = box.center;
+
+        for(uint32_t i = 1; i < 3; i++) {
+            const uint32_t axis = (edge_axis + i) % 3;
+            const float sign = (dot_prod(box.axis[axis], direction) > 0.0f) ? 1.0f : -1.0f;
+            center = center.sum(box.axis[axis].mult(sign * box.half_size[axis]));
+        }
+
+        return center;
+    }
+
+    inline bool OBB_OBB_collision(const sTransform &transform1,
+                                  const sTransform &transform2,
+                                  sVector3 *normal,
+                                  sVector3 *contact_points,
+                                  float *contact_depth,
+                                  uint16_t *contanct_points_count,
+                                  float *separating_distance = NULL) {
+        const sOBB box1 = get_OBB_from_transform(transform1);
+        const sOBB box2 = get_OBB_from_transform(transform2);
+        const float *a = box1.half_size;
+        const float *b = box2.half_size;
+
+        // Rotation of box2 on box1's space
+        float R[3][3], abs_R[3][3];
+        for(uint32_t i = 0; i < 3; i++) {
+            for(uint32_t j = 0; j < 3; j++) {
+                R[i][j] = dot_prod(box1.axis[i], box2.axis[j]);
+                abs_R[i][j] = fabsf(R[i][j]) + OBB_PARALLEL_EPSILON;
+            }
+        }
+
+        // Distance between centers, on box1's space
+        const sVector3 distance = box2.center.subs(box1.center);
+        const float t[3] = { dot_prod(distance, box1.axis[0]),
+                             dot_prod(distance, box1.axis[1]),
+                             dot_prod(distance, box1.axis[2]) };
+
+        // Best axis of each type: 0-2 box1 faces, 3-5 box2 faces; edges as i * 3 + j
+        float best_face_separation = -FLT_MAX;
+        uint32_t best_face_axis = 0;
+        float best_edge_separation = -FLT_MAX;
+        uint32_t best_edge_axis = 0;
+        sVector3 best_edge_normal = {};
+
+        // Box1's face axes
+        for(uint32_t i = 0; i < 3; i++) {
+            const float radius2 = b[0] * abs_R[i][0] + b[1] * abs_R[i][1] + b[2] * abs_R[i][2];
+            const float separation = fabsf(t[i]) - (a[i] + radius2);
+
+            if (separation > 0.0f) {
+                if (separating_distance != NULL) {
+                    *separating_distance = separation;
+                }
+                return false;
+            }
+            if (separation > best_face_separation) {
+                best_face_separation = separation;
+                best_face_axis = i;
+            }
+        }
+
+        // Box2's face axes
+        for(uint32_t j = 0; j < 3; j++) {
+            const float radius1 = a[0] * abs_R[0][j] + a[1] * abs_R[1][j] + a[2] * abs_R[2][j];
+            const float separation = fabsf(t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j]) - (radius1 + b[j]);
+
+            if (separation > 0.0f) {
+                if (separating_distance != NULL) {
+                    *separating_distance = separation;
+                }
+                return false;
+            }
+            if (separation > best_face_separation) {
+                best_face_separation = separation;
+                best_face_axis = 3 + j;
+            }
+        }
+
+        // Edge axes: box1's axis i x box2's axis j
+        for(uint32_t i = 0; i < 3; i++) {
+            const uint32_t i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+
+            for(uint32_t j = 0; j < 3; j++) {
+                const uint32_t j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+
+                // The length of the cross product, skip the parallel edges
+                const float axis_len = sqrtf(MAX(0.0f, 1.0f - R[i][j] * R[i][j]));
+                if (axis_len < 0.001f) {
+                    continue;
+                }
+
+                const float radius1 = a[i1] * abs_R[i2][j] + a[i2] * abs_R[i1][j];
+                const float radius2 = b[j1] * abs_R[i][j2] + b[j2] * abs_R[i][j1];
+                const float center_distance = t[i2] * R[i1][j] - t[i1] * R[i2][j];
+                const float separation = (fabsf(center_distance) - (radius1 + radius2)) / axis_len;
+
+                if (separation > 0.0f) {
+                    if (separating_distance != NULL) {
+                        *separating_distance = separation;
+                    }
+                    return false;
+                }
+                if (separation > best_edge_separation) {
+                    best_edge_separation = separation;
+                    best_edge_axis = (i * 3) + j;
+                    best_edge_normal = cross_prod(box1.axis[i], box2.axis[j]).mult(1.0f / axis_len);
+                }
+            }
+        }
+
+        // Favour the face axes, for stable contacts
+        const float k_edge_rel_tolerance = 0.95f;
+        const float k_abs_tolerance = 0.01f * 0.5f;
+
+        if (best_edge_separation > k_edge_rel_tolerance * best_face_separation + k_abs_tolerance) {
+            // Edge contact: the mid point between the closest points of the edges
+            if (dot_prod(best_edge_normal, distance) < 0.0f) {
+                best_edge_normal = best_edge_normal.invert();
+            }
+
+            const uint32_t edge1_axis = best_edge_axis / 3;
+            const uint32_t edge2_axis = best_edge_axis % 3;
+            const sVector3 edge1_center = get_support_edge_center(box1, edge1_axis, best_edge_normal);
+            const sVector3 edge2_center = get_support_edge_center(box2, edge2_axis, best_edge_normal.invert());
+            const sVector3 &edge1 = box1.axis[edge1_axis];
+            const sVector3 &edge2 = box2.axis[edge2_axis];
+
+            // Closest points of two lines
+            const sVector3 center_diff = edge1_center.subs(edge2_center);
+            const float d12 = dot_prod(edge1, edge2);
+            const float d1 = dot_prod(edge1, center_diff);
+            const float d2 = dot_prod(edge2, center_diff);
+            const float denom = 1.0f - d12 * d12;
+            const float s = MIN(MAX((d12 * d2 - d1) / denom, -a[edge1_axis]), a[edge1_axis]);
+            const float u = MIN(MAX((d12 * s) + d2, -b[edge2_axis]), b[edge2_axis]);
+
+            const sVector3 point1 = edge1_center.sum(edge1.mult(s));
+            const sVector3 point2 = edge2_center.sum(edge2.mult(u));
+
+            *normal = best_edge_normal;
+            contact_points[0] = point1.sum(point2).mult(0.5f);
+            contact_depth[0] = best_edge_separation;
+            *contanct_points_count = 1;
+
+            return true;
+        }
+
+        if (best_face_axis < 3) {
+            // Box1 is the reference
+            const sVector3 &axis = box1.axis[best_face_axis];
+            const sVector3 reference_normal = (t[best_face_axis] > 0.0f) ? axis : axis.invert();
+
+            *normal = reference_normal;
+            *contanct_points_count = get_face_contacts(box1,
+                                                       best_face_axis,
+                                                       reference_normal,
+                                                       box2,
+                                                       contact_points,
+                                                       contact_depth);
+        } else {
+            // Box2 is the reference, with its normal facing box1
+            const sVector3 &axis = box2.axis[best_face_axis - 3];
+            const sVector3 reference_normal = (dot_prod(axis, distance) < 0.0f) ? axis : axis.invert();
+
+            *normal = reference_normal.invert();
+            *contanct_points_count = get_face_contacts(box2,
+                                                       best_face_axis - 3,
+                                                       reference_normal,
+                                                       box1,
+                                                       contact_points,
+                                                       contact_depth);
+        }
+
+        return *contanct_points_count > 0;
+    }
+
+    //**
+    // Sphere vs OBB
+    // Moves the sphere's center to the box's local space, and clamps it to
+    // the half sizes for the closest point of the box. If the center is
+    // inside the box, it is pushed out by the closest face.
+    // The normal goes from the box to the sphere
+    // */
+    inline bool sphere_OBB_collision(const sVector3 &sphere_center,
+                                     const float sphere_radius,
+                                     const sTransform &box_transform,
+                                     sVector3 *normal,
+                                     sVector3 *contact_points,
+                                     float *contact_depth,
+                                     uint16_t *contanct_points_count,
+                                     float *separating_distance = NULL) {
+        const sVector3 half_size = box_transform.scale.mult(0.5f);
+        const sVector3 local_center = box_transform.apply_inverse_rotation(sphere_center.subs(box_transform.position));
+
+        const sVector3 closest = { MIN(MAX(local_center.x, -half_size.x), half_size.x),
+                                   MIN(MAX(local_center.y, -half_size.y), half_size.y),
+                                   MIN(MAX(local_center.z, -half_size.z), half_size.z) };
+        const sVector3 to_center = local_center.subs(closest);
+        const float distance_squared = dot_prod(to_center, to_center);
+
+        if (distance_squared > sphere_radius * sphere_radius) {
+            if (separating_distance != NULL) {
+                *separating_distance = sqrtf(distance_squared) - sphere_radius;
+            }
+            return false;
+        }
+
+        sVector3 local_normal = {};
+        float depth = 0.0f;
+
+        if (distance_squared > 0.000001f) {
+            // Outside: by the closest point of a face, edge or corner
+            const float distance = sqrtf(distance_squared);
+            local_normal = to_center.mult(1.0f / distance);
+            depth = distance - sphere_radius;
+        } else {
+            // Inside: by the face with the smallest penetration
+            const float face_distances[3] = { half_size.x - fabsf(local_center.x),
+                                              half_size.y - fabsf(local_center.y),
+                                              half_size.z - fabsf(local_center.z) };
+            uint32_t min_axis = 0;
+            for(uint32_t i = 1; i < 3; i++) {
+                if (face_distances[i] < face_distances[min_axis]) {
+                    min_axis = i;
+                }
+            }
+
+            const float center_coords[3] = { local_center.x, local_center.y, local_center.z };
+            const float sign = (center_coords[min_axis] < 0.0f) ? -1.0f : 1.0f;
+            local_normal = { (min_axis == 0) ? sign : 0.0f,
+                             (min_axis == 1) ? sign : 0.0f,
+                             (min_axis == 2) ? sign : 0.0f };
+            depth = -face_distances[min_axis] - sphere_radius;
+        }
+
+        *normal = box_transform.apply_rotation(local_normal);
+        contact_points[0] = sphere_center.subs(normal->mult(sphere_radius));
+        contact_depth[0] = depth;
+        *contanct_points_count = 1;
+
+        return true;
+    }
+};
+
+#endif // OBB_COLLISION_H_
@@ -1 +1,935 @@
 #include "phys_broadphase.h"
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <climits>
+
+// =================
+//  LIFECYCLE
+// =================
+
+void sAABBTree::init(const uint32_t initial_capacity) {
+    node_capacity = (initial_capacity == 0) ? 16 : initial_capacity;
+    node_count = 0;
+    root = AABB_TREE_NULL_NODE;
+
+    nodes = (sAABBTreeNode*) malloc(sizeof(sAABBTreeNode) * node_capacity);
+
+    // Link all the nodes on the free list
+    for(uint32_t i = 0; i < node_capacity; i++) {
+        nodes[i] = sAABBTreeNode{};
+        nodes[i].parent = i + 1;
+    }
+    nodes[node_capacity - 1].parent = AABB_TREE_NULL_NODE;
+    free_list = 0;
+
+    query_stack_capacity = 64;
+    query_stack = (uint32_t*) malloc(sizeof(uint32_t) * query_stack_capacity);
+}
+
+void sAABBTree::clean() {
+    free(nodes);
+    free(query_stack);
+    nodes = NULL;
+    query_stack = NULL;
+    node_capacity = 0;
+    node_count = 0;
+    query_stack_capacity = 0;
+    root = AABB_TREE_NULL_NODE;
+    free_list = AABB_TREE_NULL_NODE;
+}
+
+// =================
+//  NODE POOL
+// =================
+
+uint32_t sAABBTree::allocate_node() {
+    // If there is no more free nodes, grow the pool
+    if (free_list == AABB_TREE_NULL_NODE) {
+        uint32_t old_capacity = node_capacity;
+        node_capacity *= 2;
+        nodes = (sAABBTreeNode*) realloc(nodes, sizeof(sAABBTreeNode) * node_capacity);
+
+        for(uint32_t i = old_capacity; i < node_capacity; i++) {
+            nodes[i] = sAABBTreeNode{};
+            nodes[i].parent = i + 1;
+        }
+        nodes[node_capacity - 1].parent = AABB_TREE_NULL_NODE;
+        free_list = old_capacity;
+    }
+
+    uint32_t node_id = free_list;
+    free_list = nodes[node_id].parent;
+
+    nodes[node_id].parent = AABB_TREE_NULL_NODE;
+    nodes[node_id].child1 = AABB_TREE_NULL_NODE;
+    nodes[node_id].child2 = AABB_TREE_NULL_NODE;
+    nodes[node_id].height = 0;
+    nodes[node_id].user_id = 0;
+    node_count++;
+
+    return node_id;
+}
+
+void sAABBTree::free_node(const uint32_t node_id) {
+    nodes[node_id].parent = free_list;
+    nodes[node_id].height = -1;
+    free_list = node_id;
+    node_count--;
+}
+
+// =================
+//  PROXIES
+// =================
+
+uint32_t sAABBTree::create_proxy(const sAABB &aabb,
+                                 const uint32_t user_id) {
+    uint32_t proxy_id = allocate_node();
+
+    nodes[proxy_id].aabb = aabb.expand(AABB_FAT_MARGIN);
+    nodes[proxy_id].user_id = user_id;
+    nodes[proxy_id].height = 0;
+
+    insert_leaf(proxy_id);
+
+    return proxy_id;
+}
+
+void sAABBTree::destroy_proxy(const uint32_t proxy_id) {
+    remove_leaf(proxy_id);
+    free_node(proxy_id);
+}
+
+bool sAABBTree::move_proxy(const uint32_t proxy_id,
+                           const sAABB &aabb) {
+    // Early out: the fat AABB still contains the body
+    if (nodes[proxy_id].aabb.contains(aabb)) {
+        return false;
+    }
+
+    remove_leaf(proxy_id);
+    nodes[proxy_id].aabb = aabb.expand(AABB_FAT_MARGIN);
+    insert_leaf(proxy_id);
+
+    return true;
+}
+
+// =================
+//  TREE OPERATIONS
+// =================
+
+void sAABBTree::insert_leaf(const uint32_t leaf) {
+    if (root == AABB_TREE_NULL_NODE) {
+        root = leaf;
+        nodes[root].parent = AABB_TREE_NULL_NODE;
+        return;
+    }
+
+    // Find the best sibling, descending via the Surface Area Heuristic
+    const sAABB leaf_aabb = nodes[leaf].aabb;
+    uint32_t index = root;
+    while(!nodes[index].is_leaf()) {
+        const uint32_t child1 = nodes[index].child1;
+        const uint32_t child2 = nodes[index].child2;
+
+        const float area = nodes[index].aabb.get_area();
+        const float combined_area = nodes[index].aabb.merge(leaf_aabb).get_area();
+
+        // Cost of creating a new parent for this node and the new leaf
+        const float cost = 2.0f * combined_area;
+        // Minimum cost of pushing the leaf further down the tree
+        const float inheritance_cost = 2.0f * (combined_area - area);
+
+        float cost1 = leaf_aabb.merge(nodes[child1].aabb).get_area() + inheritance_cost;
+        if (!nodes[child1].is_leaf()) {
+            cost1 -= nodes[child1].aabb.get_area();
+        }
+
+        float cost2 = leaf_aabb.merge(nodes[child2].aabb).get_area() + inheritance_cost;
+        if (!nodes[child2].is_leaf()) {
+            cost2 -= nodes[child2].aabb.get_area();
+        }
+
+        // Descend acording to the minimum cost
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+
+        index = (cost1 < cost2) ? child1 : child2;
+    }
+
+    const uint32_t sibling = index;
+
+    // Create a new parent for the sibling and the leaf
+    const uint32_t old_parent = nodes[sibling].parent;
+    const uint32_t new_parent = allocate_node();
+    nodes[new_parent].parent = old_parent;
+    nodes[new_parent].aabb = leaf_aabb.merge(nodes[sibling].aabb);
+    nodes[new_parent].height = nodes[sibling].height + 1;
+    nodes[new_parent].child1 = sibling;
+    nodes[new_parent].child2 = leaf;
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    if (old_parent != AABB_TREE_NULL_NODE) {
+        if (nodes[old_parent].child1 == sibling) {
+            nodes[old_parent].child1 = new_parent;
+        } else {
+            nodes[old_parent].child2 = new_parent;
+        }
+    } else {
+        root = new_parent;
+    }
+
+    // Walk back up the tree fixing the heights and AABBs
+    index = nodes[leaf].parent;
+    while(index != AABB_TREE_NULL_NODE) {
+        index = balance(index);
+
+        const uint32_t child1 = nodes[index].child1;
+        const uint32_t child2 = nodes[index].child2;
+
+        nodes[index].height = 1 + MAX(nodes[child1].height, nodes[child2].height);
+        nodes[index].aabb = nodes[child1].aabb.merge(nodes[child2].aabb);
+
+        index = nodes[index].parent;
+    }
+}
+
+void sAABBTree::remove_leaf(const uint32_t leaf) {
+    if (leaf == root) {
+        root = AABB_TREE_NULL_NODE;
+        return;
+    }
+
+    const uint32_t parent = nodes[leaf].parent;
+    const uint32_t grand_parent = nodes[parent].parent;
+    const uint32_t sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grand_parent != AABB_TREE_NULL_NODE) {
+        // Destroy the parent and connect the sibling to the grand parent
+        if (nodes[grand_parent].child1 == parent) {
+            nodes[grand_parent].child1 = sibling;
+        } else {
+            nodes[grand_parent].child2 = sibling;
+        }
+        nodes[sibling].parent = grand_parent;
+        free_node(parent);
+
+        // Adjust the ancestors
+        uint32_t index = grand_parent;
+        while(index != AABB_TREE_NULL_NODE) {
+            index = balance(index);
+
+            const uint32_t child1 = nodes[index].child1;
+            const uint32_t child2 = nodes[index].child2;
+
+            nodes[index].aabb = nodes[child1].aabb.merge(nodes[child2].aabb);
+            nodes[index].height = 1 + MAX(nodes[child1].height, nodes[child2].height);
+
+            index = nodes[index].parent;
+        }
+    } else {
+        root = sibling;
+        nodes[sibling].parent = AABB_TREE_NULL_NODE;
+        free_node(parent);
+    }
+
+    nodes[leaf].parent = AABB_TREE_NULL_NODE;
+}
+
+// Perform a left or right rotation if the node A is imbalanced
+// Returns the new root of the subtree
+uint32_t sAABBTree::balance(const uint32_t i_A) {
+    sAABBTreeNode *A = &nodes[i_A];
+    if (A->is_leaf() || A->height < 2) {
+        return i_A;
+    }
+
+    const uint32_t i_B = A->child1;
+    const uint32_t i_C = A->child2;
+    sAABBTreeNode *B = &nodes[i_B];
+    sAABBTreeNode *C = &nodes[i_C];
+
+    const int32_t balance_factor = C->height - B->height;
+
+    // Rotate C up
+    if (balance_factor > 1) {
+        const uint32_t i_F = C->child1;
+        const uint32_t i_G = C->child2;
+        sAABBTreeNode *F = &nodes[i_F];
+        sAABBTreeNode *G = &nodes[i_G];
+
+        // Swap A and C
+        C->child1 = i_A;
+        C->parent = A->parent;
+        A->parent = i_C;
+
+        // A's old parent should point to C
+        if (C->parent != AABB_TREE_NULL_NODE) {
+            if (nodes[C->parent].child1 == i_A) {
+                nodes[C->parent].child1 = i_C;
+            } else {
+                nodes[C->parent].child2 = i_C;
+            }
+        } else {
+            root = i_C;
+        }
+
+        // Rotate
+        if (F->height > G->height) {
+            C->child2 = i_F;
+            A->child2 = i_G;
+            G->parent = i_A;
+            A->aabb = B->aabb.merge(G->aabb);
+            C->aabb = A->aabb.merge(F->aabb);
+
+            A->height = 1 + MAX(B->height, G->height);
+            C->height = 1 + MAX(A->height, F->height);
+        } else {
+            C->child2 = i_G;
+            A->child2 = i_F;
+            F->parent = i_A;
+            A->aabb = B->aabb.merge(F->aabb);
+            C->aabb = A->aabb.merge(G->aabb);
+
+            A->height = 1 + MAX(B->height, F->height);
+            C->height = 1 + MAX(A->height, G->height);
+        }
+
+        return i_C;
+    }
+
+    // Rotate B up
+    if (balance_factor < -1) {
+        const uint32_t i_D = B->child1;
+        const uint32_t i_E = B->child2;
+        sAABBTreeNode *D = &nodes[i_D];
+        sAABBTreeNode *E = &nodes[i_E];
+
+        // Swap A and B
+        B->child1 = i_A;
+        B->parent = A->parent;
+        A->parent = i_B;
+
+        // A's old parent should point to B
+        if (B->parent != AABB_TREE_NULL_NODE) {
+            if (nodes[B->parent].child1 == i_A) {
+                nodes[B->parent].child1 = i_B;
+            } else {
+                nodes[B->parent].child2 = i_B;
+            }
+        } else {
+            root = i_B;
+        }
+
+        // Rotate
+        if (D->height > E->height) {
+            B->child2 = i_D;
+            A->child1 = i_E;
+            E->parent = i_A;
+            A->aabb = C->aabb.merge(E->aabb);
+            B->aabb = A->aabb.merge(D->aabb);
+
+            A->height = 1 + MAX(C->height, E->height);
+            B->height = 1 + MAX(A->height, D->height);
+        } else {
+            B->child2 = i_E;
+            A->child1 = i_D;
+            D->parent = i_A;
+            A->aabb = C->aabb.merge(D->aabb);
+            B->aabb = A->aabb.merge(E->aabb);
+
+            A->height = 1 + MAX(C->height, D->height);
+            B->height = 1 + MAX(A->height, E->height);
+        }
+
+        return i_B;
+    }
+
+    return i_A;
+}
+
+// =================
+//  PAIR GENERATION
+// =================
+
+void sAABBTree::push_to_query_stack(const uint32_t node_id,
+                                    uint32_t *stack_size) {
+    if (*stack_size == query_stack_capacity) {
+        query_stack_capacity *= 2;
+        query_stack = (uint32_t*) realloc(query_stack, sizeof(uint32_t) * query_stack_capacity);
+    }
+
+    query_stack[(*stack_size)++] = node_id;
+}
+
+void sAABBTree::get_overlapping_pairs(sPairBuffer *pair_buffer) {
+    if (root == AABB_TREE_NULL_NODE) {
+        return;
+    }
+
+    // Query each leaf against the tree, and only add the pair
+    // when the other leaf has a bigger index, to avoid duplicates
+    for(uint32_t leaf = 0; leaf < node_capacity; leaf++) {
+        if (nodes[leaf].height != 0) {
+            continue;
+        }
+
+        const sAABB leaf_aabb = nodes[leaf].aabb;
+
+        uint32_t stack_size = 0;
+        push_to_query_stack(root, &stack_size);
+
+        while(stack_size > 0) {
+            const uint32_t node_id = query_stack[--stack_size];
+            const sAABBTreeNode *node = &nodes[node_id];
+
+            if (!node->aabb.overlaps(leaf_aabb)) {
+                continue;
+            }
+
+            if (node->is_leaf()) {
+                if (node_id > leaf) {
+                    pair_buffer->add(nodes[leaf].user_id, node->user_id);
+                }
+            } else {
+                push_to_query_stack(node->child1, &stack_size);
+                push_to_query_stack(node->child2, &stack_size);
+            }
+        }
+    }
+}
+
+void sAABBTree::get_overlapping_pairs(const sAABBTree &tree,
+                                      sPairBuffer *pair_buffer) {
+    if (root == AABB_TREE_NULL_NODE || tree.root == AABB_TREE_NULL_NODE) {
+        return;
+    }
+
+    // Query each leaf of this tree against the other tree
+    for(uint32_t leaf = 0; leaf < node_capacity; leaf++) {
+        if (nodes[leaf].height != 0) {
+            continue;
+        }
+
+        const sAABB leaf_aabb = nodes[leaf].aabb;
+
+        uint32_t stack_size = 0;
+        push_to_query_stack(tree.root, &stack_size);
+
+        while(stack_size > 0) {
+            const uint32_t node_id = query_stack[--stack_size];
+            const sAABBTreeNode *node = &tree.nodes[node_id];
+
+            if (!node->aabb.overlaps(leaf_aabb)) {
+                continue;
+            }
+
+            if (node->is_leaf()) {
+                pair_buffer->add(nodes[leaf].user_id, node->user_id);
+            } else {
+                push_to_query_stack(node->child1, &stack_size);
+                push_to_query_stack(node->child2, &stack_size);
+            }
+        }
+    }
+}
+
+uint32_t sAABBTree::query(const sAABB &aabb,
+                          uint32_t *user_ids) {
+    if (root == AABB_TREE_NULL_NODE) {
+        return 0;
+    }
+
+    uint32_t count = 0;
+    uint32_t stack_size = 0;
+    push_to_query_stack(root, &stack_size);
+
+    while(stack_size > 0) {
+        const uint32_t node_id = query_stack[--stack_size];
+        const sAABBTreeNode *node = &nodes[node_id];
+
+        if (!node->aabb.overlaps(aabb)) {
+            continue;
+        }
+
+        if (node->is_leaf()) {
+            user_ids[count++] = node->user_id;
+        } else {
+            push_to_query_stack(node->child1, &stack_size);
+            push_to_query_stack(node->child2, &stack_size);
+        }
+    }
+
+    return count;
+}
+
+// =================
+//  SWEEP AND PRUNE
+// =================
+
+void sSAPBroadphase::init(const uint32_t initial_capacity) {
+    proxy_capacity = (initial_capacity == 0) ? 16 : initial_capacity;
+    proxy_free_list = SAP_NULL_PROXY;
+    endpoint_count = 0;
+
+    // Link all the proxies on the free list
+    proxies = (sSAPProxy*) malloc(sizeof(sSAPProxy) * proxy_capacity);
+    for(uint32_t i = 0; i < proxy_capacity; i++) {
+        proxies[i] = sSAPProxy{};
+        proxies[i].next_free = (i + 1 < proxy_capacity) ? i + 1 : SAP_NULL_PROXY;
+    }
+    proxy_free_list = 0;
+
+    for(int axis = 0; axis < 3; axis++) {
+        endpoints[axis] = (sSAPEndpoint*) malloc(sizeof(sSAPEndpoint) * proxy_capacity * 2);
+    }
+
+    pairs.init(proxy_capacity * 2);
+    pair_map.init(proxy_capacity * 4);
+
+    event_capacity = proxy_capacity;
+    event_count = 0;
+    events = (sSAPPairEvent*) malloc(sizeof(sSAPPairEvent) * event_capacity);
+}
+
+void sSAPBroadphase::clean() {
+    for(int axis = 0; axis < 3; axis++) {
+        free(endpoints[axis]);
+        endpoints[axis] = NULL;
+    }
+    free(proxies);
+    free(events);
+    proxies = NULL;
+    events = NULL;
+
+    pairs.clean();
+    pair_map.clean();
+
+    proxy_capacity = 0;
+    endpoint_count = 0;
+    event_count = 0;
+    event_capacity = 0;
+}
+
+uint32_t sSAPBroadphase::create_proxy(const sAABB &aabb,
+                                      const uint32_t user_id,
+                                      const bool is_static) {
+    // Grow the proxies and the endpoints if there is no more space
+    if (proxy_free_list == SAP_NULL_PROXY) {
+        const uint32_t old_capacity = proxy_capacity;
+        proxy_capacity *= 2;
+
+        proxies = (sSAPProxy*) realloc(proxies, sizeof(sSAPProxy) * proxy_capacity);
+        for(uint32_t i = old_capacity; i < proxy_capacity; i++) {
+            proxies[i] = sSAPProxy{};
+            proxies[i].next_free = (i + 1 < proxy_capacity) ? i + 1 : SAP_NULL_PROXY;
+        }
+        proxy_free_list = old_capacity;
+
+        for(int axis = 0; axis < 3; axis++) {
+            endpoints[axis] = (sSAPEndpoint*) realloc(endpoints[axis], sizeof(sSAPEndpoint) * proxy_capacity * 2);
+        }
+    }
+
+    const uint32_t proxy_id = proxy_free_list;
+    proxy_free_list = proxies[proxy_id].next_free;
+
+    sSAPProxy *proxy = &proxies[proxy_id];
+    proxy->user_id = user_id;
+    proxy->is_static = is_static;
+    proxy->next_free = SAP_NULL_PROXY;
+
+    // Add the endpoints at the end of the axis, on the infinite,
+    // and then sort them to its place via a regular move
+    for(int axis = 0; axis < 3; axis++) {
+        endpoints[axis][endpoint_count] = sSAPEndpoint{FLT_MAX, (proxy_id << 1)};
+        endpoints[axis][endpoint_count + 1] = sSAPEndpoint{FLT_MAX, (proxy_id << 1) | 1};
+        proxy->min_endpoint[axis] = endpoint_count;
+        proxy->max_endpoint[axis] = endpoint_count + 1;
+    }
+    endpoint_count += 2;
+
+    move_proxy(proxy_id, aabb);
+
+    return proxy_id;
+}
+
+void sSAPBroadphase::destroy_proxy(const uint32_t proxy_id) {
+    // Move the endpoints to the infinite, in order to remove all the pairs,
+    // and then pop them from the end of the axis
+    sAABB infinite_aabb = {};
+    infinite_aabb.min = {FLT_MAX, FLT_MAX, FLT_MAX};
+    infinite_aabb.max = {FLT_MAX, FLT_MAX, FLT_MAX};
+    move_proxy(proxy_id, infinite_aabb);
+
+    // Since the endpoints are on the end, but there can be ties,
+    // swap them to the last positions
+    for(int axis = 0; axis < 3; axis++) {
+        if (proxies[proxy_id].max_endpoint[axis] != endpoint_count - 1) {
+            swap_endpoints(axis, proxies[proxy_id].max_endpoint[axis], endpoint_count - 1);
+        }
+        if (proxies[proxy_id].min_endpoint[axis] != endpoint_count - 2) {
+            swap_endpoints(axis, proxies[proxy_id].min_endpoint[axis], endpoint_count - 2);
+        }
+    }
+    endpoint_count -= 2;
+
+    proxies[proxy_id].next_free = proxy_free_list;
+    proxy_free_list = proxy_id;
+}
+
+void sSAPBroadphase::move_proxy(const uint32_t proxy_id,
+                                const sAABB &aabb) {
+    for(int axis = 0; axis < 3; axis++) {
+        const uint32_t min_endpoint = proxies[proxy_id].min_endpoint[axis];
+        const uint32_t max_endpoint = proxies[proxy_id].max_endpoint[axis];
+
+        const float old_min = endpoints[axis][min_endpoint].value;
+        const float old_max = endpoints[axis][max_endpoint].value;
+
+        endpoints[axis][min_endpoint].value = aabb.min.raw_values[axis];
+        endpoints[axis][max_endpoint].value = aabb.max.raw_values[axis];
+
+        // First expand the endpoints and then shrink them, in order to
+        // never cross the min and the max of the same proxy
+        if (aabb.min.raw_values[axis] < old_min) {
+            sort_min_down(axis, min_endpoint);
+        }
+        if (aabb.max.raw_values[axis] > old_max) {
+            sort_max_up(axis, max_endpoint);
+        }
+        if (aabb.min.raw_values[axis] > old_min) {
+            sort_min_up(axis, proxies[proxy_id].min_endpoint[axis]);
+        }
+        if (aabb.max.raw_values[axis] < old_max) {
+            sort_max_down(axis, proxies[proxy_id].max_endpoint[axis]);
+        }
+    }
+}
+
+// Insertion sort steps
+// Each swap between a min and a max endpoint changes the overlapping
+// state of the two proxies on this axis; if they already overlap on the
+// other two axis, then the pair is added or removed
+void sSAPBroadphase::sort_min_down(const int axis,
+                                   uint32_t endpoint) {
+    sSAPEndpoint *axis_endpoints = endpoints[axis];
+    const uint32_t proxy = axis_endpoints[endpoint].get_proxy();
+
+    while(endpoint > 0 && axis_endpoints[endpoint - 1].value > axis_endpoints[endpoint].value) {
+        const sSAPEndpoint prev = axis_endpoints[endpoint - 1];
+
+        swap_endpoints(axis, endpoint - 1, endpoint);
+
+        // Our min passed the max of other proxy: starts overlapping
+        if (prev.is_max() && overlaps_on_other_axis(proxy, prev.get_proxy(), axis)) {
+            add_pair(proxy, prev.get_proxy());
+        }
+        endpoint--;
+    }
+}
+
+void sSAPBroadphase::sort_min_up(const int axis,
+                                 uint32_t endpoint) {
+    sSAPEndpoint *axis_endpoints = endpoints[axis];
+    const uint32_t proxy = axis_endpoints[endpoint].get_proxy();
+
+    while(endpoint + 1 < endpoint_count && axis_endpoints[endpoint + 1].value < axis_endpoints[endpoint].value) {
+        const sSAPEndpoint next = axis_endpoints[endpoint + 1];
+
+        // Our min passed the max of other proxy: stops overlapping
+        if (next.is_max() && overlaps_on_other_axis(proxy, next.get_proxy(), axis)) {
+            remove_pair(proxy, next.get_proxy());
+        }
+
+        swap_endpoints(axis, endpoint, endpoint + 1);
+        endpoint++;
+    }
+}
+
+void sSAPBroadphase::sort_max_down(const int axis,
+                                   uint32_t endpoint) {
+    sSAPEndpoint *axis_endpoints = endpoints[axis];
+    const uint32_t proxy = axis_endpoints[endpoint].get_proxy();
+
+    while(endpoint > 0 && axis_endpoints[endpoint - 1].value > axis_endpoints[endpoint].value) {
+        const sSAPEndpoint prev = axis_endpoints[endpoint - 1];
+
+        // Our max passed the min of other proxy: stops overlapping
+        if (!prev.is_max() && overlaps_on_other_axis(proxy, prev.get_proxy(), axis)) {
+            remove_pair(proxy, prev.get_proxy());
+        }
+
+        swap_endpoints(axis, endpoint - 1, endpoint);
+        endpoint--;
+    }
+}
+
+void sSAPBroadphase::sort_max_up(const int axis,
+                                 uint32_t endpoint) {
+    sSAPEndpoint *axis_endpoints = endpoints[axis];
+    const uint32_t proxy = axis_endpoints[endpoint].get_proxy();
+
+    while(endpoint + 1 < endpoint_count && axis_endpoints[endpoint + 1].value < axis_endpoints[endpoint].value) {
+        const sSAPEndpoint next = axis_endpoints[endpoint + 1];
+
+        swap_endpoints(axis, endpoint, endpoint + 1);
+
+        // Our max passed the min of other proxy: starts overlapping
+        if (!next.is_max() && overlaps_on_other_axis(proxy, next.get_proxy(), axis)) {
+            add_pair(proxy, next.get_proxy());
+        }
+        endpoint++;
+    }
+}
+
+void sSAPBroadphase::swap_endpoints(const int axis,
+                                    const uint32_t endpoint1,
+                                    const uint32_t endpoint2) {
+    sSAPEndpoint *axis_endpoints = endpoints[axis];
+
+    const sSAPEndpoint tmp = axis_endpoints[endpoint1];
+    axis_endpoints[endpoint1] = axis_endpoints[endpoint2];
+    axis_endpoints[endpoint2] = tmp;
+
+    // Update the indices of the proxies
+    const sSAPEndpoint *e1 = &axis_endpoints[endpoint1];
+    const sSAPEndpoint *e2 = &axis_endpoints[endpoint2];
+    if (e1->is_max()) {
+        proxies[e1->get_proxy()].max_endpoint[axis] = endpoint1;
+    } else {
+        proxies[e1->get_proxy()].min_endpoint[axis] = endpoint1;
+    }
+    if (e2->is_max()) {
+        proxies[e2->get_proxy()].max_endpoint[axis] = endpoint2;
+    } else {
+        proxies[e2->get_proxy()].min_endpoint[axis] = endpoint2;
+    }
+}
+
+// =================
+//  SAP PAIRS
+// =================
+
+void sSAPBroadphase::add_pair(const uint32_t proxy1,
+                              const uint32_t proxy2) {
+    if (proxies[proxy1].is_static && proxies[proxy2].is_static) {
+        return;
+    }
+
+    const uint32_t id1 = proxies[proxy1].user_id;
+    const uint32_t id2 = proxies[proxy2].user_id;
+    const uint64_t key = get_pair_key(id1, id2);
+
+    if (pair_map.get(key) != PAIR_MAP_NOT_FOUND) {
+        return;
+    }
+
+    pair_map.set(key, pairs.count);
+    pairs.add(id1, id2);
+
+    add_event(id1, id2, true);
+}
+
+void sSAPBroadphase::remove_pair(const uint32_t proxy1,
+                                 const uint32_t proxy2) {
+    const uint32_t id1 = proxies[proxy1].user_id;
+    const uint32_t id2 = proxies[proxy2].user_id;
+    const uint64_t key = get_pair_key(id1, id2);
+
+    const uint32_t index = pair_map.get(key);
+    if (index == PAIR_MAP_NOT_FOUND) {
+        return;
+    }
+
+    // Swap with the last pair, and update its index
+    const sBroadphasePair last = pairs.pairs[pairs.count - 1];
+    pairs.pairs[index] = last;
+    pairs.count--;
+    pair_map.remove(key);
+    if (index < pairs.count) {
+        pair_map.set(get_pair_key(last.id1, last.id2), index);
+    }
+
+    add_event(id1, id2, false);
+}
+
+void sSAPBroadphase::add_event(const uint32_t id1,
+                               const uint32_t id2,
+                               const bool is_added) {
+    if (event_count == event_capacity) {
+        event_capacity = (event_capacity == 0) ? 64 : event_capacity * 2;
+        events = (sSAPPairEvent*) realloc(events, sizeof(sSAPPairEvent) * event_capacity);
+    }
+
+    events[event_count++] = sSAPPairEvent{id1, id2, is_added};
+}
+
+// =================
+//  HASH GRID
+// =================
+
+void sHashGridBroadphase::init(const uint32_t initial_capacity) {
+    body_count = 0;
+    body_capacity = 0;
+    bucket_count = 0;
+    large_body_count = 0;
+
+    grow((initial_capacity == 0) ? 16 : initial_capacity);
+
+    pairs.init(body_capacity * 2);
+}
+
+void sHashGridBroadphase::clean() {
+    free(user_ids);
+    free(aabbs);
+    free(is_static);
+    free(cells);
+    free(sorted_bodies);
+    free(bucket_start);
+    free(large_bodies);
+    user_ids = NULL;
+    aabbs = NULL;
+    is_static = NULL;
+    cells = NULL;
+    sorted_bodies = NULL;
+    bucket_start = NULL;
+    large_bodies = NULL;
+
+    pairs.clean();
+
+    body_count = 0;
+    body_capacity = 0;
+    bucket_count = 0;
+}
+
+void sHashGridBroadphase::grow(const uint32_t new_capacity) {
+    body_capacity = new_capacity;
+
+    user_ids = (uint32_t*) realloc(user_ids, sizeof(uint32_t) * body_capacity);
+    aabbs = (sAABB*) realloc(aabbs, sizeof(sAABB) * body_capacity);
+    is_static = (bool*) realloc(is_static, sizeof(bool) * body_capacity);
+    cells = (sHashGridCell*) realloc(cells, sizeof(sHashGridCell) * body_capacity);
+    sorted_bodies = (uint32_t*) realloc(sorted_bodies, sizeof(uint32_t) * body_capacity);
+    large_bodies = (uint32_t*) realloc(large_bodies, sizeof(uint32_t) * body_capacity);
+
+    // Twice as many buckets as bodies, and allways a power of 2
+    bucket_count = 16;
+    while(bucket_count < body_capacity * 2) {
+        bucket_count *= 2;
+    }
+    bucket_start = (uint32_t*) realloc(bucket_start, sizeof(uint32_t) * (bucket_count + 1));
+}
+
+void sHashGridBroadphase::add_body(const uint32_t user_id,
+                                   const sAABB &aabb,
+                                   const bool body_is_static) {
+    if (body_count == body_capacity) {
+        grow(body_capacity * 2);
+    }
+
+    user_ids[body_count] = user_id;
+    aabbs[body_count] = aabb;
+    is_static[body_count] = body_is_static;
+    body_count++;
+}
+
+void sHashGridBroadphase::build_pairs(const float grid_cell_size) {
+    cell_size = grid_cell_size;
+    const float inv_cell_size = 1.0f / cell_size;
+
+    pairs.reset();
+    large_body_count = 0;
+    memset(bucket_start, 0, sizeof(uint32_t) * (bucket_count + 1));
+
+    // 1 - Compute the cell of each body, and count the bodies per bucket
+    for(uint32_t i = 0; i < body_count; i++) {
+        const sAABB &aabb = aabbs[i];
+        const sVector3 size = aabb.max.subs(aabb.min);
+
+        // The bodies bigger than a cell go to the large list
+        if (size.x > cell_size || size.y > cell_size || size.z > cell_size) {
+            large_bodies[large_body_count++] = i;
+            cells[i] = sHashGridCell{INT32_MAX, INT32_MAX, INT32_MAX};
+            continue;
+        }
+
+        const sVector3 center = aabb.min.sum(aabb.max).mult(0.5f);
+        cells[i] = sHashGridCell{ (int32_t) floorf(center.x * inv_cell_size),
+                                  (int32_t) floorf(center.y * inv_cell_size),
+                                  (int32_t) floorf(center.z * inv_cell_size) };
+
+        bucket_start[get_bucket(cells[i]) + 1]++;
+    }
+
+    // 2 - Prefix sum of the counts
+    for(uint32_t i = 0; i < bucket_count; i++) {
+        bucket_start[i + 1] += bucket_start[i];
+    }
+
+    // 3 - Scatter the bodies on their buckets, using the start of the
+    //     next bucket as the write cursor, and then shift it back
+    for(uint32_t i = 0; i < body_count; i++) {
+        if (cells[i].x == INT32_MAX) {
+            continue;
+        }
+        sorted_bodies[bucket_start[get_bucket(cells[i])]++] = i;
+    }
+    for(uint32_t i = bucket_count; i > 0; i--) {
+        bucket_start[i] = bucket_start[i - 1];
+    }
+    bucket_start[0] = 0;
+
+    // 4 - Test each body against the bodies on the 27 neighboring cells.
+    //     Since different cells can share bucket, only the bodies of the
+    //     actual cell are tested, so no duplicated pairs are generated
+    for(uint32_t i = 0; i < body_count; i++) {
+        const sHashGridCell cell = cells[i];
+        if (cell.x == INT32_MAX) {
+            continue;
+        }
+
+        for(int32_t x = -1; x <= 1; x++) {
+            for(int32_t y = -1; y <= 1; y++) {
+                for(int32_t z = -1; z <= 1; z++) {
+                    const sHashGridCell neighbor = {cell.x + x, cell.y + y, cell.z + z};
+                    const uint32_t bucket = get_bucket(neighbor);
+
+                    for(uint32_t it = bucket_start[bucket]; it < bucket_start[bucket + 1]; it++) {
+                        const uint32_t j = sorted_bodies[it];
+
+                        if (j <= i || !cells[j].is_equal(neighbor)) {
+                            continue;
+                        }
+                        if (is_static[i] && is_static[j]) {
+                            continue;
+                        }
+                        if (aabbs[i].overlaps(aabbs[j])) {
+                            pairs.add(user_ids[i], user_ids[j]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // 5 - Test the large bodies against everything
+    for(uint32_t l = 0; l < large_body_count; l++) {
+        const uint32_t i = large_bodies[l];
+
+        for(uint32_t j = 0; j < body_count; j++) {
+            // Avoid testing twice the large vs large pairs
+            if (j == i || (cells[j].x == INT32_MAX && j < i)) {
+                continue;
+            }
+            if (is_static[i] && is_static[j]) {
+                continue;
+            }
+            if (aabbs[i].overlaps(aabbs[j])) {
+                pairs.add(user_ids[i], user_ids[j]);
+            }
+        }
+    }
+}
@@ -1,6 +1,362 @@
 #ifndef PHYS_BROADPHASE_H_
 #define PHYS_BROADPHASE_H_
 
+#include "math.h"
+#include "vector.h"
+#include "data_structs/pair_hash_map.h"
 
+#include <cstdint>
+#include <cstdlib>
+
+//**
+// Broadphase
+// Three backends:
+//  - Dynamic AABB tree, based on Erin Catto's Dynamic BVH (Box2D's b2DynamicTree)
+//    The leafs store a fattened AABB, so the small movements of a body
+//    dont need a reinsertion on the tree.
+//    The overlapping pairs are generated by querying each leaf against the tree
+//  - Incremental Sweep and prune, with persistent sorted endpoints per axis
+//    For coherent scenes (piles & stacks), where the bodies barely move
+//    between steps, and the insertion sort is almost O(N)
+//  - Uniform hash grid, rebuilt from scratch each step via counting sort
+//    For big populations of similarly sized bodies (debris, granular fill)
+// */
+
+enum eBroadphaseType : uint8_t {
+    AABB_TREE_BROADPHASE = 0,
+    SAP_BROADPHASE,
+    HASH_GRID_BROADPHASE,
+    BROADPHASE_TYPE_COUNT
+};
+
+#define AABB_TREE_NULL_NODE 0xFFFFFFFF
+#define AABB_FAT_MARGIN 0.1f
+
+struct sAABB {
+    sVector3 min = {0.0f, 0.0f, 0.0f};
+    sVector3 max = {0.0f, 0.0f, 0.0f};
+
+    inline bool overlaps(const sAABB &aabb) const {
+        if (max.x < aabb.min.x || min.x > aabb.max.x) {
+            return false;
+        }
+        if (max.y < aabb.min.y || min.y > aabb.max.y) {
+            return false;
+        }
+        if (max.z < aabb.min.z || min.z > aabb.max.z) {
+            return false;
+        }
+
+        return true;
+    }
+
+    inline bool contains(const sAABB &aabb) const {
+        return min.x <= aabb.min.x && min.y <= aabb.min.y && min.z <= aabb.min.z &&
+               max.x >= aabb.max.x && max.y >= aabb.max.y && max.z >= aabb.max.z;
+    }
+
+    inline sAABB merge(const sAABB &aabb) const {
+        return sAABB{ sVector3{MIN(min.x, aabb.min.x), MIN(min.y, aabb.min.y), MIN(min.z, aabb.min.z)},
+                      sVector3{MAX(max.x, aabb.max.x), MAX(max.y, aabb.max.y), MAX(max.z, aabb.max.z)} };
+    }
+
+    inline sAABB expand(const float margin) const {
+        return sAABB{ sVector3{min.x - margin, min.y - margin, min.z - margin},
+                      sVector3{max.x + margin, max.y + margin, max.z + margin} };
+    }
+
+    // Surface area, used as the cost of the tree (SAH)
+    inline float get_area() const {
+        const sVector3 size = max.subs(min);
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+
+struct sBroadphasePair {
+    uint32_t id1 = 0;
+    uint32_t id2 = 0;
+};
+
+// Growable list of pairs, reused between frames to avoid allocations
+struct sPairBuffer {
+    sBroadphasePair *pairs = NULL;
+    uint32_t        count = 0;
+    uint32_t        capacity = 0;
+
+    void init(const uint32_t initial_capacity) {
+        capacity = initial_capacity;
+        count = 0;
+        pairs = (sBroadphasePair*) malloc(sizeof(sBroadphasePair) * capacity);
+    }
+
+    void clean() {
+        free(pairs);
+        pairs = NULL;
+        count = 0;
+        capacity = 0;
+    }
+
+    inline void reset() {
+        count = 0;
+    }
+
+    inline void add(const uint32_t id1,
+                    const uint32_t id2) {
+        if (count == capacity) {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            pairs = (sBroadphasePair*) realloc(pairs, sizeof(sBroadphasePair) * capacity);
+        }
+
+        // Store the pairs ordered, for the contact's ids
+        if (id1 < id2) {
+            pairs[count++] = {id1, id2};
+        } else {
+            pairs[count++] = {id2, id1};
+        }
+    }
+};
+
+struct sAABBTreeNode {
+    sAABB     aabb = {};
+
+    // The parent index is reused as the next free node on the free list
+    uint32_t  parent = AABB_TREE_NULL_NODE;
+    uint32_t  child1 = AABB_TREE_NULL_NODE;
+    uint32_t  child2 = AABB_TREE_NULL_NODE;
+
+    // Leaf = 0, free node = -1
+    int32_t   height = -1;
+
+    uint32_t  user_id = 0;
+
+    inline bool is_leaf() const {
+        return child1 == AABB_TREE_NULL_NODE;
+    }
+};
+
+struct sAABBTree {
+    sAABBTreeNode  *nodes = NULL;
+    uint32_t       node_capacity = 0;
+    uint32_t       node_count = 0;
+
+    uint32_t       root = AABB_TREE_NULL_NODE;
+    uint32_t       free_list = AABB_TREE_NULL_NODE;
+
+    // Stack for the tree traversal on the queries
+    uint32_t       *query_stack = NULL;
+    uint32_t       query_stack_capacity = 0;
+
+    // Lifecycle functions
+    void init(const uint32_t initial_capacity);
+    void clean();
+
+    // Proxy functions, the proxy id is the index of the leaf node
+    uint32_t create_proxy(const sAABB &aabb,
+                          const uint32_t user_id);
+    void destroy_proxy(const uint32_t proxy_id);
+
+    // Returns true if the proxy has been reinserted (it left its fat AABB)
+    bool move_proxy(const uint32_t proxy_id,
+                    const sAABB &aabb);
+
+    inline uint32_t get_user_id(const uint32_t proxy_id) const {
+        return nodes[proxy_id].user_id;
+    }
+
+    inline const sAABB& get_fat_AABB(const uint32_t proxy_id) const {
+        return nodes[proxy_id].aabb;
+    }
+
+    // Pair generation
+    // Generate all the pairs of overlapping leaves inside the tree
+    void get_overlapping_pairs(sPairBuffer *pair_buffer);
+    // Generate all the pairs of overlapping leaves between this tree and other
+    void get_overlapping_pairs(const sAABBTree &tree,
+                               sPairBuffer *pair_buffer);
+    // Stores the user ids of the leaves that overlap the AABB, the buffer
+    // needs room for all the leaves. Returns the number of leaves found
+    uint32_t query(const sAABB &aabb,
+                   uint32_t *user_ids);
+
+    // Internal tree functions
+    uint32_t allocate_node();
+    void free_node(const uint32_t node_id);
+    void insert_leaf(const uint32_t leaf);
+    void remove_leaf(const uint32_t leaf);
+    uint32_t balance(const uint32_t node_id);
+    void push_to_query_stack(const uint32_t node_id,
+                             uint32_t *stack_size);
+};
+
+// =================
+//  SWEEP AND PRUNE
+// =================
+
+#define SAP_NULL_PROXY 0xFFFFFFFF
+
+struct sSAPEndpoint {
+    float     value = 0.0f;
+    // Proxy id on the upper bits, and is_max on the first bit
+    uint32_t  data = 0;
+
+    inline uint32_t get_proxy() const {
+        return data >> 1;
+    }
+
+    inline bool is_max() const {
+        return data & 1;
+    }
+};
+
+struct sSAPProxy {
+    // Indices of the endpoints on each axis array
+    uint32_t  min_endpoint[3] = {};
+    uint32_t  max_endpoint[3] = {};
+
+    uint32_t  user_id = 0;
+    bool      is_static = false;
+    // Doubles as the next free proxy on the free list
+    uint32_t  next_free = SAP_NULL_PROXY;
+};
+
+struct sSAPPairEvent {
+    uint32_t  id1 = 0;
+    uint32_t  id2 = 0;
+    bool      is_added = false;
+};
+
+struct sSAPBroadphase {
+    sSAPEndpoint  *endpoints[3] = {NULL, NULL, NULL};
+    uint32_t      endpoint_count = 0;
+
+    sSAPProxy     *proxies = NULL;
+    uint32_t      proxy_capacity = 0;
+    uint32_t      proxy_free_list = SAP_NULL_PROXY;
+
+    // Persistent overlapping pairs (of user ids), and their
+    // index on the pair list
+    sPairBuffer   pairs = {};
+    sPairHashMap  pair_map = {};
+
+    // Changes on the pairs, since the last clean_events
+    sSAPPairEvent *events = NULL;
+    uint32_t      event_count = 0;
+    uint32_t      event_capacity = 0;
+
+    // Lifecycle functions
+    void init(const uint32_t initial_capacity);
+    void clean();
+
+    // Proxy functions
+    uint32_t create_proxy(const sAABB &aabb,
+                          const uint32_t user_id,
+                          const bool is_static);
+    void destroy_proxy(const uint32_t proxy_id);
+    void move_proxy(const uint32_t proxy_id,
+                    const sAABB &aabb);
+
+    inline void clean_events() {
+        event_count = 0;
+    }
+
+    // Internal functions
+    inline bool overlaps_on_axis(const uint32_t proxy1,
+                                 const uint32_t proxy2,
+                                 const int axis) const {
+        return proxies[proxy1].min_endpoint[axis] < proxies[proxy2].max_endpoint[axis] &&
+               proxies[proxy2].min_endpoint[axis] < proxies[proxy1].max_endpoint[axis];
+    }
+
+    inline bool overlaps_on_other_axis(const uint32_t proxy1,
+                                       const uint32_t proxy2,
+                                       const int axis) const {
+        const int axis1 = (axis + 1) % 3;
+        const int axis2 = (axis + 2) % 3;
+        return overlaps_on_axis(proxy1, proxy2, axis1) && overlaps_on_axis(proxy1, proxy2, axis2);
+    }
+
+    void sort_min_down(const int axis, uint32_t endpoint);
+    void sort_min_up(const int axis, uint32_t endpoint);
+    void sort_max_down(const int axis, uint32_t endpoint);
+    void sort_max_up(const int axis, uint32_t endpoint);
+    void swap_endpoints(const int axis,
+                        const uint32_t endpoint1,
+                        const uint32_t endpoint2);
+
+    void add_pair(const uint32_t proxy1,
+                  const uint32_t proxy2);
+    void remove_pair(const uint32_t proxy1,
+                     const uint32_t proxy2);
+    void add_event(const uint32_t id1,
+                   const uint32_t id2,
+                   const bool is_added);
+};
+
+// =================
+//  HASH GRID
+// =================
+
+struct sHashGridCell {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t z = 0;
+
+    inline bool is_equal(const sHashGridCell &cell) const {
+        return x == cell.x && y == cell.y && z == cell.z;
+    }
+
+    inline uint32_t get_hash() const {
+        return ((uint32_t) x * 73856093u) ^ ((uint32_t) y * 19349663u) ^ ((uint32_t) z * 83492791u);
+    }
+};
+
+// The bodies are stored on the cell of its center, so with a cell size
+// bigger or equal than the biggest diameter, the overlapping bodies are
+// allways on the neighboring 27 cells.
+// The bodies that dont fit on a cell (like the ground) are stored on a
+// separate list, and tested against everything
+struct sHashGridBroadphase {
+    // Body data, filled each step
+    uint32_t       *user_ids = NULL;
+    sAABB          *aabbs = NULL;
+    bool           *is_static = NULL;
+    sHashGridCell  *cells = NULL;
+    uint32_t       body_count = 0;
+    uint32_t       body_capacity = 0;
+
+    // Bodies sorted by bucket, and the start of each bucket
+    // (counting sort)
+    uint32_t       *sorted_bodies = NULL;
+    uint32_t       *bucket_start = NULL;
+    uint32_t       bucket_count = 0;
+
+    uint32_t       *large_bodies = NULL;
+    uint32_t       large_body_count = 0;
+
+    float          cell_size = 1.0f;
+
+    sPairBuffer    pairs = {};
+
+    // Lifecycle functions
+    void init(const uint32_t initial_capacity);
+    void clean();
+
+    inline void reset() {
+        body_count = 0;
+    }
+
+    void add_body(const uint32_t user_id,
+                  const sAABB &aabb,
+                  const bool body_is_static);
+
+    // Sort the bodies on the grid and generate the overlapping pairs
+    void build_pairs(const float grid_cell_size);
+
+    // Internal functions
+    void grow(const uint32_t new_capacity);
+    inline uint32_t get_bucket(const sHashGridCell &cell) const {
+        return cell.get_hash() & (bucket_count - 1);
+    }
+};
 
 #endif // PHYS_BROADPHASE_H_
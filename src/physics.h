@@ -5,20 +5,37 @@
 #include "math.h"
 #include "collision_detection.h"
 #include "math.h"
+#include "capsule_collision.h"
 #include "collider_mesh.h"
+#include "compound.h"
+#include "gjk.h"
+#include "heightfield.h"
 #include "mesh_renderer.h"
+#include "obb_collision.h"
 #include "phys_parameters.h"
 #include "quaternion.h"
 #include "sat.h"
 #include "transform.h"
+#include "triangle_collision.h"
+#include "triangle_mesh.h"
 #include "types.h"
 #include "vector.h"
 #include "contact_manager.h"
+#include "phys_broadphase.h"
+#include "shape_library.h"
+#include "data_structs/handle_pool.h"
 
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 
-#define PHYS_INSTANCE_COUNT 100
+// Initial body capacity, the storage grows on demand
+// up to HANDLE_MAX_COUNT bodies
+#define PHYS_INITIAL_INSTANCE_COUNT 100
 
+// A bucket per (ordered) pair of shapes
+#define NARROWPHASE_BUCKET_COUNT (COLLIDER_COUNT * COLLIDER_COUNT)
+#define NARROWPHASE_NO_BUCKET 0xFFu
 
 // TODO:
 //  Instead on reinitializing the mesh if its different,
@@ -36,33 +53,93 @@ enum eParentType : uint8_t {
     PARENT_TYPE_COUNT
 };
 
+// COLLIDER_PARENT: the body is a child of the compound on the parent's
+// slot, and it is placed by the local transform
 struct sParenting {
     eParentType  parent_type = NO_PARENT;
     uint32_t parent_index_index = 0;
+    sTransform   local_transform = {};
 };
 
-
+struct sPhysWorld;
+
+// Narrowphase kernel of a pair of shapes: tests the bodies a and b,
+// with the normal of the result from a to b
+typedef bool (sPhysWorld::*tNarrowphaseKernel)(const uint32_t a,
+                                               const uint32_t b,
+                                               sPairCache *pair_cache,
+                                               sNarrowphaseResult *result);
+typedef void (sPhysWorld::*tPairTest)(const uint32_t i,
+                                      const uint32_t j);
+typedef void (sPhysWorld::*tPairBucketTest)(const sBroadphasePair *bucket_pairs,
+                                            const uint32_t pair_count);
+
+
+// The bodies are adressed via generational handles. The handle index is
+// a stable slot, that maps to the body's position on the per-body arrays.
+// The per-body arrays are kept dense (the removed bodies are swapped with
+// the last one), so the step loops go over [0, body_count) without holes.
+// The internal ids (manifolds, broadphase) are the slots, since they do
+// not change when the arrays are compacted.
 struct sPhysWorld {
-    bool               initialized         [PHYS_INSTANCE_COUNT] = {};
+    // Body slots & the mapping between slots and dense indices
+    sHandlePool        body_handles = {};
+    uint32_t           *dense_to_slot = NULL;
+    uint32_t           *slot_to_dense = NULL;
+    uint32_t           body_count = 0;
+    uint32_t           body_capacity = 0;
 
     // Collider pareting & state
-    sParenting         node_parenting      [PHYS_INSTANCE_COUNT] = {};
-    bool               enabled             [PHYS_INSTANCE_COUNT] = {};
-    bool               is_static           [PHYS_INSTANCE_COUNT] = {};
-    eColiderTypes      shape               [PHYS_INSTANCE_COUNT] = {};
+    sParenting         *node_parenting = NULL;
+    bool               *enabled = NULL;
+    bool               *is_static = NULL;
+    eColiderTypes      *shape = NULL;
 
     // Collider data
-    sColliderMesh      collider_meshes     [PHYS_INSTANCE_COUNT] = {};
-    sTransform         transforms          [PHYS_INSTANCE_COUNT] = {};
-    sTransform         old_transforms      [PHYS_INSTANCE_COUNT] = {};
-    sSpeed             obj_speeds          [PHYS_INSTANCE_COUNT];
+    // The hulls are shared by all the bodies with the same shape, and each
+    // body only stores its shape and the instance of its world space data
+    sShapeLibrary      shape_library = {};
+    uint32_t           cube_shape = SHAPE_LIBRARY_NULL;
+    uint32_t           *collider_shape = NULL;
+    uint32_t           *collider_instance = NULL;
+    sTransform         *transforms = NULL;
+    sTransform         *old_transforms = NULL;
+    sSpeed             *obj_speeds = NULL;
+    // Upper bound of how much any point of the body moved on the last step
+    float              *motion_bound = NULL;
 
     // Physics properties
-    float              mass                [PHYS_INSTANCE_COUNT] = {};
-    float              inv_mass            [PHYS_INSTANCE_COUNT] = {};
-    float              restitution         [PHYS_INSTANCE_COUNT] = {};
-    float              friction            [PHYS_INSTANCE_COUNT] = {};
-    sMat33             inv_inertia_tensors [PHYS_INSTANCE_COUNT] = {};
+    float              *mass = NULL;
+    float              *inv_mass = NULL;
+    float              *restitution = NULL;
+    float              *friction = NULL;
+    sMat33             *inv_inertia_tensors = NULL;
+    // On the body's local space; the world space tensors are rotated from it
+    sMat33             *inv_local_inertia_tensors = NULL;
+
+    // Broadphase
+    eBroadphaseType    broadphase_type = AABB_TREE_BROADPHASE;
+    uint32_t           *broadphase_proxy = NULL;
+    // AABB tree: static bodies are stored on their own tree,
+    // since they are never moved
+    sAABBTree          dynamic_tree = {};
+    sAABBTree          static_tree = {};
+    sPairBuffer        broadphase_pairs = {};
+    // Sweep and prune: keeps its own persistent pair list
+    sSAPBroadphase     sap_broadphase = {};
+    // Hash grid: rebuilt from scratch each step
+    sHashGridBroadphase hash_grid = {};
+
+    // Narrowphase
+    // Dispatch table, by the shapes of the pair. The tests of the swapped
+    // pairs call the kernel in order, and flip its normal
+    tPairTest          pair_tests[COLLIDER_COUNT][COLLIDER_COUNT] = {};
+    tPairBucketTest    pair_bucket_tests[COLLIDER_COUNT][COLLIDER_COUNT] = {};
+    // The broadphase pairs, sorted by their bucket
+    sBroadphasePair    *narrowphase_pairs = NULL;
+    uint8_t            *narrowphase_pair_buckets = NULL;
+    uint32_t           narrowphase_pair_capacity = 0;
+    uint32_t           bucket_start[NARROWPHASE_BUCKET_COUNT + 1] = {};
 
     // Collision & contact data
     sCollisionManager  coll_manager = {};
@@ -70,7 +147,21 @@ struct sPhysWorld {
 
     // Collider's Custom information
     // PLANE
-    sVector3           plane_collider_normal [PHYS_INSTANCE_COUNT] = {};
+    sVector3           *plane_collider_normal = NULL;
+    // The planes are infinite, so they are kept out of the broadphase,
+    // and tested against all the dynamic bodies
+    uint32_t           *plane_slots = NULL;
+    uint32_t           plane_count = 0;
+    // TRIANGLE MESH
+    sTriangleMesh      *triangle_mesh_collider = NULL;
+    // HEIGHTFIELD
+    sHeightfield       *heightfield_collider = NULL;
+    // COMPOUND
+    sCompound          *compound_collider = NULL;
+    // Scratch for the rebuild of the compounds' trees
+    sAABB              *compound_child_aabbs = NULL;
+    uint32_t           *compound_child_slots = NULL;
+    uint32_t           compound_child_capacity = 0;
     //
 
     // DEBUG ==============
@@ -81,33 +172,546 @@ struct sPhysWorld {
         return MAX(transforms[id].scale.x, MAX(transforms[id].scale.y, transforms[id].scale.z));
     };
 
+    // The capsules are the segment along their local Y axis, of half height
+    // scale.y, inflated by the radius scale.x
+    inline void get_capsule_segment(const int id,
+                                    sVector3 *start,
+                                    sVector3 *end) const {
+        const sVector3 half_segment = transforms[id].apply_rotation({0.0f, transforms[id].scale.y, 0.0f});
+        *start = transforms[id].position.subs(half_segment);
+        *end = transforms[id].position.sum(half_segment);
+    }
+
+    // Radius of the sphere arround the body's position that contains it
+    inline float get_bounding_radius(const int id) const {
+        if (collider_shape[id] != SHAPE_LIBRARY_NULL) {
+            const sConvexShape &convex_shape = shape_library.get_shape(collider_shape[id]);
+            const sVector3 &scale = transforms[id].scale;
+            const sVector3 farthest_corner = {scale.x * MAX(fabsf(convex_shape.local_min.x), fabsf(convex_shape.local_max.x)),
+                                              scale.y * MAX(fabsf(convex_shape.local_min.y), fabsf(convex_shape.local_max.y)),
+                                              scale.z * MAX(fabsf(convex_shape.local_min.z), fabsf(convex_shape.local_max.z))};
+            return farthest_corner.magnitude();
+        }
+
+        if (shape[id] == CAPSULE_COLLIDER) {
+            return transforms[id].scale.x + transforms[id].scale.y;
+        }
+
+        if (shape[id] == COMPOUND_COLLIDER) {
+            return compound_collider[id].bounding_radius;
+        }
+
+        return get_radius_of_collider(id);
+    }
+
+    // AABB of the local bounds, moved by the transform
+    inline sAABB get_world_AABB(const sTransform &transf,
+                                const sAABB &local_bounds) const {
+        // The extent of the OBB of the local bounds on each world axis
+        // is the sum of the projections of its rotated half sizes
+        const sVector3 local_center = local_bounds.min.sum(local_bounds.max).mult(0.5f);
+        const sVector3 local_half_size = local_bounds.max.subs(local_bounds.min).mult(0.5f);
+
+        const sVector3 half_size = {transf.scale.x * local_half_size.x,
+                                    transf.scale.y * local_half_size.y,
+                                    transf.scale.z * local_half_size.z};
+        const sVector3 axis_x = transf.apply_rotation({half_size.x, 0.0f, 0.0f});
+        const sVector3 axis_y = transf.apply_rotation({0.0f, half_size.y, 0.0f});
+        const sVector3 axis_z = transf.apply_rotation({0.0f, 0.0f, half_size.z});
+
+        const sVector3 extent = {fabsf(axis_x.x) + fabsf(axis_y.x) + fabsf(axis_z.x),
+                                 fabsf(axis_x.y) + fabsf(axis_y.y) + fabsf(axis_z.y),
+                                 fabsf(axis_x.z) + fabsf(axis_y.z) + fabsf(axis_z.z)};
+        const sVector3 center = transf.apply(local_center);
+
+        return sAABB{center.subs(extent), center.sum(extent)};
+    }
+
+    // AABB of the world bounds, on the local space of the transform
+    // (without scale)
+    inline sAABB get_local_AABB(const sTransform &transf,
+                                const sAABB &world_bounds) const {
+        const sVector3 half_size = world_bounds.max.subs(world_bounds.min).mult(0.5f);
+        const sVector3 axis_x = transf.apply_inverse_rotation({half_size.x, 0.0f, 0.0f});
+        const sVector3 axis_y = transf.apply_inverse_rotation({0.0f, half_size.y, 0.0f});
+        const sVector3 axis_z = transf.apply_inverse_rotation({0.0f, 0.0f, half_size.z});
+
+        const sVector3 extent = {fabsf(axis_x.x) + fabsf(axis_y.x) + fabsf(axis_z.x),
+                                 fabsf(axis_x.y) + fabsf(axis_y.y) + fabsf(axis_z.y),
+                                 fabsf(axis_x.z) + fabsf(axis_y.z) + fabsf(axis_z.z)};
+        const sVector3 world_center = world_bounds.min.sum(world_bounds.max).mult(0.5f);
+        const sVector3 center = transf.apply_inverse_rotation(world_center.subs(transf.position));
+
+        return sAABB{center.subs(extent), center.sum(extent)};
+    }
+
+    inline sAABB get_AABB_of_collider(const int id) const {
+        return get_AABB_of_collider(id, transforms[id]);
+    }
+
+    // With the body placed on the transform
+    inline sAABB get_AABB_of_collider(const int id,
+                                      const sTransform &transf) const {
+        if (collider_shape[id] != SHAPE_LIBRARY_NULL) {
+            const sConvexShape &convex_shape = shape_library.get_shape(collider_shape[id]);
+            return get_world_AABB(transf, sAABB{convex_shape.local_min, convex_shape.local_max});
+        }
+
+        if (shape[id] == COMPOUND_COLLIDER) {
+            return get_world_AABB(transf, compound_collider[id].local_aabb);
+        }
+
+        if (shape[id] == TRIANGLE_MESH_COLLIDER) {
+            return triangle_mesh_collider[id].aabb;
+        }
+
+        if (shape[id] == HEIGHTFIELD_COLLIDER) {
+            return heightfield_collider[id].aabb;
+        }
+
+        if (shape[id] == CAPSULE_COLLIDER) {
+            const float radius = transf.scale.x;
+            const sVector3 half_segment = transf.apply_rotation({0.0f, transf.scale.y, 0.0f});
+            const sVector3 extent = {fabsf(half_segment.x) + radius,
+                                     fabsf(half_segment.y) + radius,
+                                     fabsf(half_segment.z) + radius};
+
+            return sAABB{transf.position.subs(extent), transf.position.sum(extent)};
+        }
+
+        const float radius = get_radius_of_collider(id);
+        const sVector3 extent = {radius, radius, radius};
+
+        return sAABB{transf.position.subs(extent), transf.position.sum(extent)};
+    }
+
     // Lifecicle functions
-    void init() {
-        memset(enabled, false, sizeof(sPhysWorld::enabled));
-        memset(initialized, false, sizeof(sPhysWorld::initialized));
+    void init(const eBroadphaseType broadphase = AABB_TREE_BROADPHASE,
+              const uint32_t initial_capacity = PHYS_INITIAL_INSTANCE_COUNT) {
+        body_capacity = 0;
+        body_count = 0;
+        plane_count = 0;
+        body_handles.init(initial_capacity);
+        grow_storage(body_handles.capacity);
 
         coll_manager.init();
         set_default_values();
+        init_narrowphase_kernels();
+
+        // The world holds the first reference of the built-in shapes
+        sColliderMesh cube_local_hull = {};
+        cube_local_hull.init_cuboid(sTransform{});
+        shape_library.init(4);
+        cube_shape = shape_library.add_shape(cube_local_hull);
+
+        broadphase_type = broadphase;
+        switch(broadphase_type) {
+            case SAP_BROADPHASE:
+                sap_broadphase.init(body_capacity);
+                break;
+            case HASH_GRID_BROADPHASE:
+                hash_grid.init(body_capacity);
+                break;
+            default:
+                dynamic_tree.init(body_capacity * 2);
+                static_tree.init(body_capacity);
+                broadphase_pairs.init(body_capacity * 4);
+                break;
+        }
     }
 
     void clean() {
-        uint32_t index = 0;
-        for(; index < PHYS_INSTANCE_COUNT; index++ ) {
-            if (initialized[index] && shape[index] == CUBE_COLLIDER) {
-                collider_meshes[index].clean();
+        for(uint32_t i = 0; i < body_count; i++) {
+            if (shape[i] == TRIANGLE_MESH_COLLIDER) {
+                triangle_mesh_collider[i].clean();
+            } else if (shape[i] == HEIGHTFIELD_COLLIDER) {
+                heightfield_collider[i].clean();
+            } else if (shape[i] == COMPOUND_COLLIDER) {
+                compound_collider[i].clean();
+            }
+        }
+
+        free(dense_to_slot);
+        free(slot_to_dense);
+        free(node_parenting);
+        free(enabled);
+        free(is_static);
+        free(shape);
+        free(collider_shape);
+        free(collider_instance);
+        free(transforms);
+        free(old_transforms);
+        free(obj_speeds);
+        free(motion_bound);
+        free(mass);
+        free(inv_mass);
+        free(restitution);
+        free(friction);
+        free(inv_inertia_tensors);
+        free(inv_local_inertia_tensors);
+        free(broadphase_proxy);
+        free(plane_collider_normal);
+        free(plane_slots);
+        free(triangle_mesh_collider);
+        free(heightfield_collider);
+        free(compound_collider);
+        free(compound_child_aabbs);
+        free(compound_child_slots);
+        dense_to_slot = NULL;
+        slot_to_dense = NULL;
+        node_parenting = NULL;
+        enabled = NULL;
+        is_static = NULL;
+        shape = NULL;
+        collider_shape = NULL;
+        collider_instance = NULL;
+        transforms = NULL;
+        old_transforms = NULL;
+        obj_speeds = NULL;
+        motion_bound = NULL;
+        mass = NULL;
+        inv_mass = NULL;
+        restitution = NULL;
+        friction = NULL;
+        inv_inertia_tensors = NULL;
+        inv_local_inertia_tensors = NULL;
+        broadphase_proxy = NULL;
+        plane_collider_normal = NULL;
+        plane_slots = NULL;
+        triangle_mesh_collider = NULL;
+        heightfield_collider = NULL;
+        compound_collider = NULL;
+        compound_child_aabbs = NULL;
+        compound_child_slots = NULL;
+        compound_child_capacity = 0;
+        body_count = 0;
+        body_capacity = 0;
+
+        body_handles.clean();
+        coll_manager.clean();
+        shape_library.clean();
+
+        switch(broadphase_type) {
+            case SAP_BROADPHASE:
+                sap_broadphase.clean();
+                break;
+            case HASH_GRID_BROADPHASE:
+                hash_grid.clean();
+                break;
+            default:
+                dynamic_tree.clean();
+                static_tree.clean();
+                broadphase_pairs.clean();
+                break;
+        }
+
+        free(narrowphase_pairs);
+        free(narrowphase_pair_buckets);
+        narrowphase_pairs = NULL;
+        narrowphase_pair_buckets = NULL;
+        narrowphase_pair_capacity = 0;
+    }
+
+    // Realloc all the per-body arrays, the new slots are zeroed
+    void grow_storage(const uint32_t new_capacity) {
+        const uint32_t old_capacity = body_capacity;
+        body_capacity = new_capacity;
+
+        dense_to_slot = (uint32_t*) realloc(dense_to_slot, sizeof(uint32_t) * body_capacity);
+        slot_to_dense = (uint32_t*) realloc(slot_to_dense, sizeof(uint32_t) * body_capacity);
+        node_parenting = (sParenting*) realloc(node_parenting, sizeof(sParenting) * body_capacity);
+        enabled = (bool*) realloc(enabled, sizeof(bool) * body_capacity);
+        is_static = (bool*) realloc(is_static, sizeof(bool) * body_capacity);
+        shape = (eColiderTypes*) realloc(shape, sizeof(eColiderTypes) * body_capacity);
+        collider_shape = (uint32_t*) realloc(collider_shape, sizeof(uint32_t) * body_capacity);
+        collider_instance = (uint32_t*) realloc(collider_instance, sizeof(uint32_t) * body_capacity);
+        transforms = (sTransform*) realloc(transforms, sizeof(sTransform) * body_capacity);
+        old_transforms = (sTransform*) realloc(old_transforms, sizeof(sTransform) * body_capacity);
+        obj_speeds = (sSpeed*) realloc(obj_speeds, sizeof(sSpeed) * body_capacity);
+        motion_bound = (float*) realloc(motion_bound, sizeof(float) * body_capacity);
+        mass = (float*) realloc(mass, sizeof(float) * body_capacity);
+        inv_mass = (float*) realloc(inv_mass, sizeof(float) * body_capacity);
+        restitution = (float*) realloc(restitution, sizeof(float) * body_capacity);
+        friction = (float*) realloc(friction, sizeof(float) * body_capacity);
+        inv_inertia_tensors = (sMat33*) realloc(inv_inertia_tensors, sizeof(sMat33) * body_capacity);
+        inv_local_inertia_tensors = (sMat33*) realloc(inv_local_inertia_tensors, sizeof(sMat33) * body_capacity);
+        broadphase_proxy = (uint32_t*) realloc(broadphase_proxy, sizeof(uint32_t) * body_capacity);
+        plane_collider_normal = (sVector3*) realloc(plane_collider_normal, sizeof(sVector3) * body_capacity);
+        plane_slots = (uint32_t*) realloc(plane_slots, sizeof(uint32_t) * body_capacity);
+        triangle_mesh_collider = (sTriangleMesh*) realloc(triangle_mesh_collider, sizeof(sTriangleMesh) * body_capacity);
+        heightfield_collider = (sHeightfield*) realloc(heightfield_collider, sizeof(sHeightfield) * body_capacity);
+        compound_collider = (sCompound*) realloc(compound_collider, sizeof(sCompound) * body_capacity);
+
+        const uint32_t new_slots = body_capacity - old_capacity;
+        memset(&node_parenting[old_capacity], 0, sizeof(sParenting) * new_slots);
+        memset(&enabled[old_capacity], false, sizeof(bool) * new_slots);
+        memset(&is_static[old_capacity], false, sizeof(bool) * new_slots);
+        memset(&shape[old_capacity], 0, sizeof(eColiderTypes) * new_slots);
+        memset(&collider_shape[old_capacity], 0xFF, sizeof(uint32_t) * new_slots);
+        memset(&obj_speeds[old_capacity], 0, sizeof(sSpeed) * new_slots);
+        memset(&motion_bound[old_capacity], 0, sizeof(float) * new_slots);
+        memset(&friction[old_capacity], 0, sizeof(float) * new_slots);
+        memset(&plane_collider_normal[old_capacity], 0, sizeof(sVector3) * new_slots);
+        memset(&triangle_mesh_collider[old_capacity], 0, sizeof(sTriangleMesh) * new_slots);
+        memset(&heightfield_collider[old_capacity], 0, sizeof(sHeightfield) * new_slots);
+        memset(&compound_collider[old_capacity], 0, sizeof(sCompound) * new_slots);
+        for(uint32_t i = old_capacity; i < body_capacity; i++) {
+            transforms[i] = {};
+            old_transforms[i] = {};
+        }
+
+        if (body_handles.capacity < body_capacity) {
+            body_handles.grow(body_capacity);
+        }
+    }
+
+    // Returns the handle of a new body slot, growing the storage if needed
+    // or INVALID_HANDLE if the world is full
+    inline uint32_t allocate_body() {
+        if (body_handles.is_full()) {
+            if (body_capacity >= HANDLE_MAX_COUNT) {
+                return INVALID_HANDLE;
+            }
+            grow_storage(MIN(body_capacity * 2, HANDLE_MAX_COUNT));
+        }
+
+        const uint32_t handle = body_handles.allocate();
+        const uint32_t slot = get_handle_index(handle);
+
+        slot_to_dense[slot] = body_count;
+        node_parenting[body_count] = {};
+        dense_to_slot[body_count++] = slot;
+
+        return handle;
+    }
+
+    inline bool is_valid(const uint32_t handle) const {
+        return body_handles.is_valid(handle);
+    }
+
+    // Index of the body on the per-body arrays
+    // Note: only valid until the next remove_body
+    inline uint32_t get_body_index(const uint32_t handle) const {
+        return slot_to_dense[get_handle_index(handle)];
+    }
+
+    // Remove the body, and move the last body to its place on the arrays
+    // Returns false if the handle is no longer valid
+    bool remove_body(const uint32_t handle) {
+        if (!body_handles.is_valid(handle)) {
+            return false;
+        }
+
+        const uint32_t slot = get_handle_index(handle);
+
+        // The children are removed with their compound. They are taken
+        // out of it first, so it is not updated for each one
+        while(shape[slot_to_dense[slot]] == COMPOUND_COLLIDER && compound_collider[slot_to_dense[slot]].child_count > 0) {
+            sCompound &compound = compound_collider[slot_to_dense[slot]];
+            remove_body(compound.child_handles[--compound.child_count]);
+        }
+
+        const uint32_t index = slot_to_dense[slot];
+
+        if (node_parenting[index].parent_type == COLLIDER_PARENT) {
+            const uint32_t compound = slot_to_dense[node_parenting[index].parent_index_index];
+            if (compound_collider[compound].remove_child(handle)) {
+                update_compound(compound);
+            }
+        }
+
+        coll_manager.release_object_collisions(slot);
+        remove_from_broadphase(index);
+
+        if (shape[index] == TRIANGLE_MESH_COLLIDER) {
+            triangle_mesh_collider[index].clean();
+        } else if (shape[index] == HEIGHTFIELD_COLLIDER) {
+            heightfield_collider[index].clean();
+        } else if (shape[index] == COMPOUND_COLLIDER) {
+            compound_collider[index].clean();
+        }
+
+        if (shape[index] == PLANE_COLLIDER) {
+            for(uint32_t i = 0; i < plane_count; i++) {
+                if (plane_slots[i] == slot) {
+                    plane_slots[i] = plane_slots[--plane_count];
+                    break;
+                }
+            }
+        }
+
+        if (collider_shape[index] != SHAPE_LIBRARY_NULL) {
+            shape_library.destroy_instance(collider_shape[index], collider_instance[index]);
+        }
+
+        // Swap with the last body
+        const uint32_t last = body_count - 1;
+        if (index != last) {
+            node_parenting[index] = node_parenting[last];
+            enabled[index] = enabled[last];
+            is_static[index] = is_static[last];
+            shape[index] = shape[last];
+            collider_shape[index] = collider_shape[last];
+            collider_instance[index] = collider_instance[last];
+            transforms[index] = transforms[last];
+            old_transforms[index] = old_transforms[last];
+            obj_speeds[index] = obj_speeds[last];
+            motion_bound[index] = motion_bound[last];
+            mass[index] = mass[last];
+            inv_mass[index] = inv_mass[last];
+            restitution[index] = restitution[last];
+            friction[index] = friction[last];
+            inv_inertia_tensors[index] = inv_inertia_tensors[last];
+            inv_local_inertia_tensors[index] = inv_local_inertia_tensors[last];
+            broadphase_proxy[index] = broadphase_proxy[last];
+            plane_collider_normal[index] = plane_collider_normal[last];
+            triangle_mesh_collider[index] = triangle_mesh_collider[last];
+            heightfield_collider[index] = heightfield_collider[last];
+            compound_collider[index] = compound_collider[last];
+
+            dense_to_slot[index] = dense_to_slot[last];
+            slot_to_dense[dense_to_slot[index]] = index;
+        }
+        collider_shape[last] = SHAPE_LIBRARY_NULL;
+        body_count--;
+
+        body_handles.release(handle);
+
+        return true;
+    }
+
+    // The planes, and the children of the compounds, are tested via other
+    // bodies, so they are kept out of the broadphase
+    inline bool is_on_broadphase(const uint32_t index) const {
+        return shape[index] != PLANE_COLLIDER && node_parenting[index].parent_type != COLLIDER_PARENT;
+    }
+
+    inline void add_to_broadphase(const uint32_t index) {
+        // The hash grid does not need proxies
+        if (broadphase_type == HASH_GRID_BROADPHASE || !is_on_broadphase(index)) {
+            return;
+        }
+
+        const sAABB aabb = get_AABB_of_collider(index);
+        const uint32_t slot = dense_to_slot[index];
+
+        if (broadphase_type == SAP_BROADPHASE) {
+            broadphase_proxy[index] = sap_broadphase.create_proxy(aabb, slot, is_static[index]);
+        } else if (is_static[index]) {
+            broadphase_proxy[index] = static_tree.create_proxy(aabb, slot);
+        } else {
+            broadphase_proxy[index] = dynamic_tree.create_proxy(aabb, slot);
+        }
+    }
+
+    inline void remove_from_broadphase(const uint32_t index) {
+        if (broadphase_type == HASH_GRID_BROADPHASE || !is_on_broadphase(index)) {
+            return;
+        }
+
+        if (broadphase_type == SAP_BROADPHASE) {
+            sap_broadphase.destroy_proxy(broadphase_proxy[index]);
+            // Flush the events now, before the slot can be reused
+            process_broadphase_events();
+        } else if (is_static[index]) {
+            static_tree.destroy_proxy(broadphase_proxy[index]);
+        } else {
+            dynamic_tree.destroy_proxy(broadphase_proxy[index]);
+        }
+    }
+
+    // Drop the cached contacts of the pairs that stopped overlapping
+    // on the sweep and prune
+    inline void process_broadphase_events() {
+        for(uint32_t i = 0; i < sap_broadphase.event_count; i++) {
+            const sSAPPairEvent &event = sap_broadphase.events[i];
+            if (!event.is_added) {
+                coll_manager.release_collision(event.id1, event.id2);
             }
         }
+        sap_broadphase.clean_events();
+    }
+
+    // Update the AABBs of the dynamic bodies, and return the list of the
+    // potentially colliding pairs: dynamic vs dynamic & dynamic vs static
+    const sPairBuffer* update_broadphase() {
+        if (broadphase_type == SAP_BROADPHASE) {
+            process_broadphase_events();
+
+            for(uint32_t i = 0; i < body_count; i++) {
+                if (is_static[i] || !is_on_broadphase(i)) {
+                    continue;
+                }
+
+                sap_broadphase.move_proxy(broadphase_proxy[i], get_AABB_of_collider(i));
+            }
+
+            return &sap_broadphase.pairs;
+        }
+
+        if (broadphase_type == HASH_GRID_BROADPHASE) {
+            // The cell size is the diameter of the biggest dynamic sphere,
+            // so the rest of the bodies use the large body list
+            float max_radius = 0.0f;
+            for(uint32_t i = 0; i < body_count; i++) {
+                if (is_static[i] || shape[i] != SPHERE_COLLIDER || !is_on_broadphase(i)) {
+                    continue;
+                }
+                max_radius = MAX(max_radius, get_radius_of_collider(i));
+            }
+
+            hash_grid.reset();
+            for(uint32_t i = 0; i < body_count; i++) {
+                if (!is_on_broadphase(i)) {
+                    continue;
+                }
+                hash_grid.add_body(dense_to_slot[i], get_AABB_of_collider(i), is_static[i]);
+            }
+
+            hash_grid.build_pairs((max_radius > 0.0f) ? 2.0f * max_radius : 1.0f);
+
+            return &hash_grid.pairs;
+        }
+
+        for(uint32_t i = 0; i < body_count; i++) {
+            if (is_static[i] || !is_on_broadphase(i)) {
+                continue;
+            }
+
+            dynamic_tree.move_proxy(broadphase_proxy[i], get_AABB_of_collider(i));
+        }
+
+        broadphase_pairs.reset();
+        dynamic_tree.get_overlapping_pairs(&broadphase_pairs);
+        dynamic_tree.get_overlapping_pairs(static_tree, &broadphase_pairs);
+
+        return &broadphase_pairs;
+    }
+
+    // World space hull of the body, as a view of the shape library's data
+    inline sColliderMesh get_collider_mesh(const uint32_t index) const {
+        return shape_library.get_instance(collider_shape[index], collider_instance[index]);
+    }
+
+    // Rewrite the world space hulls of the moved bodies, in place
+    void update_collider_meshes() {
+        for(uint32_t i = 0; i < body_count; i++) {
+            if (collider_shape[i] == SHAPE_LIBRARY_NULL || transforms[i].is_equal(old_transforms[i])) {
+                continue;
+            }
+
+            shape_library.update_instance(collider_shape[i], collider_instance[i], transforms[i]);
+            memcpy(&old_transforms[i], &transforms[i], sizeof(sTransform));
+        }
     }
 
     void set_default_values() {
         // Set default values
-        memset(enabled, false, sizeof(enabled));
-        memset(is_static, false, sizeof(is_static));
-        memset(obj_speeds, 0.0f, sizeof(obj_speeds));
+        memset(enabled, false, sizeof(bool) * body_capacity);
+        memset(is_static, false, sizeof(bool) * body_capacity);
+        memset(obj_speeds, 0.0f, sizeof(sSpeed) * body_capacity);
 
-        memset(plane_collider_normal, 0.0f, sizeof(plane_collider_normal));
-
-        memset(initialized, false, sizeof(initialized));
+        memset(plane_collider_normal, 0.0f, sizeof(sVector3) * body_capacity);
     }
 
     inline uint32_t add_cube_collider(const sVector3& obj_position,
@@ -115,24 +719,24 @@ struct sPhysWorld {
                                       const float obj_mass,
                                       const float restitut,
                                       const bool obj_is_static) {
-        uint32_t index = 0;
-        for(; index < PHYS_INSTANCE_COUNT; index++ ) {
-            if (!initialized[index]) {
-                break;
-            }
+        const uint32_t handle = allocate_body();
+        if (handle == INVALID_HANDLE) {
+            return INVALID_HANDLE;
         }
+        const uint32_t index = slot_to_dense[get_handle_index(handle)];
 
         is_static[index] = obj_is_static;
         enabled[index] = true;
+        obj_speeds[index] = {};
+        motion_bound[index] = 0.0f;
 
-        initialized[index] = true;
         shape[index] = CUBE_COLLIDER;
         restitution[index] = restitut;
 
         if (obj_is_static) {
             mass[index] = 0.0f;
             inv_mass[index] = 0.0f;
-            inv_inertia_tensors[index].set_identity();
+            inv_local_inertia_tensors[index].set_identity();
         } else {
             mass[index] = obj_mass;
             inv_mass[index] = 1.0f / obj_mass;
@@ -143,17 +747,95 @@ struct sPhysWorld {
             inertia_tensor.mat_values[1][1] = 1.0f/12.0f * obj_mass * (obj_scale.z * obj_scale.z + obj_scale.x * obj_scale.x);
             inertia_tensor.mat_values[2][2] = 1.0f/12.0f * obj_mass * (obj_scale.x * obj_scale.x + obj_scale.y * obj_scale.y);
 
-            inertia_tensor.invert(&inv_inertia_tensors[index]);
+            inertia_tensor.invert(&inv_local_inertia_tensors[index]);
         }
 
         transforms[index].position = obj_position;
         transforms[index].scale = obj_scale;
         transforms[index].rotation = sQuaternion4{1.0f, 0.0f, 0.0f, 0.f};
 
-        collider_meshes[index].init_cuboid(transforms[index]);
+        collider_shape[index] = cube_shape;
+        collider_instance[index] = shape_library.create_instance(cube_shape);
+        shape_library.update_instance(cube_shape, collider_instance[index], transforms[index]);
         memcpy(&old_transforms[index], &transforms[index], sizeof(sTransform));
 
-        return index;
+        add_to_broadphase(index);
+
+        return handle;
+    }
+
+    // Registers the convex hull of the mesh on the shape library. The caller
+    // holds the first reference of the shape, and should release it when
+    // no more bodies are going to be created with it.
+    // Returns SHAPE_LIBRARY_NULL if the mesh is flat
+    inline uint32_t add_hull_shape(const sMesh &mesh,
+                                   const uint32_t max_vertices) {
+        sColliderMesh local_hull = {};
+        if (!local_hull.load_convex_hull(mesh, max_vertices)) {
+            return SHAPE_LIBRARY_NULL;
+        }
+
+        return shape_library.add_shape(local_hull);
+    }
+
+    inline void release_shape(const uint32_t shape_id) {
+        shape_library.release(shape_id);
+    }
+
+    inline uint32_t add_hull_collider(const sVector3& obj_position,
+                                      const sVector3& obj_scale,
+                                      const uint32_t hull_shape,
+                                      const float obj_mass,
+                                      const float restitut,
+                                      const bool obj_is_static) {
+        const uint32_t handle = allocate_body();
+        if (handle == INVALID_HANDLE) {
+            return INVALID_HANDLE;
+        }
+        const uint32_t index = slot_to_dense[get_handle_index(handle)];
+
+        is_static[index] = obj_is_static;
+        enabled[index] = true;
+        obj_speeds[index] = {};
+        motion_bound[index] = 0.0f;
+
+        shape[index] = HULL_COLLIDER;
+        restitution[index] = restitut;
+
+        if (obj_is_static) {
+            mass[index] = 0.0f;
+            inv_mass[index] = 0.0f;
+            inv_local_inertia_tensors[index].set_identity();
+        } else {
+            mass[index] = obj_mass;
+            inv_mass[index] = 1.0f / obj_mass;
+
+            // Approximated by the inertia of the box of the local bounds
+            const sConvexShape &convex_shape = shape_library.get_shape(hull_shape);
+            const sVector3 local_size = convex_shape.local_max.subs(convex_shape.local_min);
+            const sVector3 size = {local_size.x * obj_scale.x, local_size.y * obj_scale.y, local_size.z * obj_scale.z};
+
+            sMat33 inertia_tensor;
+            inertia_tensor.set_identity();
+            inertia_tensor.mat_values[0][0] = 1.0f/12.0f * obj_mass * (size.z * size.z + size.y * size.y);
+            inertia_tensor.mat_values[1][1] = 1.0f/12.0f * obj_mass * (size.z * size.z + size.x * size.x);
+            inertia_tensor.mat_values[2][2] = 1.0f/12.0f * obj_mass * (size.x * size.x + size.y * size.y);
+
+            inertia_tensor.invert(&inv_local_inertia_tensors[index]);
+        }
+
+        transforms[index].position = obj_position;
+        transforms[index].scale = obj_scale;
+        transforms[index].rotation = sQuaternion4{1.0f, 0.0f, 0.0f, 0.f};
+
+        collider_shape[index] = hull_shape;
+        collider_instance[index] = shape_library.create_instance(hull_shape);
+        shape_library.update_instance(hull_shape, collider_instance[index], transforms[index]);
+        memcpy(&old_transforms[index], &transforms[index], sizeof(sTransform));
+
+        add_to_broadphase(index);
+
+        return handle;
     }
 
     inline uint32_t add_sphere_collider(const sVector3& obj_position,
@@ -161,22 +843,23 @@ struct sPhysWorld {
                                         const float obj_mass,
                                         const float restitut,
                                         const bool obj_is_static) {
-        uint32_t index = 0;
-        for(; index < PHYS_INSTANCE_COUNT; index++ ) {
-            if (!initialized[index]) {
-                break;
-            }
+        const uint32_t handle = allocate_body();
+        if (handle == INVALID_HANDLE) {
+            return INVALID_HANDLE;
         }
-        initialized[index] = true;
+        const uint32_t index = slot_to_dense[get_handle_index(handle)];
+
         is_static[index] = obj_is_static;
         enabled[index] = true;
+        obj_speeds[index] = {};
+        motion_bound[index] = 0.0f;
         shape[index] = SPHERE_COLLIDER;
         restitution[index] = restitut;
 
         if (obj_is_static) {
             mass[index] = 0.0f;
             inv_mass[index] = 0.0f;
-            inv_inertia_tensors[index].set_identity();
+            inv_local_inertia_tensors[index].set_identity();
         } else {
             mass[index] = obj_mass;
             inv_mass[index] = 1.0f / obj_mass;
@@ -187,15 +870,648 @@ struct sPhysWorld {
             inertia_tensor.mat_values[1][1] = 2.0f/5.0f * obj_mass * radius * radius;
             inertia_tensor.mat_values[2][2] = 2.0f/5.0f * obj_mass * radius * radius;
 
-            inertia_tensor.invert(&inv_inertia_tensors[index]);
+            inertia_tensor.invert(&inv_local_inertia_tensors[index]);
         }
 
         transforms[index].position = obj_position;
         transforms[index].scale = sVector3{radius, radius, radius};
+        transforms[index].rotation = sQuaternion4{1.0f, 0.0f, 0.0f, 0.f};
+        memcpy(&old_transforms[index], &transforms[index], sizeof(sTransform));
+
+        add_to_broadphase(index);
+
+        return handle;
+    }
 
+    // The capsule goes along the Y axis, from -half_height to half_height
+    // (without the caps)
+    inline uint32_t add_capsule_collider(const sVector3& obj_position,
+                                         const float radius,
+                                         const float half_height,
+                                         const float obj_mass,
+                                         const float restitut,
+                                         const bool obj_is_static) {
+        const uint32_t handle = allocate_body();
+        if (handle == INVALID_HANDLE) {
+            return INVALID_HANDLE;
+        }
+        const uint32_t index = slot_to_dense[get_handle_index(handle)];
+
+        is_static[index] = obj_is_static;
+        enabled[index] = true;
+        obj_speeds[index] = {};
+        motion_bound[index] = 0.0f;
+        shape[index] = CAPSULE_COLLIDER;
+        restitution[index] = restitut;
+
+        if (obj_is_static) {
+            mass[index] = 0.0f;
+            inv_mass[index] = 0.0f;
+            inv_local_inertia_tensors[index].set_identity();
+        } else {
+            mass[index] = obj_mass;
+            inv_mass[index] = 1.0f / obj_mass;
+
+            // The mass is split between the cylinder and the caps by volume,
+            // and the caps are moved to the ends of the cylinder
+            const float cylinder_volume = 2.0f * half_height;
+            const float caps_volume = 4.0f / 3.0f * radius;
+            const float cylinder_mass = obj_mass * cylinder_volume / (cylinder_volume + caps_volume);
+            const float caps_mass = obj_mass - cylinder_mass;
+            const float radius_squared = radius * radius;
+
+            const float axial_inertia = cylinder_mass * radius_squared * 0.5f + caps_mass * radius_squared * 2.0f / 5.0f;
+            const float side_inertia = cylinder_mass * (half_height * half_height / 3.0f + radius_squared / 4.0f) +
+                                       caps_mass * (radius_squared * 2.0f / 5.0f + half_height * half_height + half_height * radius * 3.0f / 4.0f);
+
+            sMat33 inertia_tensor;
+            inertia_tensor.set_identity();
+            inertia_tensor.mat_values[0][0] = side_inertia;
+            inertia_tensor.mat_values[1][1] = axial_inertia;
+            inertia_tensor.mat_values[2][2] = side_inertia;
+
+            inertia_tensor.invert(&inv_local_inertia_tensors[index]);
+        }
+
+        transforms[index].position = obj_position;
+        transforms[index].scale = sVector3{radius, half_height, radius};
+        transforms[index].rotation = sQuaternion4{1.0f, 0.0f, 0.0f, 0.f};
+        memcpy(&old_transforms[index], &transforms[index], sizeof(sTransform));
+
+        add_to_broadphase(index);
+
+        return handle;
+    }
+
+    // The planes are always static, and face the normal's direction
+    inline uint32_t add_plane_collider(const sVector3& plane_origin,
+                                       const sVector3& plane_normal,
+                                       const float restitut) {
+        const uint32_t handle = allocate_body();
+        if (handle == INVALID_HANDLE) {
+            return INVALID_HANDLE;
+        }
+        const uint32_t index = slot_to_dense[get_handle_index(handle)];
+
+        is_static[index] = true;
+        enabled[index] = true;
+        obj_speeds[index] = {};
+        motion_bound[index] = 0.0f;
+        shape[index] = PLANE_COLLIDER;
+        restitution[index] = restitut;
+
+        // No angular response, since the plane's position is arbitrary
+        mass[index] = 0.0f;
+        inv_mass[index] = 0.0f;
+        inv_local_inertia_tensors[index] = {};
+
+        transforms[index].position = plane_origin;
+        transforms[index].scale = sVector3{1.0f, 1.0f, 1.0f};
+        transforms[index].rotation = sQuaternion4{1.0f, 0.0f, 0.0f, 0.f};
+        plane_collider_normal[index] = plane_normal.normalize();
+
+        plane_slots[plane_count++] = get_handle_index(handle);
+
+        return handle;
+    }
+
+    // Static concave collider, for the level geometry. The transform is
+    // baked on the triangles.
+    // Returns INVALID_HANDLE if the mesh has no triangles
+    inline uint32_t add_triangle_mesh_collider(const sMesh &mesh,
+                                               const sVector3& obj_position,
+                                               const sVector3& obj_scale,
+                                               const float restitut) {
+        sTransform mesh_transform = {};
+        mesh_transform.position = obj_position;
+        mesh_transform.scale = obj_scale;
+        mesh_transform.rotation = sQuaternion4{1.0f, 0.0f, 0.0f, 0.f};
+
+        sTriangleMesh triangle_mesh = {};
+        if (!triangle_mesh.init_from_mesh(mesh, mesh_transform)) {
+            return INVALID_HANDLE;
+        }
+
+        const uint32_t handle = allocate_body();
+        if (handle == INVALID_HANDLE) {
+            triangle_mesh.clean();
+            return INVALID_HANDLE;
+        }
+        const uint32_t index = slot_to_dense[get_handle_index(handle)];
+
+        is_static[index] = true;
+        enabled[index] = true;
+        obj_speeds[index] = {};
+        motion_bound[index] = 0.0f;
+        shape[index] = TRIANGLE_MESH_COLLIDER;
+        restitution[index] = restitut;
+
+        mass[index] = 0.0f;
+        inv_mass[index] = 0.0f;
+        inv_local_inertia_tensors[index] = {};
+
+        transforms[index] = mesh_transform;
+        triangle_mesh_collider[index] = triangle_mesh;
+
+        add_to_broadphase(index);
+
+        return handle;
+    }
+
+    // Static terrain collider, from a grid of width x depth 16 bit samples,
+    // stored row by row on the X axis. The sample (x, z) is placed at
+    // position + (x * scale.x, height * scale.y, z * scale.z)
+    // Returns INVALID_HANDLE if there is not at least one cell
+    inline uint32_t add_heightfield_collider(const uint16_t *heights,
+                                             const uint32_t width,
+                                             const uint32_t depth,
+                                             const sVector3& obj_position,
+                                             const sVector3& obj_scale,
+                                             const float restitut) {
+        sHeightfield heightfield = {};
+        if (!heightfield.init(heights, width, depth, obj_position, obj_scale)) {
+            return INVALID_HANDLE;
+        }
+
+        const uint32_t handle = allocate_body();
+        if (handle == INVALID_HANDLE) {
+            heightfield.clean();
+            return INVALID_HANDLE;
+        }
+        const uint32_t index = slot_to_dense[get_handle_index(handle)];
+
+        is_static[index] = true;
+        enabled[index] = true;
+        obj_speeds[index] = {};
+        motion_bound[index] = 0.0f;
+        shape[index] = HEIGHTFIELD_COLLIDER;
+        restitution[index] = restitut;
+
+        mass[index] = 0.0f;
+        inv_mass[index] = 0.0f;
+        inv_local_inertia_tensors[index] = {};
+
+        transforms[index].position = obj_position;
+        transforms[index].scale = obj_scale;
+        transforms[index].rotation = sQuaternion4{1.0f, 0.0f, 0.0f, 0.f};
+        heightfield_collider[index] = heightfield;
+
+        add_to_broadphase(index);
+
+        return handle;
+    }
+
+    // An empty rigid body, for the bodies attached to it. Its position is
+    // moved to their center of mass
+    inline uint32_t add_compound_collider(const sVector3& obj_position,
+                                          const float restitut,
+                                          const bool obj_is_static) {
+        const uint32_t handle = allocate_body();
+        if (handle == INVALID_HANDLE) {
+            return INVALID_HANDLE;
+        }
+        const uint32_t index = slot_to_dense[get_handle_index(handle)];
+
+        is_static[index] = obj_is_static;
+        enabled[index] = true;
+        obj_speeds[index] = {};
+        motion_bound[index] = 0.0f;
+        shape[index] = COMPOUND_COLLIDER;
+        restitution[index] = restitut;
+
+        mass[index] = 0.0f;
+        inv_mass[index] = 0.0f;
+        inv_local_inertia_tensors[index] = {};
+
+        transforms[index].position = obj_position;
+        transforms[index].scale = sVector3{1.0f, 1.0f, 1.0f};
+        transforms[index].rotation = sQuaternion4{1.0f, 0.0f, 0.0f, 0.f};
+        compound_collider[index].init();
+
+        add_to_broadphase(index);
+
+        return handle;
+    }
+
+    // Attach a body to the compound, placed with the local position and
+    // rotation relative to the compound's frame (where it was created, not
+    // its center of mass, plus its current rotation). Its mass and
+    // inertia are added to the compound's, and from now on it is moved by
+    // the compound, and removed with it.
+    // Only the bodies with a convex shape can be attached
+    // Returns false if the handles are not valid for that
+    bool attach_to_compound(const uint32_t compound_handle,
+                            const uint32_t child_handle,
+                            const sVector3 &local_position,
+                            const sQuaternion4 &local_rotation) {
+        if (!is_valid(compound_handle) || !is_valid(child_handle)) {
+            return false;
+        }
+
+        const uint32_t compound = get_body_index(compound_handle);
+        const uint32_t child = get_body_index(child_handle);
+        if (shape[compound] != COMPOUND_COLLIDER || node_parenting[child].parent_type != NO_PARENT) {
+            return false;
+        }
+        if (shape[child] != SPHERE_COLLIDER && shape[child] != CUBE_COLLIDER &&
+            shape[child] != CAPSULE_COLLIDER && shape[child] != HULL_COLLIDER) {
+            return false;
+        }
+
+        remove_from_broadphase(child);
+        coll_manager.release_object_collisions(dense_to_slot[child]);
+
+        node_parenting[child].parent_type = COLLIDER_PARENT;
+        node_parenting[child].parent_index_index = dense_to_slot[compound];
+        node_parenting[child].local_transform.position = local_position.subs(compound_collider[compound].center_of_mass);
+        node_parenting[child].local_transform.rotation = local_rotation;
+        node_parenting[child].local_transform.scale = transforms[child].scale;
+        is_static[child] = is_static[compound];
+        obj_speeds[child] = {};
+
+        compound_collider[compound].add_child(child_handle);
+        update_compound(compound);
+
+        return true;
+    }
+
+    // Recompute the mass and inertia of the compound from its children,
+    // moving its position to their center of mass, and rebuild the tree
+    void update_compound(const uint32_t index) {
+        sCompound &compound = compound_collider[index];
+        sTransform &transf = transforms[index];
+
+        float total_mass = 0.0f;
+        sVector3 center_of_mass = {0.0f, 0.0f, 0.0f};
+        for(uint32_t i = 0; i < compound.child_count; i++) {
+            const uint32_t child = get_body_index(compound.child_handles[i]);
+            total_mass += mass[child];
+            center_of_mass = center_of_mass.sum(node_parenting[child].local_transform.position.mult(mass[child]));
+        }
+
+        if (is_static[index] || total_mass <= 0.0f) {
+            mass[index] = 0.0f;
+            inv_mass[index] = 0.0f;
+            inv_local_inertia_tensors[index] = {};
+        } else {
+            center_of_mass = center_of_mass.mult(1.0f / total_mass);
+            transf.position = transf.position.sum(transf.apply_rotation(center_of_mass));
+            compound.center_of_mass = compound.center_of_mass.sum(center_of_mass);
+
+            // Each child's inertia, rotated to the compound's space, and
+            // moved to the center of mass (parallel axis theorem)
+            sMat33 inertia_tensor = {};
+            for(uint32_t i = 0; i < compound.child_count; i++) {
+                const uint32_t child = get_body_index(compound.child_handles[i]);
+                sTransform &local_transform = node_parenting[child].local_transform;
+                local_transform.position = local_transform.position.subs(center_of_mass);
+
+                if (mass[child] <= 0.0f) {
+                    continue;
+                }
+
+                const sVector3 axis[3] = {local_transform.apply_rotation({1.0f, 0.0f, 0.0f}),
+                                          local_transform.apply_rotation({0.0f, 1.0f, 0.0f}),
+                                          local_transform.apply_rotation({0.0f, 0.0f, 1.0f})};
+                sMat33 rotation = {}, rotation_t = {}, child_inertia = {}, tmp = {}, rotated_inertia = {};
+                for(uint32_t col = 0; col < 3; col++) {
+                    rotation.mat_values[0][col] = axis[col].x;
+                    rotation.mat_values[1][col] = axis[col].y;
+                    rotation.mat_values[2][col] = axis[col].z;
+                }
+                rotation.transponse_to(&rotation_t);
+                inv_local_inertia_tensors[child].invert(&child_inertia);
+                child_inertia.multiply_to(&rotation_t, &tmp);
+                rotation.multiply_to(&tmp, &rotated_inertia);
+
+                const sVector3 &d = local_transform.position;
+                const float d_values[3] = {d.x, d.y, d.z};
+                const float distance_squared = dot_prod(d, d);
+                for(uint32_t row = 0; row < 3; row++) {
+                    for(uint32_t col = 0; col < 3; col++) {
+                        const float offset_term = ((row == col) ? distance_squared : 0.0f) - d_values[row] * d_values[col];
+                        inertia_tensor.mat_values[row][col] += rotated_inertia.mat_values[row][col] + mass[child] * offset_term;
+                    }
+                }
+            }
+
+            mass[index] = total_mass;
+            inv_mass[index] = 1.0f / total_mass;
+            inertia_tensor.invert(&inv_local_inertia_tensors[index]);
+        }
+
+        // The tree, with the children's local bounds
+        if (compound.child_count > compound_child_capacity) {
+            compound_child_capacity = compound.child_count * 2;
+            compound_child_aabbs = (sAABB*) realloc(compound_child_aabbs, sizeof(sAABB) * compound_child_capacity);
+            compound_child_slots = (uint32_t*) realloc(compound_child_slots, sizeof(uint32_t) * compound_child_capacity);
+        }
+        compound.bounding_radius = 0.0f;
+        for(uint32_t i = 0; i < compound.child_count; i++) {
+            const uint32_t child = get_body_index(compound.child_handles[i]);
+            const sTransform &local_transform = node_parenting[child].local_transform;
+
+            compound_child_aabbs[i] = get_AABB_of_collider(child, local_transform);
+            compound_child_slots[i] = dense_to_slot[child];
+            compound.bounding_radius = MAX(compound.bounding_radius, local_transform.position.magnitude() + get_bounding_radius(child));
+        }
+        compound.rebuild_tree(compound_child_aabbs, compound_child_slots);
+
+        place_compound_children(index);
+
+        // With the new bounds
+        remove_from_broadphase(index);
+        add_to_broadphase(index);
+    }
+
+    // Move the children to the compound's transform
+    inline void place_compound_children(const uint32_t index) {
+        const sTransform &transf = transforms[index];
+        const sCompound &compound = compound_collider[index];
+
+        for(uint32_t i = 0; i < compound.child_count; i++) {
+            const uint32_t child = get_body_index(compound.child_handles[i]);
+            const sTransform &local_transform = node_parenting[child].local_transform;
+
+            transforms[child].position = transf.apply_rotation(local_transform.position).sum(transf.position);
+            transforms[child].rotation = local_transform.rotation.multiply(transf.rotation);
+            transforms[child].scale = local_transform.scale;
+            enabled[child] = enabled[index];
+            // Covered by the compound's bounding radius
+            motion_bound[child] = motion_bound[index];
+        }
+    }
+
+    // The rigid body that responds to the contacts of the body on the slot:
+    // the compound, for its children
+    inline uint32_t get_rigid_body_index(const uint32_t slot) const {
+        const uint32_t index = slot_to_dense[slot];
+        if (node_parenting[index].parent_type == COLLIDER_PARENT) {
+            return slot_to_dense[node_parenting[index].parent_index_index];
+        }
         return index;
     }
 
+    inline sTriangleTestShape get_triangle_test_shape(const uint32_t body) const {
+        sTriangleTestShape test_shape = {};
+
+        if (shape[body] == SPHERE_COLLIDER) {
+            test_shape.type = TRIANGLE_TEST_SPHERE;
+            test_shape.start = transforms[body].position;
+            test_shape.radius = get_radius_of_collider(body);
+        } else if (shape[body] == CAPSULE_COLLIDER) {
+            test_shape.type = TRIANGLE_TEST_CAPSULE;
+            get_capsule_segment(body, &test_shape.start, &test_shape.end);
+            test_shape.radius = transforms[body].scale.x;
+        } else {
+            test_shape.type = TRIANGLE_TEST_HULL;
+            test_shape.mesh = get_collider_mesh(body);
+        }
+
+        return test_shape;
+    }
+
+    // Contacts of the body against the mesh's triangles that overlap its AABB,
+    // merged on a single manifold. Its normal goes from the mesh to the body
+    inline bool test_triangle_mesh_collision(const uint32_t mesh,
+                                             const uint32_t body,
+                                             sNarrowphaseResult *result) {
+        sTriangleMesh &triangle_mesh = triangle_mesh_collider[mesh];
+        const uint32_t triangle_count = triangle_mesh.query(get_AABB_of_collider(body));
+        if (triangle_count == 0) {
+            return false;
+        }
+
+        sTriangleTestShape test_shape = get_triangle_test_shape(body);
+        sTriangleManifoldMerger merger = {};
+
+        for(uint32_t i = 0; i < triangle_count; i++) {
+            const uint32_t triangle_id = triangle_mesh.query_triangles[i];
+            sVector3 triangle[3] = {};
+            triangle_mesh.get_triangle(triangle_id, &triangle[0], &triangle[1], &triangle[2]);
+
+            sVector3 triangle_contact_normal = {};
+            sVector3 triangle_contact_points[MAX_CONTACT_COUNT] = {};
+            float triangle_contact_depth[MAX_CONTACT_COUNT] = {};
+            uint16_t triangle_contact_count = 0;
+
+            if (test_shape.test(triangle,
+                                triangle_mesh.normals[triangle_id],
+                                &triangle_contact_normal,
+                                triangle_contact_points,
+                                triangle_contact_depth,
+                                &triangle_contact_count)) {
+                merger.add(triangle_contact_normal,
+                           triangle_contact_points,
+                           triangle_contact_depth,
+                           triangle_contact_count,
+                           result->contact_points,
+                           result->contact_depth);
+            }
+        }
+
+        return merger.get_result(&result->normal, result->contact_depth, &result->contact_count);
+    }
+
+    // Contacts of the body against the triangles of the heightfield's cells
+    // under its AABB, merged on a single manifold. Its normal goes from the
+    // heightfield to the body
+    inline bool test_heightfield_collision(const uint32_t field,
+                                           const uint32_t body,
+                                           sNarrowphaseResult *result) {
+        sHeightfield &heightfield = heightfield_collider[field];
+        const uint32_t cell_count = heightfield.query(get_AABB_of_collider(body));
+        if (cell_count == 0) {
+            return false;
+        }
+
+        sTriangleTestShape test_shape = get_triangle_test_shape(body);
+        sTriangleManifoldMerger merger = {};
+
+        for(uint32_t i = 0; i < cell_count; i++) {
+            sVector3 triangles[2][3] = {};
+            sVector3 triangle_normals[2] = {};
+            heightfield.get_cell_triangles(heightfield.query_cells[i], triangles, triangle_normals);
+
+            for(uint32_t j = 0; j < 2; j++) {
+                sVector3 triangle_contact_normal = {};
+                sVector3 triangle_contact_points[MAX_CONTACT_COUNT] = {};
+                float triangle_contact_depth[MAX_CONTACT_COUNT] = {};
+                uint16_t triangle_contact_count = 0;
+
+                if (test_shape.test(triangles[j],
+                                    triangle_normals[j],
+                                    &triangle_contact_normal,
+                                    triangle_contact_points,
+                                    triangle_contact_depth,
+                                    &triangle_contact_count)) {
+                    merger.add(triangle_contact_normal,
+                               triangle_contact_points,
+                               triangle_contact_depth,
+                               triangle_contact_count,
+                               result->contact_points,
+                               result->contact_depth);
+                }
+            }
+        }
+
+        return merger.get_result(&result->normal, result->contact_depth, &result->contact_count);
+    }
+
+    // Narrowphase of the compound's children whose local AABB overlaps the
+    // body, against it
+    void test_compound_collision(const uint32_t compound,
+                                 const uint32_t body) {
+        sCompound &compound_data = compound_collider[compound];
+        const uint32_t child_count = compound_data.query(get_local_AABB(transforms[compound], get_AABB_of_collider(body)));
+
+        for(uint32_t i = 0; i < child_count; i++) {
+            const uint32_t child = slot_to_dense[compound_data.query_children[i]];
+
+            if (shape[body] == COMPOUND_COLLIDER) {
+                test_compound_collision(body, child);
+            } else {
+                test_pair_collision(child, body);
+            }
+        }
+    }
+
+    // Narrowphase of a pair of bodies, via the kernel of their shapes
+    inline void test_pair_collision(const uint32_t i,
+                                    const uint32_t j) {
+        const tPairTest pair_test = pair_tests[shape[i]][shape[j]];
+        if (pair_test != NULL) {
+            (this->*pair_test)(i, j);
+        }
+    }
+
+    // Narrowphase of a pair of bodies, the contacts are stored on the manager
+    template<tNarrowphaseKernel KERNEL>
+    inline void test_pair(const uint32_t i,
+                          const uint32_t j) {
+        // Skip the pairs that were separated by more than what they
+        // could have moved since
+        sPairCache *pair_cache = coll_manager.get_pair_cache(dense_to_slot[i], dense_to_slot[j]);
+        pair_cache->separation -= motion_bound[i] + motion_bound[j];
+        if (pair_cache->separation > 0.0f) {
+            return;
+        }
+
+        sNarrowphaseResult result = {};
+        if (!(this->*KERNEL)(i, j, pair_cache, &result)) {
+            pair_cache->separation = result.separation;
+            return;
+        }
+
+        pair_cache->separation = 0.0f;
+        coll_manager.renew_contacts_to_collision(dense_to_slot[i],
+                                                 dense_to_slot[j],
+                                                 result.normal,
+                                                 result.contact_points,
+                                                 result.contact_depth,
+                                                 result.contact_count);
+    }
+
+    // All the pairs of a bucket have the same shapes, so the kernel is
+    // resolved at compile time, and inlined on the loop
+    template<tNarrowphaseKernel KERNEL>
+    void test_pair_bucket(const sBroadphasePair *bucket_pairs,
+                          const uint32_t pair_count) {
+        for(uint32_t pair = 0; pair < pair_count; pair++) {
+            test_pair<KERNEL>(slot_to_dense[bucket_pairs[pair].id1],
+                              slot_to_dense[bucket_pairs[pair].id2]);
+        }
+    }
+
+    // Narrowphase kernels: only declared here, each pair of shapes is
+    // specialized after the struct
+    template<eColiderTypes SHAPE_A, eColiderTypes SHAPE_B>
+    bool test_kernel(const uint32_t a,
+                     const uint32_t b,
+                     sPairCache *pair_cache,
+                     sNarrowphaseResult *result);
+
+    // The kernel of (SHAPE_A, SHAPE_B), for the bodies in the opposite order
+    template<eColiderTypes SHAPE_A, eColiderTypes SHAPE_B>
+    inline bool test_swapped_kernel(const uint32_t b,
+                                    const uint32_t a,
+                                    sPairCache *pair_cache,
+                                    sNarrowphaseResult *result) {
+        if (!test_kernel<SHAPE_A, SHAPE_B>(a, b, pair_cache, result)) {
+            return false;
+        }
+
+        result->normal = result->normal.invert();
+        return true;
+    }
+
+    // Registers the kernel for both orders of the shapes
+    template<eColiderTypes SHAPE_A, eColiderTypes SHAPE_B>
+    void add_narrowphase_kernel() {
+        pair_tests[SHAPE_B][SHAPE_A] = &sPhysWorld::test_pair<&sPhysWorld::test_swapped_kernel<SHAPE_A, SHAPE_B> >;
+        pair_bucket_tests[SHAPE_B][SHAPE_A] = &sPhysWorld::test_pair_bucket<&sPhysWorld::test_swapped_kernel<SHAPE_A, SHAPE_B> >;
+
+        // Overwrites the swapped one, if both shapes are the same
+        pair_tests[SHAPE_A][SHAPE_B] = &sPhysWorld::test_pair<&sPhysWorld::test_kernel<SHAPE_A, SHAPE_B> >;
+        pair_bucket_tests[SHAPE_A][SHAPE_B] = &sPhysWorld::test_pair_bucket<&sPhysWorld::test_kernel<SHAPE_A, SHAPE_B> >;
+    }
+
+    // Defined after the kernels' specializations
+    void init_narrowphase_kernels();
+
+    // The compound pairs are tested here. The rest are sorted on
+    // narrowphase_pairs by their shapes: the bucket of the shapes (a, b)
+    // is the range [bucket_start[a * COLLIDER_COUNT + b], bucket_start[a * COLLIDER_COUNT + b + 1])
+    void bucket_narrowphase_pairs(const sPairBuffer *pairs) {
+        if (pairs->count > narrowphase_pair_capacity) {
+            narrowphase_pair_capacity = pairs->count * 2;
+            narrowphase_pairs = (sBroadphasePair*) realloc(narrowphase_pairs, sizeof(sBroadphasePair) * narrowphase_pair_capacity);
+            narrowphase_pair_buckets = (uint8_t*) realloc(narrowphase_pair_buckets, sizeof(uint8_t) * narrowphase_pair_capacity);
+        }
+
+        uint32_t bucket_count[NARROWPHASE_BUCKET_COUNT] = {};
+
+        for(uint32_t pair = 0; pair < pairs->count; pair++) {
+            // The broadphase works with slots
+            const uint32_t i = slot_to_dense[pairs->pairs[pair].id1];
+            const uint32_t j = slot_to_dense[pairs->pairs[pair].id2];
+            narrowphase_pair_buckets[pair] = NARROWPHASE_NO_BUCKET;
+
+            if (!enabled[i] || !enabled[j]) {
+                continue;
+            }
+
+            // Skip the test if its between two static bodies
+            if (is_static[i] && is_static[j]) {
+                continue;
+            }
+
+            // The compounds test their children against the other body
+            if (shape[i] == COMPOUND_COLLIDER) {
+                test_compound_collision(i, j);
+            } else if (shape[j] == COMPOUND_COLLIDER) {
+                test_compound_collision(j, i);
+            } else if (pair_tests[shape[i]][shape[j]] != NULL) {
+                const uint8_t bucket = shape[i] * COLLIDER_COUNT + shape[j];
+                narrowphase_pair_buckets[pair] = bucket;
+                bucket_count[bucket]++;
+            }
+        }
+
+        bucket_start[0] = 0;
+        for(uint32_t bucket = 0; bucket < NARROWPHASE_BUCKET_COUNT; bucket++) {
+            bucket_start[bucket + 1] = bucket_start[bucket] + bucket_count[bucket];
+            // Reused as the insertion point of the bucket
+            bucket_count[bucket] = bucket_start[bucket];
+        }
+
+        for(uint32_t pair = 0; pair < pairs->count; pair++) {
+            const uint8_t bucket = narrowphase_pair_buckets[pair];
+            if (bucket != NARROWPHASE_NO_BUCKET) {
+                narrowphase_pairs[bucket_count[bucket]++] = pairs->pairs[pair];
+            }
+        }
+    }
 
     // Apply collisions & speeds, check for collisions, and resolve them
     void step(const double elapsed_time) {
@@ -203,13 +1519,13 @@ struct sPhysWorld {
         coll_manager.clean_frame();
 
         // 1 - Rotate inertia tensors
-        for(int i = 0; i < PHYS_INSTANCE_COUNT; i++) {
+        for(uint32_t i = 0; i < body_count; i++) {
             sMat33 r_mat = {}, r_mat_t = {}, inv_inertia = {};
             r_mat.convert_quaternion_to_matrix(transforms[i].rotation);
             r_mat.transponse_to(&r_mat_t);
 
             // Rotate the inertia tensor: I^-1 = r * I^-1 * r^t
-            inv_inertia_tensors[i].multiply_to(&r_mat_t, &inv_inertia);
+            inv_local_inertia_tensors[i].multiply_to(&r_mat_t, &inv_inertia);
             r_mat.multiply_to(&inv_inertia, &inv_inertia_tensors[i]);
         }
 
@@ -222,106 +1538,101 @@ struct sPhysWorld {
         float    tmp_contact_depth[MAX_CONTACT_COUNT] = {};
         sVector3 tmp_contact_normal = {};
 
-        for(uint8_t i = 0; i < PHYS_INSTANCE_COUNT; i++) {
-            for(uint8_t j = i+1; j < PHYS_INSTANCE_COUNT; j++) {
-                if (!enabled[i] || !enabled[j]) {
+        // 3.0 - Move the children of the compounds, and the world space
+        //       hulls of the bodies that have moved
+        for(uint32_t i = 0; i < body_count; i++) {
+            if (shape[i] == COMPOUND_COLLIDER) {
+                place_compound_children(i);
+            }
+        }
+        update_collider_meshes();
+
+        // 3.1 - Broadphase: only the pairs with overlapping AABBs
+        //       reach the narrowphase
+        const sPairBuffer *pairs = update_broadphase();
+
+        // 3.2 - Narrowphase: the pairs are bucketed by their shapes, and
+        //       each bucket is tested on a loop specialized for its kernel
+        bucket_narrowphase_pairs(pairs);
+        for(uint32_t shape_1 = 0; shape_1 < COLLIDER_COUNT; shape_1++) {
+            for(uint32_t shape_2 = 0; shape_2 < COLLIDER_COUNT; shape_2++) {
+                const uint32_t bucket = shape_1 * COLLIDER_COUNT + shape_2;
+                const uint32_t pair_count = bucket_start[bucket + 1] - bucket_start[bucket];
+
+                if (pair_count > 0) {
+                    const tPairBucketTest bucket_test = pair_bucket_tests[shape_1][shape_2];
+                    (this->*bucket_test)(&narrowphase_pairs[bucket_start[bucket]], pair_count);
+                }
+            }
+        }
+
+        // 3.3 - Planes: against all the dynamic bodies, with only the
+        //       support point along -normal of each one
+        for(uint32_t plane_id = 0; plane_id < plane_count; plane_id++) {
+            const uint32_t plane = slot_to_dense[plane_slots[plane_id]];
+            if (!enabled[plane]) {
+                continue;
+            }
+            const sVector3 &plane_origin = transforms[plane].position;
+            const sVector3 &plane_normal = plane_collider_normal[plane];
+
+            for(uint32_t i = 0; i < body_count; i++) {
+                if (!enabled[i] || is_static[i]) {
                     continue;
                 }
 
-                // Skip the test if its between two static bodies
-                if (is_static[i] && is_static[j]) {
+                // Early out with the bounding sphere
+                if (dot_prod(plane_normal, transforms[i].position.subs(plane_origin)) > get_bounding_radius(i)) {
                     continue;
                 }
 
-                uint8_t obj1 = 0;
-                uint8_t obj2 = 0;
                 bool collided = false;
-
-                // If there is a collision, store it in the manifold array
-                // Test the different colliders
-                if (shape[i] == SPHERE_COLLIDER && shape[j] == SPHERE_COLLIDER) {
-                    if (test_sphere_sphere_collision(transforms[i].position,
-                                                     get_radius_of_collider(i),
-                                                     transforms[j].position,
-                                                     get_radius_of_collider(j),
-                                                     &tmp_contact_normal,
-                                                     tmp_contact_points,
-                                                     tmp_contact_depth,
-                                                     &tmp_contanct_point_count)) {
-                        obj1 = i;
-                        obj2 = j;
-                        collided = true;
-                    }
-                } else if (shape[i] == SPHERE_COLLIDER && shape[j] == CUBE_COLLIDER) {
-                    if (!transforms[j].is_equal(old_transforms[j])) {
-                        collider_meshes[j].clean();
-                        collider_meshes[j].init_cuboid(transforms[j]);
-                        memcpy(&old_transforms[j], &transforms[j], sizeof(sTransform));
-                    }
-
-                    if (SAT::SAT_sphere_cube_collision(transforms[i].position,
-                                                       get_radius_of_collider(i),
-                                                       transforms[j],
-                                                       collider_meshes[j],
-                                                       &tmp_contact_normal,
-                                                       tmp_contact_points,
-                                                       tmp_contact_depth,
-                                                       &tmp_contanct_point_count)) {
-                        obj1 = i;
-                        obj2 = j;
-                        collided = true;
-                    }
-
-                } else if (shape[i] == CUBE_COLLIDER && shape[j] == SPHERE_COLLIDER) {
-                    if (!transforms[i].is_equal(old_transforms[i])) {
-                        collider_meshes[i].clean();
-                        collider_meshes[i].init_cuboid(transforms[i]);
-                        memcpy(&old_transforms[i], &transforms[i], sizeof(sTransform));
-                    }
-
-                    if (SAT::SAT_sphere_cube_collision(transforms[j].position,
-                                                       get_radius_of_collider(j),
-                                                       transforms[i],
-                                                       collider_meshes[i],
-                                                       &tmp_contact_normal,
-                                                       tmp_contact_points,
-                                                       tmp_contact_depth,
-                                                       &tmp_contanct_point_count)) {
-                        obj1 = i;
-                        obj2 = j;
-                        collided = true;
-                    }
-
-                } else if (shape[i] == CUBE_COLLIDER && shape[j] == CUBE_COLLIDER) {
-                    if (!transforms[i].is_equal(old_transforms[i])) {
-                        collider_meshes[i].clean();
-                        collider_meshes[i].init_cuboid(transforms[i]);
-                        memcpy(&old_transforms[i], &transforms[i], sizeof(sTransform));
-                    }
-
-                    if (!transforms[j].is_equal(old_transforms[j])) {
-                        collider_meshes[j].clean();
-                        collider_meshes[j].init_cuboid(transforms[j]);
-                        memcpy(&old_transforms[j], &transforms[j], sizeof(sTransform));
-                    }
-                    //std::cout << i << " " << j << std::endl;
-
-                    if (SAT::SAT_collision_test(collider_meshes[i],
-                                                collider_meshes[j],
-                                                &tmp_contact_normal,
-                                                tmp_contact_points,
-                                                tmp_contact_depth,
-                                                &tmp_contanct_point_count)) {
-                        obj1 = i;
-                        obj2 = j;
-                        collided = true;
-                    }
+                if (shape[i] == SPHERE_COLLIDER) {
+                    collided = test_plane_sphere_collision(transforms[i].position,
+                                                           get_radius_of_collider(i),
+                                                           plane_origin,
+                                                           plane_normal,
+                                                           &tmp_contact_normal,
+                                                           tmp_contact_points,
+                                                           tmp_contact_depth,
+                                                           &tmp_contanct_point_count);
+                } else if (shape[i] == CAPSULE_COLLIDER) {
+                    sVector3 start = {}, end = {};
+                    get_capsule_segment(i, &start, &end);
+                    collided = test_plane_capsule_collision(start,
+                                                            end,
+                                                            transforms[i].scale.x,
+                                                            plane_origin,
+                                                            plane_normal,
+                                                            &tmp_contact_normal,
+                                                            tmp_contact_points,
+                                                            tmp_contact_depth,
+                                                            &tmp_contanct_point_count);
+                } else if (shape[i] == CUBE_COLLIDER) {
+                    collided = test_plane_OBB_collision(transforms[i],
+                                                        plane_origin,
+                                                        plane_normal,
+                                                        &tmp_contact_normal,
+                                                        tmp_contact_points,
+                                                        tmp_contact_depth,
+                                                        &tmp_contanct_point_count);
+                } else if (collider_shape[i] != SHAPE_LIBRARY_NULL) {
+                    // The support vertex is warm started from the last frame
+                    sPairCache *pair_cache = coll_manager.get_pair_cache(plane_slots[plane_id], dense_to_slot[i]);
+                    collided = test_plane_hull_collision(get_collider_mesh(i),
+                                                         pair_cache->get_support_vertex(dense_to_slot[i]),
+                                                         plane_origin,
+                                                         plane_normal,
+                                                         &tmp_contact_normal,
+                                                         tmp_contact_points,
+                                                         tmp_contact_depth,
+                                                         &tmp_contanct_point_count);
                 }
 
                 if (collided) {
-                    std::cout << (uint16_t) shape[i] << " " << (uint16_t) shape[j] << std::endl;
-                    coll_manager.renew_contacts_to_collision(obj1,
-                                                             obj2,
+                    coll_manager.renew_contacts_to_collision(plane_slots[plane_id],
+                                                             dense_to_slot[i],
+                                                             tmp_contact_normal,
                                                              tmp_contact_points,
                                                              tmp_contact_depth,
                                                              tmp_contanct_point_count);
@@ -331,20 +1642,24 @@ struct sPhysWorld {
 
         // 4 - Collision Resolution
         // 4.1 - Collision presolving
-        int indices[MAX_COLLISION_COUNT] = {};
+        // The manifolds are kept for one frame after the bodies separate,
+        // so skip the ones that did not collide on this frame
         int collision_count = 0;
-        for(int i = 0; i < MAX_COLLISION_COUNT; i++) {
+        for(uint32_t i = 0; i < coll_manager.manifold_count; i++) {
             if (!coll_manager.has_collided_on_frame[i])
                 continue;
 
             impulse_presolver(coll_manager.manifold[i], elapsed_time);
-            indices[collision_count++] = i;
+            collision_count++;
         }
 
         // 4.2 = Collision Solving via iterations
         for(int iter = 0; iter < PHYS_SOLVER_ITERATIONS; iter++) {
-            for(int i = 0; i < collision_count; i++) {
-                impulse_response(coll_manager.manifold[indices[i]], elapsed_time);
+            for(uint32_t i = 0; i < coll_manager.manifold_count; i++) {
+                if (!coll_manager.has_collided_on_frame[i])
+                    continue;
+
+                impulse_response(coll_manager.manifold[i], elapsed_time);
             }
         }
 
@@ -356,14 +1671,14 @@ struct sPhysWorld {
 
     void debug_speeds() const {
         // Debug speeds
-        for(int i = 0; i < PHYS_INSTANCE_COUNT; i++) {
+        for(uint32_t i = 0; i < body_count; i++) {
             if (!enabled[i]) {
                 continue;
             }
             const sSpeed *speed = &obj_speeds[i];
 
-            char instance_name []= "Obj 00";
-            instance_name[5] = 48 + i;
+            char instance_name[16];
+            snprintf(instance_name, sizeof(instance_name), "Obj %u", dense_to_slot[i]);
 
             if(ImGui::TreeNode(instance_name)) {
                 ImGui::Text("Position: %f %f %f", transforms[i].position.x, transforms[i].position.y, transforms[i].position.z);
@@ -384,7 +1699,7 @@ struct sPhysWorld {
 
         int indexes[COLLIDER_COUNT] = {0,0,0};
 
-        for(int i = 0; i <  PHYS_INSTANCE_COUNT; i++) {
+        for(uint32_t i = 0; i < body_count; i++) {
             if (!enabled[i]) {
                 continue;
             }
@@ -399,11 +1714,17 @@ struct sPhysWorld {
 
     // Apply the speeds to the position
     void integrate(const double elapsed_time) {
-        for(int i = 0; i < PHYS_INSTANCE_COUNT; i++) {
-            if (is_static[i] || !enabled[i]) {
+        for(uint32_t i = 0; i < body_count; i++) {
+            // The children are moved by their compound
+            if (is_static[i] || !enabled[i] || node_parenting[i].parent_type == COLLIDER_PARENT) {
+                motion_bound[i] = 0.0f;
                 continue;
             }
 
+            // Any point of the body moves at most the linear speed plus
+            // the angular speed by its distance to the position
+            motion_bound[i] = (obj_speeds[i].linear.magnitude() + obj_speeds[i].angular.magnitude() * get_bounding_radius(i)) * elapsed_time;
+
             sTransform *transf = &transforms[i];
 
             // Integrate linear speed: pos += speed * elapsed_time
@@ -428,8 +1749,8 @@ struct sPhysWorld {
     // Apply the gravity based
     // TODO: Gravioty constant cleanup
     void apply_gravity(const double elapsed_time) {
-        for(int i = 0; i < PHYS_INSTANCE_COUNT; i++) {
-            if (is_static[i] || !enabled[i]) {
+        for(uint32_t i = 0; i < body_count; i++) {
+            if (is_static[i] || !enabled[i] || node_parenting[i].parent_type == COLLIDER_PARENT) {
                 continue;
             }
 
@@ -439,8 +1760,8 @@ struct sPhysWorld {
 
     // TODO: arbiter & warmstarting
     void impulse_presolver(sCollisionManifold &manifold, const float elapsed_time) {
-        uint8_t id_1 = manifold.obj1;
-        uint8_t id_2 = manifold.obj2;
+        uint32_t id_1 = get_rigid_body_index(manifold.obj1);
+        uint32_t id_2 = get_rigid_body_index(manifold.obj2);
 
         sTransform *transf_1 = &transforms[id_1];
         sTransform *transf_2 = &transforms[id_2];
@@ -468,8 +1789,6 @@ struct sPhysWorld {
             contact_data->angular_mass = dot_prod(r1_cross_n, inv_inertia_tensors[id_1].multiply(r1_cross_n)) +
                 dot_prod(r2_cross_n, inv_inertia_tensors[id_2].multiply(r2_cross_n));
 
-            std::cout <<(uint32_t) id_1 << " " << (uint32_t)id_2 << std::endl;
-
             // Baumgarte correction for the impulse
             contact_data->bias = -BAUMGARTE_TERM / elapsed_time * MIN(0.0f, manifold.contact_depth[i] + PENETRATION_SLOP);
 
@@ -510,8 +1829,8 @@ struct sPhysWorld {
     }
 
     void impulse_response(const sCollisionManifold &manifold, const float elapsed_time) {
-        uint8_t id_1 = manifold.obj1;
-        uint8_t id_2 = manifold.obj2;
+        uint32_t id_1 = get_rigid_body_index(manifold.obj1);
+        uint32_t id_2 = get_rigid_body_index(manifold.obj2);
 
         sTransform *transf_1 = &transforms[id_1];
         sTransform *transf_2 = &transforms[id_2];
@@ -605,4 +1924,288 @@ struct sPhysWorld {
     }
 };
 
+// Narrowphase kernels ==============
+// The normal of the result goes from the body a to the body b
+
+template<>
+inline bool sPhysWorld::test_kernel<SPHERE_COLLIDER, SPHERE_COLLIDER>(const uint32_t a,
+                                                                     const uint32_t b,
+                                                                     sPairCache *pair_cache,
+                                                                     sNarrowphaseResult *result) {
+    return test_sphere_sphere_collision(transforms[a].position,
+                                        get_radius_of_collider(a),
+                                        transforms[b].position,
+                                        get_radius_of_collider(b),
+                                        &result->normal,
+                                        result->contact_points,
+                                        result->contact_depth,
+                                        &result->contact_count,
+                                        &result->separation);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<CUBE_COLLIDER, SPHERE_COLLIDER>(const uint32_t a,
+                                                                   const uint32_t b,
+                                                                   sPairCache *pair_cache,
+                                                                   sNarrowphaseResult *result) {
+    // The normal goes from the box to the sphere
+    return OBB::sphere_OBB_collision(transforms[b].position,
+                                     get_radius_of_collider(b),
+                                     transforms[a],
+                                     &result->normal,
+                                     result->contact_points,
+                                     result->contact_depth,
+                                     &result->contact_count,
+                                     &result->separation);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<HULL_COLLIDER, SPHERE_COLLIDER>(const uint32_t a,
+                                                                   const uint32_t b,
+                                                                   sPairCache *pair_cache,
+                                                                   sNarrowphaseResult *result) {
+    // GJK, warm started with the last simplex of the pair
+    return GJK::convex_collision(GJK::get_hull_shape(get_collider_mesh(a),
+                                                     pair_cache->get_support_vertex(dense_to_slot[a])),
+                                 GJK::get_point_shape(transforms[b].position,
+                                                      get_radius_of_collider(b)),
+                                 pair_cache->get_simplex_cache(dense_to_slot[a]),
+                                 &result->normal,
+                                 result->contact_points,
+                                 result->contact_depth,
+                                 &result->contact_count,
+                                 &result->separation);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<CAPSULE_COLLIDER, SPHERE_COLLIDER>(const uint32_t a,
+                                                                      const uint32_t b,
+                                                                      sPairCache *pair_cache,
+                                                                      sNarrowphaseResult *result) {
+    sVector3 start = {}, end = {};
+    get_capsule_segment(a, &start, &end);
+
+    // The normal goes from the capsule to the sphere
+    return CAPSULE::capsule_sphere_collision(start,
+                                             end,
+                                             transforms[a].scale.x,
+                                             transforms[b].position,
+                                             get_radius_of_collider(b),
+                                             &result->normal,
+                                             result->contact_points,
+                                             result->contact_depth,
+                                             &result->contact_count,
+                                             &result->separation);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<CAPSULE_COLLIDER, CAPSULE_COLLIDER>(const uint32_t a,
+                                                                       const uint32_t b,
+                                                                       sPairCache *pair_cache,
+                                                                       sNarrowphaseResult *result) {
+    sVector3 start1 = {}, end1 = {}, start2 = {}, end2 = {};
+    get_capsule_segment(a, &start1, &end1);
+    get_capsule_segment(b, &start2, &end2);
+
+    return CAPSULE::capsule_capsule_collision(start1,
+                                              end1,
+                                              transforms[a].scale.x,
+                                              start2,
+                                              end2,
+                                              transforms[b].scale.x,
+                                              &result->normal,
+                                              result->contact_points,
+                                              result->contact_depth,
+                                              &result->contact_count,
+                                              &result->separation);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<CUBE_COLLIDER, CAPSULE_COLLIDER>(const uint32_t a,
+                                                                    const uint32_t b,
+                                                                    sPairCache *pair_cache,
+                                                                    sNarrowphaseResult *result) {
+    sVector3 start = {}, end = {};
+    get_capsule_segment(b, &start, &end);
+
+    // The normal goes from the box to the capsule
+    return CAPSULE::capsule_OBB_collision(start,
+                                          end,
+                                          transforms[b].scale.x,
+                                          transforms[a],
+                                          &result->normal,
+                                          result->contact_points,
+                                          result->contact_depth,
+                                          &result->contact_count,
+                                          &result->separation);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<HULL_COLLIDER, CAPSULE_COLLIDER>(const uint32_t a,
+                                                                    const uint32_t b,
+                                                                    sPairCache *pair_cache,
+                                                                    sNarrowphaseResult *result) {
+    sVector3 start = {}, end = {};
+    get_capsule_segment(b, &start, &end);
+
+    // GJK with the segment, warm started as the spheres
+    // The normal goes from the hull to the capsule
+    return CAPSULE::capsule_hull_collision(start,
+                                           end,
+                                           transforms[b].scale.x,
+                                           get_collider_mesh(a),
+                                           pair_cache->get_support_vertex(dense_to_slot[a]),
+                                           pair_cache->get_simplex_cache(dense_to_slot[a]),
+                                           &result->normal,
+                                           result->contact_points,
+                                           result->contact_depth,
+                                           &result->contact_count,
+                                           &result->separation);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<CUBE_COLLIDER, CUBE_COLLIDER>(const uint32_t a,
+                                                                 const uint32_t b,
+                                                                 sPairCache *pair_cache,
+                                                                 sNarrowphaseResult *result) {
+    // Closed form box test, without the meshes
+    return OBB::OBB_OBB_collision(transforms[a],
+                                  transforms[b],
+                                  &result->normal,
+                                  result->contact_points,
+                                  result->contact_depth,
+                                  &result->contact_count,
+                                  &result->separation);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<HULL_COLLIDER, HULL_COLLIDER>(const uint32_t a,
+                                                                 const uint32_t b,
+                                                                 sPairCache *pair_cache,
+                                                                 sNarrowphaseResult *result) {
+    // The normal goes from the hull a to the hull b
+    // The support queries and the first axis are warm started from the last frame
+    if (SAT::SAT_collision_test(get_collider_mesh(a),
+                                get_collider_mesh(b),
+                                &result->normal,
+                                result->contact_points,
+                                result->contact_depth,
+                                &result->contact_count,
+                                pair_cache->get_support_vertex(dense_to_slot[a]),
+                                pair_cache->get_support_vertex(dense_to_slot[b]),
+                                pair_cache->get_sat_axis_cache(dense_to_slot[a]))) {
+        return true;
+    }
+
+    result->separation = pair_cache->sat_axis.separation;
+    return false;
+}
+
+// The boxes have a hull too
+template<>
+inline bool sPhysWorld::test_kernel<CUBE_COLLIDER, HULL_COLLIDER>(const uint32_t a,
+                                                                 const uint32_t b,
+                                                                 sPairCache *pair_cache,
+                                                                 sNarrowphaseResult *result) {
+    return test_kernel<HULL_COLLIDER, HULL_COLLIDER>(a, b, pair_cache, result);
+}
+
+// The triangle meshes and the heightfields test all the shapes the same way,
+// the normal goes from the mesh to the body
+template<>
+inline bool sPhysWorld::test_kernel<TRIANGLE_MESH_COLLIDER, SPHERE_COLLIDER>(const uint32_t a,
+                                                                            const uint32_t b,
+                                                                            sPairCache *pair_cache,
+                                                                            sNarrowphaseResult *result) {
+    return test_triangle_mesh_collision(a, b, result);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<TRIANGLE_MESH_COLLIDER, CUBE_COLLIDER>(const uint32_t a,
+                                                                          const uint32_t b,
+                                                                          sPairCache *pair_cache,
+                                                                          sNarrowphaseResult *result) {
+    return test_triangle_mesh_collision(a, b, result);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<TRIANGLE_MESH_COLLIDER, CAPSULE_COLLIDER>(const uint32_t a,
+                                                                             const uint32_t b,
+                                                                             sPairCache *pair_cache,
+                                                                             sNarrowphaseResult *result) {
+    return test_triangle_mesh_collision(a, b, result);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<TRIANGLE_MESH_COLLIDER, HULL_COLLIDER>(const uint32_t a,
+                                                                          const uint32_t b,
+                                                                          sPairCache *pair_cache,
+                                                                          sNarrowphaseResult *result) {
+    return test_triangle_mesh_collision(a, b, result);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<HEIGHTFIELD_COLLIDER, SPHERE_COLLIDER>(const uint32_t a,
+                                                                          const uint32_t b,
+                                                                          sPairCache *pair_cache,
+                                                                          sNarrowphaseResult *result) {
+    return test_heightfield_collision(a, b, result);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<HEIGHTFIELD_COLLIDER, CUBE_COLLIDER>(const uint32_t a,
+                                                                        const uint32_t b,
+                                                                        sPairCache *pair_cache,
+                                                                        sNarrowphaseResult *result) {
+    return test_heightfield_collision(a, b, result);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<HEIGHTFIELD_COLLIDER, CAPSULE_COLLIDER>(const uint32_t a,
+                                                                           const uint32_t b,
+                                                                           sPairCache *pair_cache,
+                                                                           sNarrowphaseResult *result) {
+    return test_heightfield_collision(a, b, result);
+}
+
+template<>
+inline bool sPhysWorld::test_kernel<HEIGHTFIELD_COLLIDER, HULL_COLLIDER>(const uint32_t a,
+                                                                        const uint32_t b,
+                                                                        sPairCache *pair_cache,
+                                                                        sNarrowphaseResult *result) {
+    return test_heightfield_collision(a, b, result);
+}
+
+// The pairs without a kernel are never tested: the planes and the compounds
+// have their own paths, and the static colliders do not collide between them
+inline void sPhysWorld::init_narrowphase_kernels() {
+    for(uint32_t shape_1 = 0; shape_1 < COLLIDER_COUNT; shape_1++) {
+        for(uint32_t shape_2 = 0; shape_2 < COLLIDER_COUNT; shape_2++) {
+            pair_tests[shape_1][shape_2] = NULL;
+            pair_bucket_tests[shape_1][shape_2] = NULL;
+        }
+    }
+
+    add_narrowphase_kernel<SPHERE_COLLIDER, SPHERE_COLLIDER>();
+    add_narrowphase_kernel<CUBE_COLLIDER, SPHERE_COLLIDER>();
+    add_narrowphase_kernel<HULL_COLLIDER, SPHERE_COLLIDER>();
+    add_narrowphase_kernel<CAPSULE_COLLIDER, SPHERE_COLLIDER>();
+    add_narrowphase_kernel<CAPSULE_COLLIDER, CAPSULE_COLLIDER>();
+    add_narrowphase_kernel<CUBE_COLLIDER, CAPSULE_COLLIDER>();
+    add_narrowphase_kernel<HULL_COLLIDER, CAPSULE_COLLIDER>();
+    add_narrowphase_kernel<CUBE_COLLIDER, CUBE_COLLIDER>();
+    add_narrowphase_kernel<CUBE_COLLIDER, HULL_COLLIDER>();
+    add_narrowphase_kernel<HULL_COLLIDER, HULL_COLLIDER>();
+
+    add_narrowphase_kernel<TRIANGLE_MESH_COLLIDER, SPHERE_COLLIDER>();
+    add_narrowphase_kernel<TRIANGLE_MESH_COLLIDER, CUBE_COLLIDER>();
+    add_narrowphase_kernel<TRIANGLE_MESH_COLLIDER, CAPSULE_COLLIDER>();
+    add_narrowphase_kernel<TRIANGLE_MESH_COLLIDER, HULL_COLLIDER>();
+
+    add_narrowphase_kernel<HEIGHTFIELD_COLLIDER, SPHERE_COLLIDER>();
+    add_narrowphase_kernel<HEIGHTFIELD_COLLIDER, CUBE_COLLIDER>();
+    add_narrowphase_kernel<HEIGHTFIELD_COLLIDER, CAPSULE_COLLIDER>();
+    add_narrowphase_kernel<HEIGHTFIELD_COLLIDER, HULL_COLLIDER>();
+}
+
 #endif // PHYSICS_H_
@@ -0,0 +1,492 @@
+#ifndef QUICKHULL_H_
+#define QUICKHULL_H_
+
+#include "half_edge_hull.h"
+#include "math.h"
+#include "vector.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+//**
+// Quickhull
+// Convex hull builder, based on Barber, Dobkin & Huhdanpaa's Quickhull
+// Starts from a tetrahedron of extreme points, and on each iteration adds
+// the furthest outside point of a face, replacing the faces visible from it
+// by a cone of new faces to the horizon.
+// The iterations stop when there are no points left outside, or when the
+// hull reaches the vertex budget (the result is then the hull of a subset
+// of the points).
+// The coplanar triangles of the result are merged into convex polygons,
+// and the faces are outward and counter clockwise
+// */
+
+#define QUICKHULL_NULL 0xFFFFFFFF
+// Max deviation between the normals of merged faces (1 - cos of the angle)
+#define QUICKHULL_COPLANAR_EPSILON 0.0001f
+
+namespace quickhull {
+
+    struct sHullFace {
+        uint32_t  vertices[3] = {};
+        sVector3  normal = {};
+        float     plane_distance = 0.0f;
+
+        // Linked list of the points outside of the face
+        uint32_t  outside_head = QUICKHULL_NULL;
+        bool      is_removed = false;
+
+        inline float distance(const sVector3 &point) const {
+            return dot_prod(normal, point) - plane_distance;
+        }
+    };
+
+    struct sHullBuilder {
+        const sVector3  *points = NULL;
+        uint32_t        point_count = 0;
+        // Next point on the outside list of its face
+        uint32_t        *next_outside = NULL;
+
+        sHullFace       *faces = NULL;
+        uint32_t        face_count = 0;
+        uint32_t        face_capacity = 0;
+
+        // Point that is allways inside the hull, to orient the faces
+        sVector3        interior_point = {};
+        float           epsilon = 0.0f;
+
+        inline uint32_t add_face(const uint32_t v0,
+                                 const uint32_t v1,
+                                 const uint32_t v2) {
+            if (face_count == face_capacity) {
+                face_capacity *= 2;
+                faces = (sHullFace*) realloc(faces, sizeof(sHullFace) * face_capacity);
+            }
+
+            sHullFace &face = faces[face_count];
+            face = sHullFace{};
+            face.vertices[0] = v0;
+            face.vertices[1] = v1;
+            face.vertices[2] = v2;
+
+            const sVector3 edge1 = points[v1].subs(points[v0]);
+            const sVector3 edge2 = points[v2].subs(points[v0]);
+            face.normal = cross_prod(edge1, edge2).normalize();
+
+            // Flip the face if its facing inwards
+            if (dot_prod(face.normal, points[v0].subs(interior_point)) < 0.0f) {
+                face.vertices[1] = v2;
+                face.vertices[2] = v1;
+                face.normal = face.normal.invert();
+            }
+            face.plane_distance = dot_prod(face.normal, points[v0]);
+
+            return face_count++;
+        }
+
+        // Assign the point to the first face that is in front of it
+        // If there is none, the point is inside the hull, and discarded
+        inline void assign_point(const uint32_t point,
+                                 const uint32_t first_face) {
+            for(uint32_t i = first_face; i < face_count; i++) {
+                if (faces[i].is_removed) {
+                    continue;
+                }
+
+                if (faces[i].distance(points[point]) > epsilon) {
+                    next_outside[point] = faces[i].outside_head;
+                    faces[i].outside_head = point;
+                    return;
+                }
+            }
+        }
+
+        inline bool has_edge(const sHullFace &face,
+                             const uint32_t from,
+                             const uint32_t to) const {
+            for(uint32_t k = 0; k < 3; k++) {
+                if (face.vertices[k] == from && face.vertices[(k + 1) % 3] == to) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Returns false if the points are degenerate (coplanar)
+        bool build_initial_tetrahedron() {
+            // Extreme points on each axis
+            uint32_t extremes[6] = {0, 0, 0, 0, 0, 0};
+            for(uint32_t i = 1; i < point_count; i++) {
+                for(int axis = 0; axis < 3; axis++) {
+                    if (points[i].raw_values[axis] < points[extremes[axis * 2]].raw_values[axis]) {
+                        extremes[axis * 2] = i;
+                    }
+                    if (points[i].raw_values[axis] > points[extremes[(axis * 2) + 1]].raw_values[axis]) {
+                        extremes[(axis * 2) + 1] = i;
+                    }
+                }
+            }
+
+            // The scale of the epsilon depends on the size of the point cloud
+            float max_extent = 0.0f;
+            for(int axis = 0; axis < 3; axis++) {
+                const float extent = points[extremes[(axis * 2) + 1]].raw_values[axis] - points[extremes[axis * 2]].raw_values[axis];
+                max_extent = MAX(max_extent, extent);
+            }
+            epsilon = 30.0f * FLT_EPSILON * max_extent;
+
+            // The two most separated extremes
+            uint32_t v0 = 0, v1 = 0;
+            float best = -1.0f;
+            for(uint32_t i = 0; i < 6; i++) {
+                for(uint32_t j = i + 1; j < 6; j++) {
+                    const float distance = points[extremes[i]].subs(points[extremes[j]]).magnitude();
+                    if (distance > best) {
+                        best = distance;
+                        v0 = extremes[i];
+                        v1 = extremes[j];
+                    }
+                }
+            }
+
+            // The furthest point from the line
+            const sVector3 line = points[v1].subs(points[v0]).normalize();
+            uint32_t v2 = 0;
+            best = -1.0f;
+            for(uint32_t i = 0; i < point_count; i++) {
+                const float distance = cross_prod(points[i].subs(points[v0]), line).magnitude();
+                if (distance > best) {
+                    best = distance;
+                    v2 = i;
+                }
+            }
+            if (best <= epsilon) {
+                return false;
+            }
+
+            // The furthest point from the plane
+            const sVector3 plane_normal = cross_prod(points[v1].subs(points[v0]), points[v2].subs(points[v0])).normalize();
+            uint32_t v3 = 0;
+            best = -1.0f;
+            for(uint32_t i = 0; i < point_count; i++) {
+                const float distance = fabsf(dot_prod(points[i].subs(points[v0]), plane_normal));
+                if (distance > best) {
+                    best = distance;
+                    v3 = i;
+                }
+            }
+            if (best <= epsilon) {
+                return false;
+            }
+
+            interior_point = points[v0].sum(points[v1]).sum(points[v2]).sum(points[v3]).mult(0.25f);
+
+            add_face(v0, v1, v2);
+            add_face(v0, v1, v3);
+            add_face(v0, v2, v3);
+            add_face(v1, v2, v3);
+
+            for(uint32_t i = 0; i < point_count; i++) {
+                if (i == v0 || i == v1 || i == v2 || i == v3) {
+                    continue;
+                }
+                assign_point(i, 0);
+            }
+
+            return true;
+        }
+
+        // Add the furthest point of the face to the hull
+        void add_point_of_face(const uint32_t face_id,
+                               uint32_t *horizon,
+                               uint32_t *visible) {
+            // Furthest point of the face
+            uint32_t eye = faces[face_id].outside_head;
+            float best = faces[face_id].distance(points[eye]);
+            for(uint32_t it = next_outside[eye]; it != QUICKHULL_NULL; it = next_outside[it]) {
+                const float distance = faces[face_id].distance(points[it]);
+                if (distance > best) {
+                    best = distance;
+                    eye = it;
+                }
+            }
+
+            // Faces visible from the point
+            uint32_t visible_count = 0;
+            for(uint32_t i = 0; i < face_count; i++) {
+                if (!faces[i].is_removed && faces[i].distance(points[eye]) > epsilon) {
+                    visible[visible_count++] = i;
+                }
+            }
+
+            // The horizon are the edges of the visible faces, whose
+            // opposite edge is not on another visible face
+            uint32_t horizon_count = 0;
+            for(uint32_t i = 0; i < visible_count; i++) {
+                const sHullFace &face = faces[visible[i]];
+                for(uint32_t k = 0; k < 3; k++) {
+                    const uint32_t from = face.vertices[k];
+                    const uint32_t to = face.vertices[(k + 1) % 3];
+
+                    bool is_shared = false;
+                    for(uint32_t j = 0; j < visible_count && !is_shared; j++) {
+                        is_shared = (j != i) && has_edge(faces[visible[j]], to, from);
+                    }
+
+                    if (!is_shared) {
+                        horizon[(horizon_count * 2)] = from;
+                        horizon[(horizon_count * 2) + 1] = to;
+                        horizon_count++;
+                    }
+                }
+            }
+
+            for(uint32_t i = 0; i < visible_count; i++) {
+                faces[visible[i]].is_removed = true;
+            }
+
+            // Cone of new faces from the horizon to the point
+            const uint32_t first_new_face = face_count;
+            for(uint32_t i = 0; i < horizon_count; i++) {
+                add_face(horizon[i * 2], horizon[(i * 2) + 1], eye);
+            }
+
+            // Reassign the orphaned points to the new faces
+            for(uint32_t i = 0; i < visible_count; i++) {
+                uint32_t it = faces[visible[i]].outside_head;
+                while(it != QUICKHULL_NULL) {
+                    const uint32_t next = next_outside[it];
+                    if (it != eye) {
+                        assign_point(it, first_new_face);
+                    }
+                    it = next;
+                }
+                faces[visible[i]].outside_head = QUICKHULL_NULL;
+            }
+        }
+    };
+
+    // Merge the neighbouring coplanar faces of the hull, via a flood fill
+    // from each face that is not merged yet. The faces are compared against
+    // the plane of the seed face, so the merged faces cannot bend.
+    // The vertices that end up inside of a merged face are removed
+    inline void merge_coplanar_faces(const sHalfEdgeHull &hull,
+                                     const float plane_epsilon,
+                                     sHalfEdgeHull *result) {
+        sVector3 *face_normals = (sVector3*) malloc(sizeof(sVector3) * hull.face_count);
+        uint32_t *face_group = (uint32_t*) malloc(sizeof(uint32_t) * hull.face_count);
+        uint32_t *face_stack = (uint32_t*) malloc(sizeof(uint32_t) * hull.face_count);
+
+        for(uint32_t face = 0; face < hull.face_count; face++) {
+            const uint32_t start = hull.face_offsets[face];
+            const sVector3 &v0 = hull.vertices[hull.half_edges[start].origin];
+            const sVector3 &v1 = hull.vertices[hull.half_edges[start + 1].origin];
+            const sVector3 &v2 = hull.vertices[hull.half_edges[start + 2].origin];
+
+            face_normals[face] = cross_prod(v1.subs(v0), v2.subs(v0)).normalize();
+            face_group[face] = QUICKHULL_NULL;
+        }
+
+        uint32_t group_count = 0;
+        uint32_t *group_seeds = (uint32_t*) malloc(sizeof(uint32_t) * hull.face_count);
+
+        for(uint32_t seed = 0; seed < hull.face_count; seed++) {
+            if (face_group[seed] != QUICKHULL_NULL) {
+                continue;
+            }
+
+            const uint32_t group = group_count++;
+            const sVector3 &seed_origin = hull.vertices[hull.half_edges[hull.face_offsets[seed]].origin];
+            group_seeds[group] = seed;
+            face_group[seed] = group;
+
+            uint32_t stack_size = 0;
+            face_stack[stack_size++] = seed;
+
+            while(stack_size > 0) {
+                const uint32_t face = face_stack[--stack_size];
+
+                for(uint32_t h = hull.face_offsets[face]; h < hull.face_offsets[face + 1]; h++) {
+                    const uint32_t neighbour = hull.get_neighbour_face(h);
+
+                    if (neighbour == HALF_EDGE_NULL || face_group[neighbour] != QUICKHULL_NULL) {
+                        continue;
+                    }
+
+                    if (1.0f - dot_prod(face_normals[seed], face_normals[neighbour]) > QUICKHULL_COPLANAR_EPSILON) {
+                        continue;
+                    }
+
+                    bool is_on_plane = true;
+                    for(uint32_t k = hull.face_offsets[neighbour]; k < hull.face_offsets[neighbour + 1] && is_on_plane; k++) {
+                        const sVector3 &vertex = hull.vertices[hull.half_edges[k].origin];
+                        is_on_plane = fabsf(dot_prod(face_normals[seed], vertex.subs(seed_origin))) <= plane_epsilon;
+                    }
+
+                    if (is_on_plane) {
+                        face_group[neighbour] = group;
+                        face_stack[stack_size++] = neighbour;
+                    }
+                }
+            }
+        }
+
+        // Walk the boundary of each group: from the end of a boundary
+        // half-edge, rotate arround the vertex, inside of the group,
+        // until the next boundary half-edge
+        uint32_t *face_indices = (uint32_t*) malloc(sizeof(uint32_t) * hull.half_edge_count);
+        uint32_t *face_offsets = (uint32_t*) malloc(sizeof(uint32_t) * (group_count + 1));
+        uint32_t *vertex_remap = (uint32_t*) malloc(sizeof(uint32_t) * hull.vertex_count);
+        sVector3 *vertices = (sVector3*) malloc(sizeof(sVector3) * hull.vertex_count);
+        uint32_t index_count = 0, vertex_count = 0;
+
+        memset(vertex_remap, 0xFF, sizeof(uint32_t) * hull.vertex_count);
+
+        for(uint32_t group = 0; group < group_count; group++) {
+            face_offsets[group] = index_count;
+
+            // Find the first boundary half-edge of the group
+            uint32_t first_edge = QUICKHULL_NULL;
+            for(uint32_t face = group_seeds[group]; face < hull.face_count && first_edge == QUICKHULL_NULL; face++) {
+                if (face_group[face] != group) {
+                    continue;
+                }
+
+                for(uint32_t h = hull.face_offsets[face]; h < hull.face_offsets[face + 1]; h++) {
+                    const uint32_t neighbour = hull.get_neighbour_face(h);
+                    if (neighbour == HALF_EDGE_NULL || face_group[neighbour] != group) {
+                        first_edge = h;
+                        break;
+                    }
+                }
+            }
+
+            uint32_t edge = first_edge;
+            do {
+                const uint32_t vertex = hull.half_edges[edge].origin;
+                if (vertex_remap[vertex] == QUICKHULL_NULL) {
+                    vertex_remap[vertex] = vertex_count;
+                    vertices[vertex_count++] = hull.vertices[vertex];
+                }
+                face_indices[index_count++] = vertex_remap[vertex];
+
+                edge = hull.half_edges[edge].next;
+                while(hull.half_edges[edge].twin != HALF_EDGE_NULL && face_group[hull.get_neighbour_face(edge)] == group) {
+                    edge = hull.half_edges[hull.half_edges[edge].twin].next;
+                }
+            } while(edge != first_edge);
+        }
+        face_offsets[group_count] = index_count;
+
+        result->init(vertices, vertex_count, face_indices, face_offsets, group_count);
+
+        free(face_normals);
+        free(face_group);
+        free(face_stack);
+        free(group_seeds);
+        free(face_indices);
+        free(face_offsets);
+        free(vertex_remap);
+        free(vertices);
+    }
+
+    // Build the convex hull of the points, with at most max_vertices vertices
+    // Returns false if the points are degenerate (less than 4 non coplanar points)
+    inline bool build_hull(const sVector3 *points,
+                           const uint32_t point_count,
+                           const uint32_t max_vertices,
+                           sHalfEdgeHull *result) {
+        if (point_count < 4 || max_vertices < 4) {
+            return false;
+        }
+
+        sHullBuilder builder = {};
+        builder.points = points;
+        builder.point_count = point_count;
+        builder.next_outside = (uint32_t*) malloc(sizeof(uint32_t) * point_count);
+        builder.face_capacity = 64;
+        builder.faces = (sHullFace*) malloc(sizeof(sHullFace) * builder.face_capacity);
+
+        if (!builder.build_initial_tetrahedron()) {
+            free(builder.next_outside);
+            free(builder.faces);
+            return false;
+        }
+
+        // Scratch for the horizon & visible faces, the hull of n vertices
+        // has at most 2n - 4 faces and 3n - 6 edges
+        uint32_t *horizon = (uint32_t*) malloc(sizeof(uint32_t) * 2 * 3 * point_count);
+        uint32_t *visible = (uint32_t*) malloc(sizeof(uint32_t) * 2 * point_count * 4);
+        uint32_t visible_capacity = 2 * point_count * 4;
+
+        uint32_t hull_vertex_count = 4;
+        uint32_t face_id = 0;
+        while(hull_vertex_count < max_vertices) {
+            // Find a face with outside points
+            for(; face_id < builder.face_count; face_id++) {
+                if (!builder.faces[face_id].is_removed && builder.faces[face_id].outside_head != QUICKHULL_NULL) {
+                    break;
+                }
+            }
+            if (face_id == builder.face_count) {
+                break;
+            }
+
+            if (visible_capacity < builder.face_count) {
+                visible_capacity = builder.face_count * 2;
+                visible = (uint32_t*) realloc(visible, sizeof(uint32_t) * visible_capacity);
+            }
+
+            builder.add_point_of_face(face_id, horizon, visible);
+            hull_vertex_count++;
+        }
+
+        // Compact the vertices & faces of the hull
+        uint32_t *vertex_remap = (uint32_t*) malloc(sizeof(uint32_t) * point_count);
+        memset(vertex_remap, 0xFF, sizeof(uint32_t) * point_count);
+
+        sVector3 *hull_vertices = (sVector3*) malloc(sizeof(sVector3) * point_count);
+        uint32_t *face_indices = (uint32_t*) malloc(sizeof(uint32_t) * 3 * builder.face_count);
+        uint32_t *face_offsets = (uint32_t*) malloc(sizeof(uint32_t) * (builder.face_count + 1));
+        uint32_t vertex_count = 0, hull_face_count = 0;
+
+        for(uint32_t i = 0; i < builder.face_count; i++) {
+            if (builder.faces[i].is_removed) {
+                continue;
+            }
+
+            face_offsets[hull_face_count] = hull_face_count * 3;
+            for(uint32_t k = 0; k < 3; k++) {
+                const uint32_t vertex = builder.faces[i].vertices[k];
+                if (vertex_remap[vertex] == QUICKHULL_NULL) {
+                    vertex_remap[vertex] = vertex_count;
+                    hull_vertices[vertex_count++] = points[vertex];
+                }
+                face_indices[(hull_face_count * 3) + k] = vertex_remap[vertex];
+            }
+            hull_face_count++;
+        }
+        face_offsets[hull_face_count] = hull_face_count * 3;
+
+        sHalfEdgeHull triangle_hull = {};
+        triangle_hull.init(hull_vertices, vertex_count, face_indices, face_offsets, hull_face_count);
+        merge_coplanar_faces(triangle_hull, builder.epsilon * 10.0f, result);
+        triangle_hull.clean();
+
+        free(vertex_remap);
+        free(hull_vertices);
+        free(face_indices);
+        free(face_offsets);
+        free(horizon);
+        free(visible);
+        free(builder.next_outside);
+        free(builder.faces);
+
+        return true;
+    }
+};
+
+#endif // QUICKHULL_H_
@@ -14,12 +14,18 @@
 
 // TODO: check all the pointer deferencing with the refactor :(
 
+#define SAT_AXIS_CACHE_TOLERANCE 0.0005f
+
 namespace SAT {
 
     /* Find the smallest distance of the nearest point on mesh2
-     * to one of the faces of mesh1 */
+     * to one of the faces of mesh1
+     * The support queries on mesh2 are hill climbing, starting on the
+     * support of the previous face (and of the previous frame, via
+     * support_vertex) */
     inline bool test_face_face_collision(const sColliderMesh &mesh1,
                                          const sColliderMesh &mesh2,
+                                         uint32_t *support_vertex,
                                          uint32_t *face_collision_index,
                                          float *collision_distance) {
         float largest_distance = -FLT_MAX;
@@ -27,7 +33,7 @@ namespace SAT {
 
         for(uint32_t i = 0; i < mesh1.face_count; i++) {
             sPlane face_plane = mesh1.get_plane_of_face(i);
-            sVector3 support_mesh2 = mesh2.get_support(face_plane.normal.invert());
+            sVector3 support_mesh2 = mesh2.get_support(face_plane.normal.invert(), support_vertex);
 
             float distance = face_plane.distance(support_mesh2);
             if (largest_distance < distance) {
@@ -101,26 +107,32 @@ namespace SAT {
         return true;
     }
 
+    // Test the cross products of the unique edge directions of both meshes,
+    // projecting both meshes on each axis
     inline bool test_edge_edge_collision(const sColliderMesh &mesh1,
                                          const sColliderMesh &mesh2,
+                                         sVector3 *collision_axis,
+                                         float *distance,
                                          uint32_t *collision_edge1,
-                                         uint32_t *collision_edge2,
-                                         float *distance) {
+                                         uint32_t *collision_edge2) {
         float largest_distance = -FLT_MAX;
-        uint32_t smallest_edge1 = 0;
-        uint32_t smallest_edge2 = 0;
-        for(uint32_t i_edge1 = 0; mesh1.edge_cout > i_edge1; i_edge1++) {
-            sVector3 edge1 = mesh1.get_edge(i_edge1).normalize();
+        sVector3 largest_axis = {0.0f, 0.0f, 0.0f};
+        *collision_edge1 = 0;
+        *collision_edge2 = 0;
+        for(uint32_t i_edge1 = 0; mesh1.edge_direction_count > i_edge1; i_edge1++) {
+            const sVector3 &edge1 = mesh1.edge_directions[i_edge1];
 
-            for(uint32_t i_edge2 = 0; mesh2.edge_cout > i_edge2; i_edge2++) {
-                sVector3 edge2 = mesh2.get_edge(i_edge2).normalize();
+            for(uint32_t i_edge2 = 0; mesh2.edge_direction_count > i_edge2; i_edge2++) {
+                const sVector3 &edge2 = mesh2.edge_directions[i_edge2];
 
                 sVector3 new_axis = cross_prod(edge1, edge2);
+                const float axis_len = new_axis.magnitude();
 
                 // Avoid test if the cross product are facing on the same direction
-                if (new_axis.magnitude() < 0.0001f) {
+                if (axis_len < 0.0001f) {
                     continue;
                 }
+                new_axis = new_axis.mult(1.0f / axis_len);
 
                 float mesh1_max, mesh1_min;
                 float mesh2_max, mesh2_min;
@@ -133,19 +145,114 @@ namespace SAT {
                                            new_axis,
                                            &mesh2_min,
                                            &mesh2_max);
-                float total_projection = MAX(mesh1_max, mesh2_max) - MIN(mesh1_min, mesh2_min);
-                float penetration_on_axis = total_projection - ((mesh1_max - mesh1_min) + (mesh2_max - mesh2_min));
+                // Gap between the intervals, on the best of both directions
+                float penetration_on_axis = MAX(mesh2_min - mesh1_max, mesh1_min - mesh2_max);
 
                 if (largest_distance < penetration_on_axis) {
                     largest_distance = penetration_on_axis;
-                    smallest_edge1 = i_edge1;
-                    smallest_edge2 = i_edge2;
+                    largest_axis = new_axis;
+                    *collision_edge1 = i_edge1;
+                    *collision_edge2 = i_edge2;
+                }
+
+                // Early out on a separating axis
+                if (penetration_on_axis > 0.0f) {
+                    *collision_axis = largest_axis;
+                    *distance = largest_distance;
+                    return false;
+                }
+            }
+        }
+
+        *collision_axis = largest_axis;
+        *distance = largest_distance;
+        return (largest_distance <= 0.0f);
+    }
+
+    // Two edges form a face of the Minkowski difference if their arcs on the
+    // Gauss map intersect. The arc of an edge goes between the normals of its
+    // two faces (a, b and c, d), and the arcs of mesh2 are negated (-c, -d)
+    inline bool is_minkowski_face(const sVector3 &a,
+                                  const sVector3 &b,
+                                  const sVector3 &b_x_a,
+                                  const sVector3 &c,
+                                  const sVector3 &d,
+                                  const sVector3 &d_x_c) {
+        const float cba = dot_prod(c, b_x_a);
+        const float dba = dot_prod(d, b_x_a);
+        const float adc = dot_prod(a, d_x_c);
+        const float bdc = dot_prod(b, d_x_c);
+
+        // The arcs intersect if c & d are on different sides of the plane of
+        // a & b, a & b are on different sides of the plane of c & d, and they
+        // are on the same hemisphere
+        return (cba * dba < 0.0f) && (adc * bdc < 0.0f) && (cba * bdc > 0.0f);
+    }
+
+    // Edge phase via the Gauss map: only the edge pairs that build a face on
+    // the Minkowski difference can be separating axes, and their separation
+    // is the distance between the edges along the axis, so there is no need
+    // for projecting the meshes.
+    // Needs closed meshes, with the faces of each edge
+    inline bool test_edge_edge_gauss_map_collision(const sColliderMesh &mesh1,
+                                                   const sColliderMesh &mesh2,
+                                                   sVector3 *collision_axis,
+                                                   float *distance,
+                                                   uint32_t *collision_edge1,
+                                                   uint32_t *collision_edge2) {
+        float largest_distance = -FLT_MAX;
+        sVector3 largest_axis = {0.0f, 0.0f, 0.0f};
+        *collision_edge1 = 0;
+        *collision_edge2 = 0;
+
+        for(uint32_t i_edge1 = 0; i_edge1 < mesh1.edge_cout; i_edge1++) {
+            const sVector3 &a = mesh1.normals[mesh1.edge_faces[i_edge1].x];
+            const sVector3 &b = mesh1.normals[mesh1.edge_faces[i_edge1].y];
+            const sVector3 b_x_a = cross_prod(b, a);
+            const sVector3 &edge1_origin = mesh1.vertices[mesh1.edges[i_edge1].x];
+            const sVector3 edge1 = mesh1.get_edge(i_edge1);
+
+            for(uint32_t i_edge2 = 0; i_edge2 < mesh2.edge_cout; i_edge2++) {
+                const sVector3 c = mesh2.normals[mesh2.edge_faces[i_edge2].x].invert();
+                const sVector3 d = mesh2.normals[mesh2.edge_faces[i_edge2].y].invert();
+
+                if (!is_minkowski_face(a, b, b_x_a, c, d, cross_prod(d, c))) {
+                    continue;
+                }
+
+                sVector3 new_axis = cross_prod(edge1, mesh2.get_edge(i_edge2));
+                const float axis_len = new_axis.magnitude();
+
+                // Skip the parallel edges
+                if (axis_len < 0.0001f * edge1.magnitude()) {
+                    continue;
+                }
+                new_axis = new_axis.mult(1.0f / axis_len);
+
+                // Make the axis go from mesh1 to mesh2
+                if (dot_prod(new_axis, edge1_origin.subs(mesh1.mesh_center)) < 0.0f) {
+                    new_axis = new_axis.invert();
+                }
+
+                const float separation = dot_prod(new_axis, mesh2.vertices[mesh2.edges[i_edge2].x].subs(edge1_origin));
+
+                if (largest_distance < separation) {
+                    largest_distance = separation;
+                    largest_axis = new_axis;
+                    *collision_edge1 = i_edge1;
+                    *collision_edge2 = i_edge2;
+                }
+
+                // Early out on a separating axis
+                if (separation > 0.0f) {
+                    *collision_axis = largest_axis;
+                    *distance = largest_distance;
+                    return false;
                 }
             }
         }
 
-        *collision_edge1 = smallest_edge1;
-        *collision_edge2 = smallest_edge2;
+        *collision_axis = largest_axis;
         *distance = largest_distance;
         return (largest_distance <= 0.0f);
     }
@@ -158,26 +265,238 @@ namespace SAT {
        NONE
     };
 
+    /**
+     * Last separating (or least penetrating) axis of a pair, by its features:
+     * a face of one of the meshes, or a pair of edges (half edges with the
+     * Gauss map, unique edge directions without it).
+     * It is tested first on the next frame
+     */
+    struct sSATAxisCache {
+        eCollisionType  type = NONE;
+        uint32_t        index1 = 0;
+        uint32_t        index2 = 0;
+        float           separation = 0.0f;
+
+        // For swapping the order of the meshes
+        inline void swap_meshes() {
+            if (type == FACE_1_COL) {
+                type = FACE_2_COL;
+            } else if (type == FACE_2_COL) {
+                type = FACE_1_COL;
+            } else if (type == EDGE_EDGE_COL) {
+                const uint32_t tmp = index1;
+                index1 = index2;
+                index2 = tmp;
+            }
+        }
+    };
+
+    // Separation of a face of the reference mesh with the other mesh
+    inline float get_face_axis_separation(const sColliderMesh &reference_mesh,
+                                          const uint32_t face,
+                                          const sColliderMesh &other_mesh,
+                                          uint32_t *support_vertex) {
+        const sPlane face_plane = reference_mesh.get_plane_of_face(face);
+        return face_plane.distance(other_mesh.get_support(face_plane.normal.invert(), support_vertex));
+    }
+
+    // Separation along the cross product of two edges; with the same edges
+    // as the edge test of the meshes. Returns false if it is not a valid
+    // axis anymore (parallel edges, or not a face of the Minkowski difference)
+    inline bool get_edge_axis_separation(const sColliderMesh &mesh1,
+                                         const uint32_t edge1_index,
+                                         const sColliderMesh &mesh2,
+                                         const uint32_t edge2_index,
+                                         sVector3 *axis,
+                                         float *separation) {
+        if (mesh1.vertex_adjacency_offsets != NULL && mesh2.vertex_adjacency_offsets != NULL) {
+            if (edge1_index >= mesh1.edge_cout || edge2_index >= mesh2.edge_cout) {
+                return false;
+            }
+
+            const sVector3 &a = mesh1.normals[mesh1.edge_faces[edge1_index].x];
+            const sVector3 &b = mesh1.normals[mesh1.edge_faces[edge1_index].y];
+            const sVector3 c = mesh2.normals[mesh2.edge_faces[edge2_index].x].invert();
+            const sVector3 d = mesh2.normals[mesh2.edge_faces[edge2_index].y].invert();
 
+            if (!is_minkowski_face(a, b, cross_prod(b, a), c, d, cross_prod(d, c))) {
+                return false;
+            }
+
+            const sVector3 &edge1_origin = mesh1.vertices[mesh1.edges[edge1_index].x];
+            const sVector3 edge1 = mesh1.get_edge(edge1_index);
+            sVector3 new_axis = cross_prod(edge1, mesh2.get_edge(edge2_index));
+            const float axis_len = new_axis.magnitude();
+
+            if (axis_len < 0.0001f * edge1.magnitude()) {
+                return false;
+            }
+            new_axis = new_axis.mult(1.0f / axis_len);
+
+            if (dot_prod(new_axis, edge1_origin.subs(mesh1.mesh_center)) < 0.0f) {
+                new_axis = new_axis.invert();
+            }
+
+            *axis = new_axis;
+            *separation = dot_prod(new_axis, mesh2.vertices[mesh2.edges[edge2_index].x].subs(edge1_origin));
+            return true;
+        }
+
+        if (edge1_index >= mesh1.edge_direction_count || edge2_index >= mesh2.edge_direction_count) {
+            return false;
+        }
+
+        sVector3 new_axis = cross_prod(mesh1.edge_directions[edge1_index], mesh2.edge_directions[edge2_index]);
+        const float axis_len = new_axis.magnitude();
+        if (axis_len < 0.0001f) {
+            return false;
+        }
+        new_axis = new_axis.mult(1.0f / axis_len);
+
+        float mesh1_min, mesh1_max, mesh2_min, mesh2_max;
+        get_bounds_of_mesh_on_axis(mesh1, new_axis, &mesh1_min, &mesh1_max);
+        get_bounds_of_mesh_on_axis(mesh2, new_axis, &mesh2_min, &mesh2_max);
+
+        *axis = new_axis;
+        *separation = MAX(mesh2_min - mesh1_max, mesh1_min - mesh2_max);
+        return true;
+    }
+
+    // Clip the incident face (the most antiparallel to the reference face)
+    // against the reference face, for the contacts of a face collision
+    inline void get_face_contacts(const sColliderMesh &reference_mesh,
+                                  const uint32_t reference_face,
+                                  const sColliderMesh &incident_mesh,
+                                  uint32_t *incident_support_vertex,
+                                  sVector3 *contact_points,
+                                  float *contact_depth,
+                                  uint16_t *contanct_points_count) {
+        sPlane reference_plane = reference_mesh.get_plane_of_face(reference_face);
+
+        // The incident face is the most antiparallel to the reference face
+        const uint32_t incident_face = incident_mesh.get_support_face(reference_plane.normal.invert(),
+                                                                      incident_support_vertex);
+
+
+        *contanct_points_count = clipping::face_face_clipping(reference_mesh,
+                                                              reference_face,
+                                                              incident_mesh,
+                                                              incident_face,
+                                                              contact_points);
+
+        uint32_t contact_id = 0;
+        for(; contact_id < *contanct_points_count; contact_id++) {
+            float distance = reference_plane.distance(contact_points[contact_id]);
+            contact_depth[contact_id] = MIN(0.0f, distance);
+        }
+
+        *contanct_points_count = contact_id;
+    }
+
+
+    // The support_vertex of each mesh are the warm start of its support
+    // queries, and are updated with the last support. If there are none, the
+    // queries start from the first vertex
+    // If there is an axis_cache, its axis is tested first: if it still
+    // separates the meshes, or it is a face that stays as penetrating as on
+    // the last frame, the rest of the axis are not tested. It is updated
+    // with the axis found on this test
+    // The normal goes from the mesh 1 to the mesh 2 (so, against the
+    // reference face's normal when it is from the mesh 2)
     inline bool SAT_collision_test(const sColliderMesh &mesh1,
                                    const sColliderMesh &mesh2,
                                    sVector3 *normal,
                                    sVector3 *contact_points,
                                    float *contact_depth,
-                                   uint16_t *contanct_points_count) {
+                                   uint16_t *contanct_points_count,
+                                   uint32_t *support_vertex_mesh1 = NULL,
+                                   uint32_t *support_vertex_mesh2 = NULL,
+                                   sSATAxisCache *axis_cache = NULL) {
+        uint32_t local_support_vertex[2] = {0, 0};
+        if (support_vertex_mesh1 == NULL) {
+            support_vertex_mesh1 = &local_support_vertex[0];
+        }
+        if (support_vertex_mesh2 == NULL) {
+            support_vertex_mesh2 = &local_support_vertex[1];
+        }
+        sSATAxisCache local_axis_cache = {};
+        if (axis_cache == NULL) {
+            axis_cache = &local_axis_cache;
+        }
+
+        // Test the cached axis first
+        if (axis_cache->type == FACE_1_COL && axis_cache->index1 < mesh1.face_count) {
+            const float separation = get_face_axis_separation(mesh1, axis_cache->index1, mesh2, support_vertex_mesh2);
+
+            if (separation > 0.0f) {
+                axis_cache->separation = separation;
+                return false;
+            }
+
+            // Resting contact: the same reference face
+            if (axis_cache->separation <= 0.0f && fabsf(separation - axis_cache->separation) < SAT_AXIS_CACHE_TOLERANCE) {
+                get_face_contacts(mesh1,
+                                  axis_cache->index1,
+                                  mesh2,
+                                  support_vertex_mesh2,
+                                  contact_points,
+                                  contact_depth,
+                                  contanct_points_count);
+
+                // If the faces do not overlap anymore, do the full test
+                if (*contanct_points_count > 0) {
+                    axis_cache->separation = separation;
+                    *normal = mesh1.normals[axis_cache->index1];
+                    return true;
+                }
+            }
+        } else if (axis_cache->type == FACE_2_COL && axis_cache->index1 < mesh2.face_count) {
+            const float separation = get_face_axis_separation(mesh2, axis_cache->index1, mesh1, support_vertex_mesh1);
+
+            if (separation > 0.0f) {
+                axis_cache->separation = separation;
+                return false;
+            }
+
+            if (axis_cache->separation <= 0.0f && fabsf(separation - axis_cache->separation) < SAT_AXIS_CACHE_TOLERANCE) {
+                get_face_contacts(mesh2,
+                                  axis_cache->index1,
+                                  mesh1,
+                                  support_vertex_mesh1,
+                                  contact_points,
+                                  contact_depth,
+                                  contanct_points_count);
+
+                // If the faces do not overlap anymore, do the full test
+                if (*contanct_points_count > 0) {
+                    axis_cache->separation = separation;
+                    *normal = mesh2.normals[axis_cache->index1].invert();
+                    return true;
+                }
+            }
+        } else if (axis_cache->type == EDGE_EDGE_COL) {
+            sVector3 cached_axis = {};
+            float separation = 0.0f;
+
+            if (get_edge_axis_separation(mesh1, axis_cache->index1, mesh2, axis_cache->index2, &cached_axis, &separation) &&
+                separation > 0.0f) {
+                axis_cache->separation = separation;
+                return false;
+            }
+        }
 
         uint32_t collision_face_mesh1 = 0;
         float collision_distance_mesh1 = 0.0f;
         uint32_t collision_face_mesh2 = 0;
         float collision_distance_mesh2 = 0.0f;
 
-        eCollisionType collision = NONE;
-
         // Test faces of mesh2 collider vs collider 1
         if (!test_face_face_collision(mesh2,
                                       mesh1,
+                                      support_vertex_mesh1,
                                       &collision_face_mesh2,
                                       &collision_distance_mesh2)) {
+            *axis_cache = {FACE_2_COL, collision_face_mesh2, 0, collision_distance_mesh2};
             return false;
         }
 
@@ -185,24 +504,39 @@ namespace SAT {
         // Test faces of mesh1 collider vs collider 2
         if (!test_face_face_collision(mesh1,
                                       mesh2,
+                                      support_vertex_mesh2,
                                       &collision_face_mesh1,
                                       &collision_distance_mesh1)) {
+            *axis_cache = {FACE_1_COL, collision_face_mesh1, 0, collision_distance_mesh1};
             return false;
         }
 
 
         // Test cross product of the edges
-        uint32_t mesh1_collidion_edge = 0, mesh2_collision_edge = 0;
+        // The Gauss map pruning needs closed meshes (the ones with vertex adjacency)
+        sVector3 edge_collision_axis = {};
         float edge_edge_distance = 0.0f;
-        if (!test_edge_edge_collision(mesh1,
-                                      mesh2,
-                                      &mesh1_collidion_edge,
-                                      &mesh2_collision_edge,
-                                      &edge_edge_distance)) {
+        uint32_t collision_edge_mesh1 = 0, collision_edge_mesh2 = 0;
+        if (mesh1.vertex_adjacency_offsets != NULL && mesh2.vertex_adjacency_offsets != NULL) {
+            if (!test_edge_edge_gauss_map_collision(mesh1,
+                                                    mesh2,
+                                                    &edge_collision_axis,
+                                                    &edge_edge_distance,
+                                                    &collision_edge_mesh1,
+                                                    &collision_edge_mesh2)) {
+                *axis_cache = {EDGE_EDGE_COL, collision_edge_mesh1, collision_edge_mesh2, edge_edge_distance};
+                return false;
+            }
+        } else if (!test_edge_edge_collision(mesh1,
+                                             mesh2,
+                                             &edge_collision_axis,
+                                             &edge_edge_distance,
+                                             &collision_edge_mesh1,
+                                             &collision_edge_mesh2)) {
+            *axis_cache = {EDGE_EDGE_COL, collision_edge_mesh1, collision_edge_mesh2, edge_edge_distance};
             return false;
         }
 
-
         // TODO: Manifold and contact point extraction
 
         // Collision cases:
@@ -210,107 +544,82 @@ namespace SAT {
         //  Face v (edge or Face)
         //  http://vodacek.zvb.cz/archiv/293.html
         //
-        sPlane crop_plane = {};
-
-        sVector3 separating_axis = {};
         const sColliderMesh *reference_mesh, *incident_mesh;
+        uint32_t *incident_support_vertex = NULL;
         uint32_t reference_face = 0, incident_face = 0;
 
-        const float max_face_separation = MIN(collision_distance_mesh1, collision_distance_mesh2);
+        const float max_face_separation = MAX(collision_distance_mesh1, collision_distance_mesh2);
         const float k_edge_rel_tolerance = 0.90f;
-        const float k_face_rel_toletance = 0.98f;
         const float k_abs_tolerance = 0.5f * 0.005f;
 
-         sVector3 contact_points_local[12];
+        sVector3 contact_points_local[MANIFOLD_MAX_CONTACT_COUNT];
 
         // Add tolerance to favour face collision vs edge collision
-        if (k_edge_rel_tolerance * edge_edge_distance + k_abs_tolerance < max_face_separation) {
+        // The edge axis is the least penetrating one, with a tolerance (if
+        // the Gauss map finds no edge pair, there is no edge axis)
+        if (edge_edge_distance > k_edge_rel_tolerance * max_face_separation + k_abs_tolerance) {
             // Edge collision
             // for clipping, we estimate the collision faces based on the normal direction
-            std::cout << "Edge collision <=============" << std::endl;
-            const sVector3 edge_mesh1 = mesh1.get_edge(mesh1_collidion_edge);
-            const sVector3 edge_mesh2 = mesh2.get_edge(mesh2_collision_edge);
             const sVector3 collider_distance = mesh1.mesh_center.subs(mesh2.mesh_center);
-            const sVector3 edge_axis = cross_prod(edge_mesh1, edge_mesh2).normalize();
+            const sVector3 &edge_axis = edge_collision_axis;
 
             if (dot_prod(collider_distance, edge_axis) < 0.0f) {
                 *normal = edge_axis;
             } else {
                 *normal = edge_axis.invert();
             }
-            *contanct_points_count = 0;
 
-            incident_face = mesh1.get_support_face(normal->invert());
-            reference_face = mesh2.get_support_face(*normal);
+            // Clip the face of mesh2 most opposed to the normal, against the
+            // face of mesh1 along it
+            reference_face = mesh1.get_support_face(*normal, support_vertex_mesh1);
+            incident_face = mesh2.get_support_face(normal->invert(), support_vertex_mesh2);
 
-            sPlane reference_plane = mesh2.get_plane_of_face(reference_face);
+            const sPlane reference_plane = mesh1.get_plane_of_face(reference_face);
 
             *contanct_points_count = clipping::face_face_clipping(mesh1,
-                                                                       incident_face,
-                                                                       mesh2,
-                                                                       reference_face,
-                                                                       contact_points_local);
-
-             uint32_t contact_id = 0;
-             for(uint32_t i = 0; i < *contanct_points_count; i++) {
-                 float distance = reference_plane.distance(contact_points[i]);
-                 contact_depth[contact_id] = distance;
-                 contact_points[contact_id++] = contact_points[i];
-             }
-
-             *contanct_points_count = contact_id;
+                                                                  reference_face,
+                                                                  mesh2,
+                                                                  incident_face,
+                                                                  contact_points_local);
+
+            for(uint32_t i = 0; i < *contanct_points_count; i++) {
+                contact_depth[i] = MIN(0.0f, reference_plane.distance(contact_points_local[i]));
+                contact_points[i] = contact_points_local[i];
+            }
 
+            *axis_cache = {EDGE_EDGE_COL, collision_edge_mesh1, collision_edge_mesh2, edge_edge_distance};
             return true;
         } else {
             // Face collision
             // Favor the first mesh as a reference, with the tolerance
             if (collision_distance_mesh2 - k_abs_tolerance < collision_distance_mesh1) {
                 // Face 1 is reference face
-                std::cout << "Ref: mesh1" << std::endl;
                 reference_mesh = &mesh1;
                 reference_face = collision_face_mesh1;
                 *normal = reference_mesh->normals[reference_face];
 
                 incident_mesh = &mesh2;
+                incident_support_vertex = support_vertex_mesh2;
+                *axis_cache = {FACE_1_COL, collision_face_mesh1, 0, collision_distance_mesh1};
             } else {
                 // Face of mesh 2 is reference face
-                std::cout << "Ref: mesh2" << std::endl;
                 reference_mesh = &mesh2;
                 reference_face = collision_face_mesh2;
-                *normal = reference_mesh->normals[reference_face];
+                *normal = reference_mesh->normals[reference_face].invert();
 
                 incident_mesh = &mesh1;
+                incident_support_vertex = support_vertex_mesh1;
+                *axis_cache = {FACE_2_COL, collision_face_mesh2, 0, collision_distance_mesh2};
             }
         }
 
-        sPlane reference_plane = reference_mesh->get_plane_of_face(reference_face);
-
-        float incident_facing = dot_prod(reference_plane.normal, incident_mesh->normals[0]);
-        for(uint32_t i = 1; i < incident_mesh->face_count; i++) {
-            float facing = dot_prod(reference_plane.normal, incident_mesh->normals[i]);
-
-            if (facing < incident_facing) {
-                incident_facing = facing;
-                incident_face = i;
-            }
-        }
-
-
-        *contanct_points_count = clipping::face_face_clipping(*reference_mesh,
-                                                              reference_face,
-                                                              *incident_mesh,
-                                                              incident_face,
-                                                              contact_points);
-
-        uint32_t contact_id = 0;
-        for(; contact_id < *contanct_points_count; contact_id++) {
-            float distance = reference_plane.distance(contact_points[contact_id]);
-            contact_depth[contact_id] = MIN(0.0f, distance);
-            contact_points[contact_id] = contact_points[contact_id];
-            std::cout << contact_depth[contact_id] << std::endl;
-        }
-
-        *contanct_points_count = contact_id;
+        get_face_contacts(*reference_mesh,
+                          reference_face,
+                          *incident_mesh,
+                          incident_support_vertex,
+                          contact_points,
+                          contact_depth,
+                          contanct_points_count);
 
         return true;
     }
@@ -400,6 +709,43 @@ namespace SAT {
 
         return true;
     }
+
+    // Only tests the face axes of the hull, so it can report collisions
+    // close to the edges & corners that are not. The normal goes from
+    // the hull to the sphere
+    inline bool SAT_sphere_hull_collision(const sVector3 &sphere_center,
+                                          const float sphere_radius,
+                                          const sColliderMesh &hull_mesh,
+                                          sVector3 *normal,
+                                          sVector3 *contact_points,
+                                          float *contact_depth,
+                                          uint16_t *contanct_points_count) {
+        int min_face = -1;
+        float max_distance = -FLT_MAX;
+
+        for(uint32_t i = 0; i < hull_mesh.face_count; i++) {
+            const float distance = hull_mesh.get_plane_of_face(i).distance(sphere_center) - sphere_radius;
+
+            // If the sphere is in front of any face, there is no collision
+            if (distance > 0.0f) {
+                return false;
+            }
+
+            if (distance > max_distance) {
+                min_face = i;
+                max_distance = distance;
+            }
+        }
+
+        const sVector3 &col_axis = hull_mesh.normals[min_face];
+
+        contact_points[0] = sphere_center.sum(col_axis.invert().mult(sphere_radius));
+        contact_depth[0] = max_distance;
+        *normal = col_axis;
+        *contanct_points_count = 1;
+
+        return true;
+    }
 };
 
 #endif // SAT_H_
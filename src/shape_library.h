@@ -0,0 +1,227 @@
+#ifndef SHAPE_LIBRARY_H_
+#define SHAPE_LIBRARY_H_
+
+#include "collider_mesh.h"
+#include "math.h"
+#include "vector.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * Shape library
+ * Registry of immutable convex hulls, shared by all the bodies with the
+ * same collider. Each shape stores its local space hull (vertices, faces,
+ * adjacency & unique edge directions).
+ * The bodies only reference a shape id, and an instance on the shape's
+ * pool, that holds the world space vertices, normals, plane origins, edge
+ * directions and center of the body, packed on a single array.
+ * The shapes are reference counted: each instance holds a reference,
+ * and the shape is freed when there are no more references.
+ * */
+
+#define SHAPE_LIBRARY_NULL 0xFFFFFFFF
+
+struct sConvexShape {
+    // Local space hull, not modified after the registration
+    sColliderMesh  local_hull = {};
+
+    // Local space bounds of the hull
+    sVector3       local_min = {};
+    sVector3       local_max = {};
+
+    uint32_t       ref_count = 0;
+    // Next free shape, only used on the free list
+    uint32_t       next_free = SHAPE_LIBRARY_NULL;
+
+    // World space instances
+    // Stride: vertices + normals + plane origins + edge directions + center
+    sVector3       *instance_data = NULL;
+    uint32_t       *instance_next_free = NULL;
+    uint32_t       instance_stride = 0;
+    uint32_t       instance_capacity = 0;
+    uint32_t       instance_free_list = SHAPE_LIBRARY_NULL;
+
+    void compute_local_bounds() {
+        local_min = local_hull.vertices[0];
+        local_max = local_hull.vertices[0];
+
+        for(uint32_t i = 1; i < local_hull.vertices_count; i++) {
+            const sVector3 &vertex = local_hull.vertices[i];
+            local_min = {MIN(local_min.x, vertex.x), MIN(local_min.y, vertex.y), MIN(local_min.z, vertex.z)};
+            local_max = {MAX(local_max.x, vertex.x), MAX(local_max.y, vertex.y), MAX(local_max.z, vertex.z)};
+        }
+    }
+
+    void grow_instances(const uint32_t new_capacity) {
+        const uint32_t old_capacity = instance_capacity;
+        instance_capacity = new_capacity;
+
+        instance_data = (sVector3*) realloc(instance_data, sizeof(sVector3) * instance_stride * instance_capacity);
+        instance_next_free = (uint32_t*) realloc(instance_next_free, sizeof(uint32_t) * instance_capacity);
+
+        for(uint32_t i = old_capacity; i < instance_capacity; i++) {
+            instance_next_free[i] = (i + 1 < instance_capacity) ? i + 1 : instance_free_list;
+        }
+        instance_free_list = old_capacity;
+    }
+
+    void clean() {
+        local_hull.clean();
+        free(instance_data);
+        free(instance_next_free);
+
+        *this = sConvexShape{};
+    }
+};
+
+struct sShapeLibrary {
+    sConvexShape  *shapes = NULL;
+    uint32_t      shape_capacity = 0;
+    uint32_t      free_list = SHAPE_LIBRARY_NULL;
+
+    // =================
+    // LIFECYCLE FUNCTIONS
+    // ================
+    void init(const uint32_t initial_capacity) {
+        shape_capacity = 0;
+        free_list = SHAPE_LIBRARY_NULL;
+        grow((initial_capacity == 0) ? 4 : initial_capacity);
+    }
+
+    void clean() {
+        for(uint32_t i = 0; i < shape_capacity; i++) {
+            if (shapes[i].ref_count > 0) {
+                shapes[i].clean();
+            }
+        }
+        free(shapes);
+        shapes = NULL;
+        shape_capacity = 0;
+        free_list = SHAPE_LIBRARY_NULL;
+    }
+
+    void grow(const uint32_t new_capacity) {
+        const uint32_t old_capacity = shape_capacity;
+        shape_capacity = new_capacity;
+
+        shapes = (sConvexShape*) realloc(shapes, sizeof(sConvexShape) * shape_capacity);
+        for(uint32_t i = old_capacity; i < shape_capacity; i++) {
+            shapes[i] = sConvexShape{};
+            shapes[i].next_free = (i + 1 < shape_capacity) ? i + 1 : free_list;
+        }
+        free_list = old_capacity;
+    }
+
+    // =================
+    // SHAPE FUNCTIONS
+    // ================
+    // Registers a local space hull, and takes ownership of its arrays.
+    // The caller holds the first reference of the shape
+    uint32_t add_shape(const sColliderMesh &local_hull) {
+        if (free_list == SHAPE_LIBRARY_NULL) {
+            grow(shape_capacity * 2);
+        }
+
+        const uint32_t shape_id = free_list;
+        sConvexShape &shape = shapes[shape_id];
+        free_list = shape.next_free;
+
+        shape.local_hull = local_hull;
+        shape.ref_count = 1;
+        shape.next_free = SHAPE_LIBRARY_NULL;
+        shape.compute_local_bounds();
+
+        shape.instance_stride = local_hull.vertices_count + (local_hull.face_count * 2) + local_hull.edge_direction_count + 1;
+        shape.instance_capacity = 0;
+        shape.instance_free_list = SHAPE_LIBRARY_NULL;
+        shape.grow_instances(16);
+
+        return shape_id;
+    }
+
+    inline void acquire(const uint32_t shape_id) {
+        shapes[shape_id].ref_count++;
+    }
+
+    inline void release(const uint32_t shape_id) {
+        sConvexShape &shape = shapes[shape_id];
+
+        if (--shape.ref_count > 0) {
+            return;
+        }
+
+        shape.clean();
+        shape.next_free = free_list;
+        free_list = shape_id;
+    }
+
+    inline const sColliderMesh& get_local_hull(const uint32_t shape_id) const {
+        return shapes[shape_id].local_hull;
+    }
+
+    inline const sConvexShape& get_shape(const uint32_t shape_id) const {
+        return shapes[shape_id];
+    }
+
+    // =================
+    // INSTANCE FUNCTIONS
+    // ================
+    // Each instance holds a reference to its shape
+    uint32_t create_instance(const uint32_t shape_id) {
+        sConvexShape &shape = shapes[shape_id];
+
+        if (shape.instance_free_list == SHAPE_LIBRARY_NULL) {
+            shape.grow_instances(shape.instance_capacity * 2);
+        }
+
+        const uint32_t instance = shape.instance_free_list;
+        shape.instance_free_list = shape.instance_next_free[instance];
+        shape.ref_count++;
+
+        return instance;
+    }
+
+    void destroy_instance(const uint32_t shape_id,
+                          const uint32_t instance) {
+        sConvexShape &shape = shapes[shape_id];
+
+        shape.instance_next_free[instance] = shape.instance_free_list;
+        shape.instance_free_list = instance;
+
+        release(shape_id);
+    }
+
+    // Returns a view of the world space hull of the instance.
+    // The view shares the arrays of the library, so it should not be cleaned,
+    // and it is only valid until the next instance creation of the shape
+    inline sColliderMesh get_instance(const uint32_t shape_id,
+                                      const uint32_t instance) const {
+        const sConvexShape &shape = shapes[shape_id];
+        const sColliderMesh &local_hull = shape.local_hull;
+        sVector3 *data = &shape.instance_data[instance * shape.instance_stride];
+
+        sColliderMesh view = local_hull;
+        view.vertices = data;
+        view.normals = &data[local_hull.vertices_count];
+        view.plane_origin = &data[local_hull.vertices_count + local_hull.face_count];
+        view.edge_directions = &data[local_hull.vertices_count + (local_hull.face_count * 2)];
+        view.mesh_center = data[shape.instance_stride - 1];
+
+        return view;
+    }
+
+    // Rewrite the world space data of the instance
+    inline void update_instance(const uint32_t shape_id,
+                                const uint32_t instance,
+                                const sTransform &transform) {
+        const sConvexShape &shape = shapes[shape_id];
+        sColliderMesh view = get_instance(shape_id, instance);
+
+        view.update_from_local_hull(shape.local_hull, transform);
+        shape.instance_data[(instance * shape.instance_stride) + shape.instance_stride - 1] = view.mesh_center;
+    }
+};
+
+#endif // SHAPE_LIBRARY_H_
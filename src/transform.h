@@ -57,6 +57,11 @@ struct sTransform {
     return rotation.inverse().multiply(vect.get_pure_quaternion()).multiply(rotation).get_vector();
   }
 
+  // From world space to the rotation's local space
+  inline sVector3 apply_inverse_rotation(const sVector3 &vect) const {
+    return rotation.multiply(vect.get_pure_quaternion()).multiply(rotation.inverse()).get_vector();
+  }
+
   inline sVector3 apply(const sVector3 &vect) const {
     sVector3 scalled = vect.mult(scale);//
     sQuaternion4 q_vect = scalled.get_pure_quaternion();
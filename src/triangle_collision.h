@@ -0,0 +1,377 @@
+#ifndef TRIANGLE_COLLISION_H_
+#define TRIANGLE_COLLISION_H_
+
+#include "capsule_collision.h"
+#include "collider_mesh.h"
+#include "constants.h"
+#include "face_clipping.h"
+#include "geometry.h"
+#include "gjk.h"
+#include "manifold_reduction.h"
+#include "math.h"
+#include "vector.h"
+
+#include <cstdint>
+#include <cstring>
+
+//**
+// Shapes vs a triangle of a triangle mesh
+// The triangles are two sided. The sphere is tested in closed form, via
+// the closest point on the triangle; the rest via GJK/EPA with the triangle
+// as a core. When the normal is aligned with the triangle's normal, the
+// capsule's segment, or the hull's most opposed face, is clipped to the
+// triangle's side planes for a manifold of several points.
+// The normal goes from the triangle to the shape
+// */
+
+#define TRIANGLE_FACE_ALIGNMENT 0.95f
+
+namespace TRIANGLE {
+
+    // Real-Time Collision Detection 5.1.5
+    inline sVector3 get_closest_point_on_triangle(const sVector3 &point,
+                                                  const sVector3 &a,
+                                                  const sVector3 &b,
+                                                  const sVector3 &c) {
+        const sVector3 ab = b.subs(a);
+        const sVector3 ac = c.subs(a);
+        const sVector3 ap = point.subs(a);
+
+        const float d1 = dot_prod(ab, ap);
+        const float d2 = dot_prod(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) {
+            return a;
+        }
+
+        const sVector3 bp = point.subs(b);
+        const float d3 = dot_prod(ab, bp);
+        const float d4 = dot_prod(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3) {
+            return b;
+        }
+
+        const float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            return a.sum(ab.mult(d1 / (d1 - d3)));
+        }
+
+        const sVector3 cp = point.subs(c);
+        const float d5 = dot_prod(ab, cp);
+        const float d6 = dot_prod(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6) {
+            return c;
+        }
+
+        const float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            return a.sum(ac.mult(d2 / (d2 - d6)));
+        }
+
+        const float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+            return b.sum(c.subs(b).mult((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+        }
+
+        const float denom = 1.0f / (va + vb + vc);
+        return a.sum(ab.mult(vb * denom)).sum(ac.mult(vc * denom));
+    }
+
+    // The triangle's corners, CCW seen from the side of the normal
+    inline sVector3 get_oriented_face(const sVector3 *triangle,
+                                      const sVector3 &triangle_normal,
+                                      const sVector3 &normal,
+                                      sVector3 *face) {
+        if (dot_prod(triangle_normal, normal) >= 0.0f) {
+            face[0] = triangle[0];
+            face[1] = triangle[1];
+            face[2] = triangle[2];
+            return triangle_normal;
+        }
+
+        face[0] = triangle[0];
+        face[1] = triangle[2];
+        face[2] = triangle[1];
+        return triangle_normal.invert();
+    }
+
+    inline bool sphere_triangle_collision(const sVector3 *triangle,
+                                          const sVector3 &triangle_normal,
+                                          const sVector3 &sphere_center,
+                                          const float sphere_radius,
+                                          sVector3 *normal,
+                                          sVector3 *contact_points,
+                                          float *contact_depth,
+                                          uint16_t *contanct_points_count,
+                                          float *separating_distance = NULL) {
+        const sVector3 closest = get_closest_point_on_triangle(sphere_center, triangle[0], triangle[1], triangle[2]);
+        const sVector3 delta = sphere_center.subs(closest);
+        const float distance_squared = dot_prod(delta, delta);
+
+        if (distance_squared > sphere_radius * sphere_radius) {
+            if (separating_distance != NULL) {
+                *separating_distance = sqrtf(distance_squared) - sphere_radius;
+            }
+            return false;
+        }
+
+        if (distance_squared > 0.000001f) {
+            *normal = delta.mult(1.0f / sqrtf(distance_squared));
+        } else {
+            *normal = triangle_normal;
+        }
+
+        contact_points[0] = sphere_center.subs(normal->mult(sphere_radius));
+        contact_depth[0] = sqrtf(distance_squared) - sphere_radius;
+        *contanct_points_count = 1;
+
+        return true;
+    }
+
+    inline bool capsule_triangle_collision(const sVector3 *triangle,
+                                           const sVector3 &triangle_normal,
+                                           const sVector3 &capsule_start,
+                                           const sVector3 &capsule_end,
+                                           const float capsule_radius,
+                                           sVector3 *normal,
+                                           sVector3 *contact_points,
+                                           float *contact_depth,
+                                           uint16_t *contanct_points_count,
+                                           float *separating_distance = NULL) {
+        if (!GJK::convex_collision(GJK::get_triangle_shape(triangle[0], triangle[1], triangle[2]),
+                                   GJK::get_segment_shape(capsule_start, capsule_end, capsule_radius),
+                                   NULL,
+                                   normal,
+                                   contact_points,
+                                   contact_depth,
+                                   contanct_points_count,
+                                   separating_distance)) {
+            return false;
+        }
+
+        if (fabsf(dot_prod(triangle_normal, *normal)) > TRIANGLE_FACE_ALIGNMENT) {
+            sVector3 face[3] = {};
+            const sVector3 face_normal = get_oriented_face(triangle, triangle_normal, *normal, face);
+            sVector3 face_contact_points[2] = {};
+            float face_contact_depth[2] = {};
+
+            if (CAPSULE::get_face_segment_contacts(face,
+                                                   3,
+                                                   face_normal,
+                                                   capsule_start,
+                                                   capsule_end,
+                                                   capsule_radius,
+                                                   face_contact_points,
+                                                   face_contact_depth) == 2) {
+                for(uint32_t i = 0; i < 2; i++) {
+                    contact_points[i] = face_contact_points[i];
+                    contact_depth[i] = face_contact_depth[i];
+                }
+                *normal = face_normal;
+                *contanct_points_count = 2;
+            }
+        }
+
+        return true;
+    }
+
+    // Also for the boxes, with their world space hull
+    inline bool hull_triangle_collision(const sVector3 *triangle,
+                                        const sVector3 &triangle_normal,
+                                        const sColliderMesh &hull_mesh,
+                                        uint32_t *support_vertex,
+                                        sVector3 *normal,
+                                        sVector3 *contact_points,
+                                        float *contact_depth,
+                                        uint16_t *contanct_points_count,
+                                        float *separating_distance = NULL) {
+        if (!GJK::convex_collision(GJK::get_triangle_shape(triangle[0], triangle[1], triangle[2]),
+                                   GJK::get_hull_shape(hull_mesh, support_vertex),
+                                   NULL,
+                                   normal,
+                                   contact_points,
+                                   contact_depth,
+                                   contanct_points_count,
+                                   separating_distance)) {
+            return false;
+        }
+
+        if (fabsf(dot_prod(triangle_normal, *normal)) <= TRIANGLE_FACE_ALIGNMENT) {
+            return true;
+        }
+
+        // Clip the most opposed face of the hull to the triangle's prism
+        sVector3 face[3] = {};
+        const sVector3 face_normal = get_oriented_face(triangle, triangle_normal, *normal, face);
+        const uint32_t incident_face = hull_mesh.get_support_face(face_normal.invert(), support_vertex);
+        const uint32_t incident_face_size = hull_mesh.get_face_size(incident_face);
+
+        // Each clipping plane can add one point
+        clipping::sClipBuffer buffer;
+        buffer.init(incident_face_size + 3);
+
+        memcpy(buffer.to_clip, hull_mesh.get_face(incident_face), sizeof(sVector3) * incident_face_size);
+        uint32_t num_of_points_to_clip = incident_face_size;
+
+        for(uint32_t i = 0; i < 3 && num_of_points_to_clip > 0; i++) {
+            const sVector3 edge = face[(i + 1) % 3].subs(face[i]);
+            const sPlane side_plane = {face[i], cross_prod(edge, face_normal).normalize()};
+
+            num_of_points_to_clip = clipping::clip_polygon_to_plane(side_plane,
+                                                                    buffer.to_clip,
+                                                                    num_of_points_to_clip,
+                                                                    buffer.clipped);
+            buffer.swap();
+        }
+
+        // Keep the points bellow the triangle, reduced if there are too many
+        const sPlane triangle_plane = {face[0], face_normal};
+        uint16_t contact_count = 0;
+        for(uint32_t i = 0; i < num_of_points_to_clip; i++) {
+            const float distance = triangle_plane.distance(buffer.to_clip[i]);
+
+            if (distance < 0.0f) {
+                buffer.clipped[contact_count] = buffer.to_clip[i];
+                buffer.depth[contact_count] = distance;
+                contact_count++;
+            }
+        }
+
+        if (contact_count > 0) {
+            contact_count = MANIFOLD::reduce_contacts(face_normal, buffer.clipped, buffer.depth, contact_count);
+            memcpy(contact_points, buffer.clipped, sizeof(sVector3) * contact_count);
+            memcpy(contact_depth, buffer.depth, sizeof(float) * contact_count);
+            *normal = face_normal;
+            *contanct_points_count = contact_count;
+        }
+
+        return true;
+    }
+};
+
+enum eTriangleTestShape : uint8_t {
+    TRIANGLE_TEST_SPHERE = 0,
+    TRIANGLE_TEST_CAPSULE,
+    TRIANGLE_TEST_HULL
+};
+
+/**
+ * The shape of a body, ready to be tested against a batch of triangles
+ * The hull's support queries are coherent between neighbouring triangles,
+ * so the support vertex is kept between tests
+ * */
+struct sTriangleTestShape {
+    eTriangleTestShape  type = TRIANGLE_TEST_SPHERE;
+    // Sphere: center on start
+    sVector3            start = {};
+    sVector3            end = {};
+    float               radius = 0.0f;
+    sColliderMesh       mesh = {};
+    uint32_t            support_vertex = 0;
+
+    inline bool test(const sVector3 *triangle,
+                     const sVector3 &triangle_normal,
+                     sVector3 *normal,
+                     sVector3 *contact_points,
+                     float *contact_depth,
+                     uint16_t *contanct_points_count) {
+        switch(type) {
+            case TRIANGLE_TEST_SPHERE:
+                return TRIANGLE::sphere_triangle_collision(triangle,
+                                                           triangle_normal,
+                                                           start,
+                                                           radius,
+                                                           normal,
+                                                           contact_points,
+                                                           contact_depth,
+                                                           contanct_points_count);
+            case TRIANGLE_TEST_CAPSULE:
+                return TRIANGLE::capsule_triangle_collision(triangle,
+                                                            triangle_normal,
+                                                            start,
+                                                            end,
+                                                            radius,
+                                                            normal,
+                                                            contact_points,
+                                                            contact_depth,
+                                                            contanct_points_count);
+            default:
+                return TRIANGLE::hull_triangle_collision(triangle,
+                                                         triangle_normal,
+                                                         mesh,
+                                                         &support_vertex,
+                                                         normal,
+                                                         contact_points,
+                                                         contact_depth,
+                                                         contanct_points_count);
+        }
+    }
+};
+
+/**
+ * Merges the contacts of a body against several triangles on a single
+ * manifold. When full, the shallowest contact is replaced. The normal is
+ * the average of the triangles' normals weighted by their depth, and the
+ * depths are projected on it
+ * */
+struct sTriangleManifoldMerger {
+    sVector3    merged_normal = {0.0f, 0.0f, 0.0f};
+    sVector3    contact_normals[MAX_CONTACT_COUNT] = {};
+    uint16_t    contact_count = 0;
+
+    inline void add(const sVector3 &triangle_contact_normal,
+                    const sVector3 *triangle_contact_points,
+                    const float *triangle_contact_depth,
+                    const uint16_t triangle_contact_count,
+                    sVector3 *contact_points,
+                    float *contact_depth) {
+        float deepest = 0.0f;
+        for(uint16_t j = 0; j < triangle_contact_count; j++) {
+            deepest = MIN(deepest, triangle_contact_depth[j]);
+
+            uint16_t slot = contact_count;
+            if (contact_count == MAX_CONTACT_COUNT) {
+                slot = 0;
+                for(uint16_t k = 1; k < contact_count; k++) {
+                    if (contact_depth[k] > contact_depth[slot]) {
+                        slot = k;
+                    }
+                }
+                if (contact_depth[slot] <= triangle_contact_depth[j]) {
+                    continue;
+                }
+            } else {
+                contact_count++;
+            }
+
+            contact_points[slot] = triangle_contact_points[j];
+            contact_depth[slot] = triangle_contact_depth[j];
+            contact_normals[slot] = triangle_contact_normal;
+        }
+
+        merged_normal = merged_normal.sum(triangle_contact_normal.mult(MAX(-deepest, 0.0001f)));
+    }
+
+    inline bool get_result(sVector3 *normal,
+                           float *contact_depth,
+                           uint16_t *contanct_points_count) const {
+        if (contact_count == 0) {
+            return false;
+        }
+
+        // Opposed triangles (ex. both sides of a thin wall) can cancel out
+        if (dot_prod(merged_normal, merged_normal) < 0.00000001f) {
+            *normal = contact_normals[0];
+        } else {
+            *normal = merged_normal.normalize();
+        }
+
+        for(uint16_t i = 0; i < contact_count; i++) {
+            contact_depth[i] *= MAX(dot_prod(contact_normals[i], *normal), 0.0f);
+        }
+        *contanct_points_count = contact_count;
+
+        return true;
+    }
+};
+
+#endif // TRIANGLE_COLLISION_H_
@@ -0,0 +1,292 @@
+#ifndef TRIANGLE_MESH_H_
+#define TRIANGLE_MESH_H_
+
+#include "math.h"
+#include "mesh.h"
+#include "phys_broadphase.h"
+#include "transform.h"
+#include "vector.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+/**
+ * Triangle mesh
+ * Static, concave, collider for the level geometry. The triangles are
+ * stored on world space, and indexed by a quantized BVH: each node stores
+ * its bounds as 16 bit integers on the grid of the mesh's bounds, so a
+ * node is 16 bytes (a cache line holds four).
+ * The nodes are stored depth first: the first child of an inner node is the
+ * next node, and each inner node stores the index of the node after its
+ * subtree, so a query can skip it without a stack.
+ * Based on Bullet's btQuantizedBvh
+ * */
+
+#define TRIANGLE_MESH_QUANTIZATION_MAX 65535.0f
+
+struct sQuantizedBVHNode {
+    uint16_t  min[3] = {0, 0, 0};
+    uint16_t  max[3] = {0, 0, 0};
+    // Leafs: -(triangle + 1)
+    // Inner nodes: index of the next node after its subtree
+    int32_t   index = 0;
+
+    inline bool is_leaf() const {
+        return index < 0;
+    }
+
+    inline uint32_t get_triangle() const {
+        return (uint32_t) (-index - 1);
+    }
+
+    inline bool overlaps(const uint16_t *query_min,
+                         const uint16_t *query_max) const {
+        return min[0] <= query_max[0] && max[0] >= query_min[0] &&
+               min[1] <= query_max[1] && max[1] >= query_min[1] &&
+               min[2] <= query_max[2] && max[2] >= query_min[2];
+    }
+};
+
+struct sTriangleMesh {
+    sVector3            *vertices = NULL;
+    uint32_t            vertex_count = 0;
+    // 3 per triangle
+    uint32_t            *indices = NULL;
+    sVector3            *normals = NULL;
+    uint32_t            triangle_count = 0;
+
+    sQuantizedBVHNode   *nodes = NULL;
+    uint32_t            node_count = 0;
+
+    sAABB               aabb = {};
+    sVector3            quantization_scale = {};
+
+    // Result of the last query
+    uint32_t            *query_triangles = NULL;
+    uint32_t            query_count = 0;
+
+    // Welds the vertices by their OBJ position index, and bakes the transform
+    // Returns false if there are no (non degenerated) triangles
+    bool init_from_mesh(const sMesh &mesh,
+                        const sTransform &transform) {
+        vertex_count = 0;
+        for(uint32_t i = 0; i < mesh.indexing_count; i++) {
+            vertex_count = MAX(vertex_count, mesh.face_vertices[i] + 1);
+        }
+
+        vertices = (sVector3*) malloc(sizeof(sVector3) * vertex_count);
+        for(uint32_t i = 0; i < mesh.indexing_count; i++) {
+            vertices[mesh.face_vertices[i]] = transform.apply(mesh.vertices[mesh.vertices_index[i]].vertex);
+        }
+
+        indices = (uint32_t*) malloc(sizeof(uint32_t) * mesh.indexing_count);
+        normals = (sVector3*) malloc(sizeof(sVector3) * (mesh.indexing_count / 3));
+        triangle_count = 0;
+        for(uint32_t i = 0; i + 2 < mesh.indexing_count; i += 3) {
+            const uint32_t *corners = &mesh.face_vertices[i];
+            const sVector3 normal = cross_prod(vertices[corners[1]].subs(vertices[corners[0]]),
+                                               vertices[corners[2]].subs(vertices[corners[0]]));
+
+            if (dot_prod(normal, normal) < 0.00000001f) {
+                continue;
+            }
+
+            indices[triangle_count * 3] = corners[0];
+            indices[triangle_count * 3 + 1] = corners[1];
+            indices[triangle_count * 3 + 2] = corners[2];
+            normals[triangle_count] = normal.normalize();
+            triangle_count++;
+        }
+
+        if (triangle_count == 0) {
+            clean();
+            return false;
+        }
+
+        build_BVH();
+        query_triangles = (uint32_t*) malloc(sizeof(uint32_t) * triangle_count);
+        query_count = 0;
+
+        return true;
+    }
+
+    void clean() {
+        free(vertices);
+        free(indices);
+        free(normals);
+        free(nodes);
+        free(query_triangles);
+        vertices = NULL;
+        indices = NULL;
+        normals = NULL;
+        nodes = NULL;
+        query_triangles = NULL;
+        vertex_count = 0;
+        triangle_count = 0;
+        node_count = 0;
+        query_count = 0;
+    }
+
+    inline void get_triangle(const uint32_t triangle,
+                             sVector3 *p1,
+                             sVector3 *p2,
+                             sVector3 *p3) const {
+        *p1 = vertices[indices[triangle * 3]];
+        *p2 = vertices[indices[triangle * 3 + 1]];
+        *p3 = vertices[indices[triangle * 3 + 2]];
+    }
+
+    inline sAABB get_AABB_of_triangle(const uint32_t triangle) const {
+        sVector3 p1 = {}, p2 = {}, p3 = {};
+        get_triangle(triangle, &p1, &p2, &p3);
+
+        return sAABB{ sVector3{MIN(p1.x, MIN(p2.x, p3.x)), MIN(p1.y, MIN(p2.y, p3.y)), MIN(p1.z, MIN(p2.z, p3.z))},
+                      sVector3{MAX(p1.x, MAX(p2.x, p3.x)), MAX(p1.y, MAX(p2.y, p3.y)), MAX(p1.z, MAX(p2.z, p3.z))} };
+    }
+
+    // Rounded down for the mins, and up for the maxs, so the quantized
+    // bounds always contain the real ones
+    inline void quantize(const sAABB &bounds,
+                         uint16_t *quantized_min,
+                         uint16_t *quantized_max) const {
+        const float min[3] = { (bounds.min.x - aabb.min.x) * quantization_scale.x,
+                               (bounds.min.y - aabb.min.y) * quantization_scale.y,
+                               (bounds.min.z - aabb.min.z) * quantization_scale.z };
+        const float max[3] = { (bounds.max.x - aabb.min.x) * quantization_scale.x,
+                               (bounds.max.y - aabb.min.y) * quantization_scale.y,
+                               (bounds.max.z - aabb.min.z) * quantization_scale.z };
+
+        for(uint32_t i = 0; i < 3; i++) {
+            quantized_min[i] = (uint16_t) MIN(MAX(floorf(min[i]), 0.0f), TRIANGLE_MESH_QUANTIZATION_MAX);
+            quantized_max[i] = (uint16_t) MIN(MAX(ceilf(max[i]), 0.0f), TRIANGLE_MESH_QUANTIZATION_MAX);
+        }
+    }
+
+    // Stores on query_triangles the triangles whose nodes overlap the AABB
+    uint32_t query(const sAABB &bounds) {
+        query_count = 0;
+
+        if (!aabb.overlaps(bounds)) {
+            return 0;
+        }
+
+        uint16_t query_min[3], query_max[3];
+        quantize(bounds, query_min, query_max);
+
+        uint32_t node = 0;
+        while(node < node_count) {
+            const sQuantizedBVHNode &curr = nodes[node];
+            const bool overlaps = curr.overlaps(query_min, query_max);
+
+            if (curr.is_leaf()) {
+                if (overlaps) {
+                    query_triangles[query_count++] = curr.get_triangle();
+                }
+                node++;
+            } else if (overlaps) {
+                node++;
+            } else {
+                node = (uint32_t) curr.index;
+            }
+        }
+
+        return query_count;
+    }
+
+    // Top down build, splitting each node by the mean of the centers of its
+    // triangles, on the axis where they are most spread
+    void build_BVH() {
+        aabb = get_AABB_of_triangle(0);
+        for(uint32_t i = 1; i < triangle_count; i++) {
+            aabb = aabb.merge(get_AABB_of_triangle(i));
+        }
+
+        // Avoid the division by zero on flat meshes
+        const sVector3 size = aabb.max.subs(aabb.min);
+        quantization_scale = { TRIANGLE_MESH_QUANTIZATION_MAX / MAX(size.x, 0.0001f),
+                               TRIANGLE_MESH_QUANTIZATION_MAX / MAX(size.y, 0.0001f),
+                               TRIANGLE_MESH_QUANTIZATION_MAX / MAX(size.z, 0.0001f) };
+
+        uint32_t *triangles = (uint32_t*) malloc(sizeof(uint32_t) * triangle_count);
+        sVector3 *centers = (sVector3*) malloc(sizeof(sVector3) * triangle_count);
+        for(uint32_t i = 0; i < triangle_count; i++) {
+            const sAABB triangle_aabb = get_AABB_of_triangle(i);
+            triangles[i] = i;
+            centers[i] = triangle_aabb.min.sum(triangle_aabb.max).mult(0.5f);
+        }
+
+        // A binary tree with a triangle per leaf
+        nodes = (sQuantizedBVHNode*) malloc(sizeof(sQuantizedBVHNode) * (2 * triangle_count - 1));
+        node_count = 0;
+        build_node(triangles, centers, 0, triangle_count);
+
+        free(triangles);
+        free(centers);
+    }
+
+    void build_node(uint32_t *triangles,
+                    const sVector3 *centers,
+                    const uint32_t start,
+                    const uint32_t end) {
+        const uint32_t node = node_count++;
+
+        sAABB bounds = get_AABB_of_triangle(triangles[start]);
+        for(uint32_t i = start + 1; i < end; i++) {
+            bounds = bounds.merge(get_AABB_of_triangle(triangles[i]));
+        }
+        quantize(bounds, nodes[node].min, nodes[node].max);
+
+        if (end - start == 1) {
+            nodes[node].index = -((int32_t) triangles[start]) - 1;
+            return;
+        }
+
+        // Split axis: the biggest variance of the centers
+        sVector3 mean = {0.0f, 0.0f, 0.0f};
+        for(uint32_t i = start; i < end; i++) {
+            mean = mean.sum(centers[triangles[i]]);
+        }
+        mean = mean.mult(1.0f / (end - start));
+
+        sVector3 variance = {0.0f, 0.0f, 0.0f};
+        for(uint32_t i = start; i < end; i++) {
+            const sVector3 delta = centers[triangles[i]].subs(mean);
+            variance = variance.sum(sVector3{delta.x * delta.x, delta.y * delta.y, delta.z * delta.z});
+        }
+
+        uint32_t axis = 0;
+        if (variance.y > variance.x) {
+            axis = 1;
+        }
+        if (variance.z > ((axis == 0) ? variance.x : variance.y)) {
+            axis = 2;
+        }
+
+        const float split = (axis == 0) ? mean.x : ((axis == 1) ? mean.y : mean.z);
+        uint32_t middle = start;
+        for(uint32_t i = start; i < end; i++) {
+            const sVector3 &center = centers[triangles[i]];
+            const float value = (axis == 0) ? center.x : ((axis == 1) ? center.y : center.z);
+
+            if (value < split) {
+                const uint32_t tmp = triangles[i];
+                triangles[i] = triangles[middle];
+                triangles[middle] = tmp;
+                middle++;
+            }
+        }
+
+        // All the centers on one side: split by count
+        if (middle == start || middle == end) {
+            middle = start + (end - start) / 2;
+        }
+
+        build_node(triangles, centers, start, middle);
+        build_node(triangles, centers, middle, end);
+
+        nodes[node].index = (int32_t) node_count;
+    }
+};
+
+#endif // TRIANGLE_MESH_H_